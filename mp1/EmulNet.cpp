@@ -12,17 +12,10 @@
 EmulNet::EmulNet(Params *p)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
-	int i,j;
 	par = p;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			sent_msgs[i][j] = 0;
-			recv_msgs[i][j] = 0;
-		}
-	}
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
 
@@ -30,15 +23,9 @@ EmulNet::EmulNet(Params *p)
  * Copy constructor
  */
 EmulNet::EmulNet(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->traffic = anotherEmulNet.traffic;
 	this->emulnet = anotherEmulNet.emulnet;
 }
 
@@ -46,15 +33,9 @@ EmulNet::EmulNet(EmulNet &anotherEmulNet) {
  * Assignment operator overloading
  */
 EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->traffic = anotherEmulNet.traffic;
 	this->emulnet = anotherEmulNet.emulnet;
 	return *this;
 }
@@ -64,6 +45,31 @@ EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
  */
 EmulNet::~EmulNet() {}
 
+/**
+ * FUNCTION NAME: countTraffic
+ *
+ * DESCRIPTION: Count a message of size bytes that node sent (or received) in
+ * 				this tick, in the window of ticks it falls in
+ */
+void EmulNet::countTraffic(int node, bool sent, int size) {
+	int time = par->getcurrtime();
+	assert(node >= 0 && time >= 0);
+	if ( node >= (int)traffic.size() ) {
+		traffic.resize(node + 1);
+	}
+	en_traffic &tr = traffic[node];
+	// a new window comes zeroed
+	en_traffic_window &window = tr.windows[time / EN_TRAFFIC_WINDOW];
+	if ( sent ) {
+		window.sent[time % EN_TRAFFIC_WINDOW]++;
+		tr.sentbytes += size;
+	}
+	else {
+		window.recv[time % EN_TRAFFIC_WINDOW]++;
+		tr.recvbytes += size;
+	}
+}
+
 /**
  * FUNCTION NAME: ENinit
  *
@@ -100,15 +106,10 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
 	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
 	memcpy(em + 1, data, size);
 
-	emulnet.buff[emulnet.currbuffsize++] = em;
+	emulnet.getInbox(*(int *)(toaddr->addr))->push_back(em);
+	emulnet.currbuffsize++;
 
-	int src = *(int *)(myaddr->addr);
-	int time = par->getcurrtime();
-
-	assert(src <= MAX_NODES);
-	assert(time < MAX_TIME);
-
-	sent_msgs[src][time]++;
+	countTraffic(*(int *)(myaddr->addr), true, size);
 
 	#ifdef DEBUGLOG
 		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
@@ -137,40 +138,41 @@ int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
  * FUNCTION NAME: ENrecv
  *
  * DESCRIPTION: EmulNet receive function
+ * 				Only the inbox of the receiving node is visited, so the cost of a
+ * 				receive is proportional to the number of messages addressed to it
  *
  * RETURN:
  * 0
  */
 int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
 	// times is always assumed to be 1
-	int i;
+	unsigned int i;
 	char* tmp;
 	int sz;
 	en_msg *emsg;
+	vector<en_msg*> batch;
+	vector<en_msg*> *box = emulnet.getInbox(*(int *)(myaddr->addr));
 
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
-
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
+	if ( box == NULL || box->empty() ) {
+		return 0;
+	}
 
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
+	// Take the whole inbox; anything sent while delivering lands in a fresh one
+	batch.swap(*box);
+	emulnet.currbuffsize -= batch.size();
 
-			(*enq)(queue, (char *)tmp, sz);
+	for( i = 0; i < batch.size(); i++ ) {
+		emsg = batch[i];
 
-			free(emsg);
+		sz = emsg->size;
+		tmp = (char *) malloc(sz * sizeof(char));
+		memcpy(tmp, (char *)(emsg+1), sz);
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+		(*enq)(queue, (char *)tmp, sz);
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+		free(emsg);
 
-			recv_msgs[dst][time]++;
-		}
+		countTraffic(*(int *)(myaddr->addr), false, sz);
 	}
 
 	return 0;
@@ -184,35 +186,50 @@ int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct ti
 int EmulNet::ENcleanup() {
 	emulnet.nextid=0;
 	int i, j;
-	int sent_total, recv_total;
+	unsigned int sent_total, recv_total;
 
 	FILE* file = fopen("msgcount.log", "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	for ( i = 0; i < (int)emulnet.inbox.size(); i++ ) {
+		for ( j = 0; j < (int)emulnet.inbox[i].size(); j++ ) {
+			free(emulnet.inbox[i][j]);
+		}
+		emulnet.inbox[i].clear();
 	}
+	emulnet.currbuffsize = 0;
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
 		fprintf(file, "node %3d ", i);
 		sent_total = 0;
 		recv_total = 0;
+		en_traffic none = en_traffic();
+		en_traffic &tr = i < (int)traffic.size() ? traffic[i] : none;
+		auto window = tr.windows.end();
 
 		for (j = 0; j < par->getcurrtime(); j++) {
+			unsigned int sent = 0, recv = 0;
+			if ( j % EN_TRAFFIC_WINDOW == 0 ) {
+				window = tr.windows.find(j / EN_TRAFFIC_WINDOW);
+			}
+			if ( window != tr.windows.end() ) {
+				sent = window->second.sent[j % EN_TRAFFIC_WINDOW];
+				recv = window->second.recv[j % EN_TRAFFIC_WINDOW];
+			}
 
-			sent_total += sent_msgs[i][j];
-			recv_total += recv_msgs[i][j];
+			sent_total += sent;
+			recv_total += recv;
 			if (i != 67) {
-				fprintf(file, " (%4d, %4d)", sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, " (%4u, %4u)", sent, recv);
 				if (j % 10 == 9) {
 					fprintf(file, "\n         ");
 				}
 			}
 			else {
-				fprintf(file, "special %4d %4d %4d\n", j, sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, "special %4d %4u %4u\n", j, sent, recv);
 			}
 		}
 		fprintf(file, "\n");
-		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
+		fprintf(file, "node %3d sent_total %6u  recv_total %6u  sent_bytes %8ld  recv_bytes %8ld\n\n", i, sent_total, recv_total, tr.sentbytes, tr.recvbytes);
 	}
 
 	fclose(file);
@@ -7,9 +7,9 @@
 #ifndef _EMULNET_H_
 #define _EMULNET_H_
 
-#define MAX_NODES 1000
-#define MAX_TIME 3600
 #define ENBUFFSIZE 30000
+// ticks of traffic counted together, see en_traffic
+#define EN_TRAFFIC_WINDOW 64
 
 #include "stdincludes.h"
 #include "Params.h"
@@ -29,25 +29,48 @@ typedef struct en_msg {
 	Address to;
 }en_msg;
 
+/**
+ * Struct Name: en_traffic_window
+ *
+ * DESCRIPTION: Messages sent and received by one node in each of
+ * 				EN_TRAFFIC_WINDOW consecutive ticks
+ */
+typedef struct en_traffic_window {
+	unsigned int sent[EN_TRAFFIC_WINDOW];
+	unsigned int recv[EN_TRAFFIC_WINDOW];
+}en_traffic_window;
+
+/**
+ * Struct Name: en_traffic
+ *
+ * DESCRIPTION: Traffic of one node: the windows of ticks it sent or received
+ * 				anything in, by window number, and its bytes over the whole run.
+ * 				A window with no traffic takes no memory.
+ */
+typedef struct en_traffic {
+	map<int, en_traffic_window> windows;
+	long sentbytes;
+	long recvbytes;
+}en_traffic;
+
 /**
  * Class Name: EM
+ *
+ * DESCRIPTION: Messages in flight, kept in one inbox per destination node id
+ * 				so that a receive only touches the frames addressed to that node
  */
 class EM {
 public:
 	int nextid;
 	int currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
+	vector< vector<en_msg*> > inbox;
 	EM() {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->inbox = anotherEM.inbox;
 		return *this;
 	}
 	int getNextId() {
@@ -68,6 +91,15 @@ public:
 	void setFirstEltIndex(int firsteltindex) {
 		this->firsteltindex = firsteltindex;
 	}
+	vector<en_msg*> * getInbox(int id) {
+		if ( id < 0 ) {
+			return NULL;
+		}
+		if ( id >= (int)inbox.size() ) {
+			inbox.resize(id + 1);
+		}
+		return &inbox[id];
+	}
 	virtual ~EM() {}
 };
 
@@ -80,10 +112,11 @@ class EmulNet
 { 	
 private:
 	Params* par;
-	int sent_msgs[MAX_NODES + 1][MAX_TIME];
-	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	// Per node traffic, grown on demand
+	vector<en_traffic> traffic;
 	int enInited;
 	EM emulnet;
+	void countTraffic(int node, bool sent, int size);
 public:
  	EmulNet(Params *p);
  	EmulNet(EmulNet &anotherEmulNet);
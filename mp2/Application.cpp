@@ -47,11 +47,35 @@ int main(int argc, char *argv[]) {
 Application::Application(char *infile) {
 	int i;
 	par = new Params();
-	srand (time(NULL));
 	par->setparams(infile);
+	srand (par->SEED);
 	log = new Log(par);
-	en = new EmulNet(par);
-	en1 = new EmulNet(par);
+	executor = new Executor(par->WORKERS);
+	scheduler = NULL;
+	timeWhenAllNodesHaveJoined = 0;
+	allNodesJoined = false;
+	if ( par->TRANSPORT == UDP_TRANSPORT ) {
+		// the KV store network listens on the ports after the membership one
+		en = new UdpNet(par, par->UDP_BASE_PORT);
+		en1 = new UdpNet(par, par->UDP_BASE_PORT + par->EN_GPSZ);
+	}
+	else if ( par->TRANSPORT == SHM_TRANSPORT ) {
+		string shmName = par->SHM_NAME;
+		if ( shmName.empty() ) {
+			shmName = "/emulnet." + to_string(getpid());
+		}
+		en = new ShmNet(par, shmName + ".mp1");
+		en1 = new ShmNet(par, shmName + ".mp2");
+	}
+	else {
+		en = new EmulNet(par);
+		en1 = new EmulNet(par);
+	}
+	if ( par->SIM_MODE == EVENT_SIM ) {
+		scheduler = new Scheduler(par->EN_GPSZ);
+		en->ENwatch(wakeMP1, this);
+		en1->ENwatch(wakeMP2, this);
+	}
 	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
 	mp2 = (MP2Node **) malloc(par->EN_GPSZ * sizeof(MP2Node *));
 
@@ -65,6 +89,9 @@ Application::Application(char *infile) {
 		Address joinaddr;
 		joinaddr = getjoinaddr();
 		addressOfMemberNode = (Address *) en->ENinit(addressOfMemberNode, par->PORTNUM);
+		// same id on the KV store network
+		Address kvAddress;
+		en1->ENinit(&kvAddress, par->PORTNUM);
 		mp1[i] = new MP1Node(memberNode, par, en, log, addressOfMemberNode);
 		mp2[i] = new MP2Node(memberNode, par, en1, log, addressOfMemberNode);
 		log->LOG(&(mp1[i]->getMemberNode()->addr), "APP");
@@ -77,6 +104,8 @@ Application::Application(char *infile) {
  * Destructor
  */
 Application::~Application() {
+	delete executor;
+	delete scheduler;
 	delete log;
 	delete en;
 	delete en1;
@@ -97,28 +126,28 @@ Application::~Application() {
 int Application::run()
 {
 	int i;
-	int timeWhenAllNodesHaveJoined = 0;
-	// boolean indicating if all nodes have joined
-	bool allNodesJoined = false;
-	srand(time(NULL));
+	struct timespec start, end, cpuStart, cpuEnd;
+	srand(par->SEED);
 
-	// As time runs along
-	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
-		// Run the membership protocol
-		mp1Run();
-
-		// Wait for all nodes to join
-		if ( par->allNodesJoined == nodeCount && !allNodesJoined ) {
-			timeWhenAllNodesHaveJoined = par->getcurrtime();
-			allNodesJoined = true;
-		}
-		if ( par->getcurrtime() > timeWhenAllNodesHaveJoined + 50 ) {
-			// Call the KV store functionalities
-			mp2Run();
-		}
-		// Fail some nodes
-		//fail();
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+	if ( par->SIM_MODE == EVENT_SIM ) {
+		runEvents();
+	}
+	else {
+		runTicks();
 	}
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuEnd);
+	log->LOG(&mp1[0]->getMemberNode()->addr, "#STATSLOG# sim time: %s wall_ms=%.1f cpu_ms=%.1f", par->SIM_MODE == EVENT_SIM ? "EVENT" : "TICK",
+			(end.tv_sec - start.tv_sec) * 1e3 + (end.tv_nsec - start.tv_nsec) / 1e6,
+			(cpuEnd.tv_sec - cpuStart.tv_sec) * 1e3 + (cpuEnd.tv_nsec - cpuStart.tv_nsec) / 1e6);
+
+	reportOpLatency();
+	reportWal();
+	reportLsm();
+	reportStore();
+	reportAntiEntropy();
 
 	// Clean up
 	en->ENcleanup();
@@ -131,16 +160,151 @@ int Application::run()
 	return SUCCESS;
 }
 
+/**
+ * FUNCTION NAME: runTicks
+ *
+ * DESCRIPTION: Run every node at every time step
+ */
+void Application::runTicks() {
+	vector<int> nodes;
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		nodes.push_back(i);
+	}
+	// As time runs along
+	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
+		step(nodes);
+	}
+
+	log->LOG(&mp1[0]->getMemberNode()->addr, "#STATSLOG# sim: visited %d of %d time steps, %ld node steps, %ld events", TOTAL_RUNNING_TIME, TOTAL_RUNNING_TIME, (long)TOTAL_RUNNING_TIME * par->EN_GPSZ, 0L);
+}
+
+/**
+ * FUNCTION NAME: runEvents
+ *
+ * DESCRIPTION: Event driven simulation. Time jumps to the next step at which a
+ * 				node has a message to receive, a timer due or is introduced, or
+ * 				at which the tests act, and only the nodes woken up are run.
+ * 				A node that is skipped would have had nothing to do, so the
+ * 				outcome is the one of runTicks.
+ */
+void Application::runEvents() {
+	int appTimes[] = {
+		INSERT_TIME,
+		TEST_TIME,
+		TEST_TIME + FIRST_FAIL_TIME,
+		TEST_TIME + FIRST_FAIL_TIME + STABILIZE_TIME,
+		TEST_TIME + FIRST_FAIL_TIME + STABILIZE_TIME + STABILIZE_TIME,
+		TEST_TIME + FIRST_FAIL_TIME + STABILIZE_TIME + STABILIZE_TIME + LAST_FAIL_TIME
+	};
+	int *appEnd = appTimes + sizeof(appTimes) / sizeof(appTimes[0]);
+	int i, *t, visited = 0;
+	long nodeSteps = 0;
+	vector<int> nodes;
+
+	for( i = 0; i < par->EN_GPSZ; i++ ) {
+		// introduce the ith node into the system at time STEPRATE*i
+		scheduler->schedule(MP1_NET, (int)(par->STEP_RATE*i), i);
+	}
+	wakeKVStore();
+	for ( t = appTimes; t < appEnd; t++ ) {
+		scheduler->schedule(MP1_NET, *t, APP_EVENT);
+	}
+
+	par->globaltime = 0;
+	while ( par->getcurrtime() < TOTAL_RUNNING_TIME ) {
+		bool joined = allNodesJoined;
+
+		nodes.clear();
+		scheduler->due(MP1_NET, par->getcurrtime(), nodes);
+		step(nodes);
+		visited++;
+		nodeSteps += nodes.size();
+
+		if ( allNodesJoined && !joined ) {
+			wakeKVStore();
+		}
+		if ( find(appTimes, appEnd, par->getcurrtime()) != appEnd ) {
+			// the tests started operations on nodes that were not run
+			nodes.clear();
+			for ( i = 0; i < par->EN_GPSZ; i++ ) {
+				nodes.push_back(i);
+			}
+		}
+		for ( i = 0; i < (int)nodes.size(); i++ ) {
+			scheduler->schedule(MP1_NET, mp1[nodes[i]]->nextWake(), nodes[i]);
+			scheduler->schedule(MP2_NET, mp2[nodes[i]]->nextWake(), nodes[i]);
+		}
+
+		par->globaltime = min(TOTAL_RUNNING_TIME, max(par->getcurrtime() + 1, scheduler->nextTime()));
+	}
+
+	log->LOG(&mp1[0]->getMemberNode()->addr, "#STATSLOG# sim: visited %d of %d time steps, %ld node steps, %ld events", visited, TOTAL_RUNNING_TIME, nodeSteps, scheduler->getScheduled());
+}
+
+/**
+ * FUNCTION NAME: wakeKVStore
+ *
+ * DESCRIPTION: Wake up every node when the KV store starts running, see step
+ */
+void Application::wakeKVStore() {
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		scheduler->schedule(MP2_NET, timeWhenAllNodesHaveJoined + 51, i);
+	}
+}
+
+/**
+ * FUNCTION NAME: wakeMP1
+ *
+ * DESCRIPTION: Called by the membership network when node id can receive at time
+ */
+void Application::wakeMP1(void *app, int id, int time) {
+	((Application *)app)->scheduler->schedule(MP1_NET, time, id - 1);
+}
+
+/**
+ * FUNCTION NAME: wakeMP2
+ *
+ * DESCRIPTION: Called by the KV store network when node id can receive at time
+ */
+void Application::wakeMP2(void *app, int id, int time) {
+	((Application *)app)->scheduler->schedule(MP2_NET, time, id - 1);
+}
+
+/**
+ * FUNCTION NAME: step
+ *
+ * DESCRIPTION: Run the nodes (indices in ascending order) for the current time step
+ */
+void Application::step(vector<int> &nodes) {
+	// Run the membership protocol
+	mp1Run(nodes);
+
+	// Wait for all nodes to join
+	if ( par->allNodesJoined == nodeCount && !allNodesJoined ) {
+		timeWhenAllNodesHaveJoined = par->getcurrtime();
+		allNodesJoined = true;
+	}
+	if ( par->getcurrtime() > timeWhenAllNodesHaveJoined + 50 ) {
+		// Call the KV store functionalities
+		mp2Run(nodes);
+	}
+	// Fail some nodes
+	//fail();
+}
+
 /**
  * FUNCTION NAME: mp1Run
  *
  * DESCRIPTION:	This function performs all the membership protocol functionalities
  */
-void Application::mp1Run() {
-	int i;
+void Application::mp1Run(vector<int> &nodes) {
+	int k, i;
 
 	// For all the nodes in the system
-	for( i = 0; i <= par->EN_GPSZ-1; i++) {
+	log->hold();
+	executor->run(nodes.size(), [&](int k) {
+		int i = nodes[k];
 
 		/*
 		 * Receive messages from the network and queue them in the membership protocol queue
@@ -150,10 +314,13 @@ void Application::mp1Run() {
 			mp1[i]->recvLoop();
 		}
 
-	}
+	});
+	log->merge(false);
 
 	// For all the nodes in the system
-	for( i = par->EN_GPSZ - 1; i >= 0; i-- ) {
+	log->hold();
+	executor->run(nodes.size(), [&](int k) {
+		int i = nodes[k];
 
 		/*
 		 * Introduce nodes into the distributed system
@@ -161,8 +328,6 @@ void Application::mp1Run() {
 		if( par->getcurrtime() == (int)(par->STEP_RATE*i) ) {
 			// introduce the ith node into the system at time STEPRATE*i
 			mp1[i]->nodeStart(JOINADDR, par->PORTNUM);
-			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i]->getMemberNode()->addr.getAddress() << endl;
-			nodeCount += i;
 		}
 
 		/*
@@ -178,6 +343,15 @@ void Application::mp1Run() {
 			#endif
 		}
 
+	});
+	log->merge(true);
+
+	for( k = nodes.size() - 1; k >= 0; k-- ) {
+		i = nodes[k];
+		if( par->getcurrtime() == (int)(par->STEP_RATE*i) ) {
+			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i]->getMemberNode()->addr.getAddress() << endl;
+			nodeCount += i;
+		}
 	}
 }
 
@@ -189,39 +363,64 @@ void Application::mp1Run() {
  * 				1) Ring operations
  * 				2) CRUD operations
  */
-void Application::mp2Run() {
-	int i;
+void Application::mp2Run(vector<int> &nodes) {
 
-	// For all the nodes in the system
-	for( i = 0; i <= par->EN_GPSZ-1; i++) {
+	if ( scheduler != NULL ) {
+		// add the nodes with something to receive on the KV store network
+		scheduler->due(MP2_NET, par->getcurrtime(), nodes);
+	}
 
-		/*
-		 * 1) Update the ring
-		 * 2) Receive messages from the network and queue them in the KV store queue
-		 */
+	/*
+	 * 1) Update the ring
+	 * 2) Receive messages from the network and queue them in the KV store queue
+	 *
+	 * Every ring is updated before anyone receives, so whatever the stabilization
+	 * protocol sends is seen in this tick no matter which thread ran which node
+	 */
+	log->hold();
+	executor->run(nodes.size(), [&](int k) {
+		int i = nodes[k];
 		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
 			if ( mp2[i]->getMemberNode()->inited && mp2[i]->getMemberNode()->inGroup ) {
 				// Step 1
 				mp2[i]->updateRing();
 			}
+		}
+	});
+	log->merge(false);
+
+	if ( scheduler != NULL ) {
+		// and the ones the stabilization protocol just sent to
+		scheduler->due(MP2_NET, par->getcurrtime(), nodes);
+	}
+
+	log->hold();
+	executor->run(nodes.size(), [&](int k) {
+		int i = nodes[k];
+		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
 			// Step 2
 			mp2[i]->recvLoop();
 		}
-	}
+	});
+	log->merge(false);
 
 	/**
 	 * Handle messages from the queue and update the DHT
 	 */
-	for ( i = par->EN_GPSZ-1; i >= 0; i-- ) {
+	log->hold();
+	executor->run(nodes.size(), [&](int k) {
+		int i = nodes[k];
 		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
 			mp2[i]->checkMessages();
 		}
-	}
+	});
+	log->merge(true);
 
 	/**
 	 * Insert a set of test key value pairs into the system
 	 */
 	if ( par->getcurrtime() == INSERT_TIME ) {
+		checkRings();
 		insertTestKVPairs();
 	}
 
@@ -364,6 +563,153 @@ void Application::fail() {
 
 }
 
+/**
+ * FUNCTION NAME: reportOpLatency
+ *
+ * DESCRIPTION: Write the distribution of the time coordinators took to complete
+ * 				the KV store operations to the stats log
+ */
+void Application::reportOpLatency() {
+	vector<int> all;
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		vector<int> *lat = mp2[i]->getOpLatency();
+		all.insert(all.end(), lat->begin(), lat->end());
+	}
+	if ( all.empty() ) {
+		return;
+	}
+	sort(all.begin(), all.end());
+	log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# op latency: count=%d p50=%d p99=%d max=%d", (int)all.size(), all[all.size() / 2], all[(all.size() * 99) / 100], all.back());
+}
+
+/**
+ * FUNCTION NAME: reportWal
+ *
+ * DESCRIPTION: Write how much the nodes logged, and in how many commits, to the
+ * 				stats log
+ */
+void Application::reportWal() {
+	long records = 0, commits = 0, syncs = 0, bytes = 0;
+
+	if ( par->WAL_DIR.empty() ) {
+		return;
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		WriteAheadLog *wal = mp2[i]->getWal();
+		records += wal->getRecords();
+		commits += wal->getCommits();
+		syncs += wal->getSyncs();
+		bytes += wal->getBytes();
+	}
+	log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# wal: records=%ld commits=%ld syncs=%ld bytes=%ld", records, commits, syncs, bytes);
+}
+
+/**
+ * FUNCTION NAME: reportStore
+ *
+ * DESCRIPTION: Write the keys the nodes store, and how evenly, to the stats log,
+ * 				with the standard deviation across nodes of their keys and of
+ * 				the requests they served
+ */
+void Application::reportStore() {
+	unsigned long keys = 0, least = ULONG_MAX, most = 0, served = 0;
+	unsigned long long bytes = 0;
+	double keySquares = 0, servedSquares = 0;
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		unsigned long nodeKeys = 0;
+		for ( int p = 0; p < KV_PARTITIONS; p++ ) {
+			kv_partition_stats stats = mp2[i]->getStore()->partitionStats(p);
+			nodeKeys += stats.keys;
+			bytes += stats.bytes;
+		}
+		keys += nodeKeys;
+		least = min(least, nodeKeys);
+		most = max(most, nodeKeys);
+		keySquares += (double)nodeKeys * nodeKeys;
+		served += mp2[i]->getServed();
+		servedSquares += (double)mp2[i]->getServed() * mp2[i]->getServed();
+	}
+	double keyMean = (double)keys / par->EN_GPSZ, servedMean = (double)served / par->EN_GPSZ;
+	log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# store: keys=%lu bytes=%llu node_min=%lu node_max=%lu keys_stddev=%.1f load_stddev=%.1f",
+			keys, bytes, least, most, sqrt(max(0.0, keySquares / par->EN_GPSZ - keyMean * keyMean)),
+			sqrt(max(0.0, servedSquares / par->EN_GPSZ - servedMean * servedMean)));
+}
+
+/**
+ * FUNCTION NAME: reportAntiEntropy
+ *
+ * DESCRIPTION: Write the messages and bytes the nodes sent to compare and
+ * 				repair their replicas, per ring change that had a node do it,
+ * 				to the stats log
+ */
+void Application::reportAntiEntropy() {
+	unsigned long events = 0, messages = 0;
+	unsigned long long bytes = 0;
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		events += mp2[i]->getAeEvents();
+		messages += mp2[i]->getAeMessages();
+		bytes += mp2[i]->getAeBytes();
+	}
+	log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# antientropy: events=%lu messages=%lu bytes=%llu per_event_messages=%.1f per_event_bytes=%.0f",
+			events, messages, bytes, events > 0 ? (double)messages / events : 0.0, events > 0 ? (double)bytes / events : 0.0);
+}
+
+/**
+ * FUNCTION NAME: checkRings
+ *
+ * DESCRIPTION: Once every node has joined, every node must have built the same
+ * 				ring, or coordinators disagree on the replicas of a key; write
+ * 				how many do not to the stats log, and each of them to the log
+ */
+void Application::checkRings() {
+	const Ring *first = NULL;
+	int nodes = 0, differ = 0;
+
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		Member *member = mp2[i]->getMemberNode();
+		if ( member->bFailed || !member->inGroup ) {
+			continue;
+		}
+		nodes++;
+		if ( first == NULL ) {
+			first = &mp2[i]->getRing();
+		}
+		else if ( !mp2[i]->getRing().sameNodes(*first) ) {
+			differ++;
+			log->LOG(&member->addr, "Ring differs: %d positions", (int)mp2[i]->getRing().size());
+		}
+	}
+	log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# rings: nodes=%d differ=%d", nodes, differ);
+}
+
+/**
+ * FUNCTION NAME: reportLsm
+ *
+ * DESCRIPTION: Write the write amplification (bytes written to tables per byte
+ * 				written by the nodes) and read amplification (blocks read per
+ * 				lookup) of the LSM trees to the stats log
+ */
+void Application::reportLsm() {
+	long userBytes = 0, diskBytes = 0, lookups = 0, blockReads = 0, compactions = 0;
+
+	if ( par->STORAGE != LSM_STORAGE ) {
+		return;
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		LsmTree *tree = (LsmTree *)mp2[i]->getStore();
+		userBytes += tree->getUserBytes();
+		diskBytes += tree->getDiskBytesWritten();
+		lookups += tree->getLookups();
+		blockReads += tree->getBlockReads();
+		compactions += tree->getCompactions();
+	}
+	log->LOG(&mp2[0]->getMemberNode()->addr, "#STATSLOG# lsm: write_amp=%.2f read_amp=%.2f compactions=%ld",
+			userBytes > 0 ? (double)diskBytes / userBytes : 0.0, lookups > 0 ? (double)blockReads / lookups : 0.0, compactions);
+}
+
 /**
  * FUNCTION NAME: getjoinaddr
  *
@@ -398,7 +744,7 @@ int Application::findARandomNodeThatIsAlive() {
  * DESCRIPTION: Init NUMBER_OF_INSERTS test KV pairs in the map
  */
 void Application::initTestKVPairs() {
-	srand(time(NULL));
+	srand(par->SEED);
 	int i;
 	string key;
 	key.clear();
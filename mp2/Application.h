@@ -13,10 +13,14 @@
 #include "Params.h"
 #include "Member.h"
 #include "EmulNet.h"
+#include "UdpNet.h"
+#include "ShmNet.h"
 #include "Queue.h"
 #include "MP2Node.h"
 #include "Node.h"
 #include "common.h"
+#include "Executor.h"
+#include "Scheduler.h"
 
 /**
  * global variables
@@ -51,27 +55,46 @@ private:
 	// Address for introduction to the group
 	// Coordinator Node
 	char JOINADDR[30];
-	EmulNet *en;
-	EmulNet *en1;
+	Transport *en;
+	Transport *en1;
     Log *log;
 	MP1Node **mp1;
 	MP2Node **mp2;
 	Params *par;
+	// runs the nodes of every phase of a tick
+	Executor *executor;
+	// pending events, only with the event driven simulation
+	Scheduler *scheduler;
+	int timeWhenAllNodesHaveJoined;
+	// boolean indicating if all nodes have joined
+	bool allNodesJoined;
 	map<string, string> testKVPairs;
+	static void wakeMP1(void *app, int id, int time);
+	static void wakeMP2(void *app, int id, int time);
 public:
 	Application(char *);
 	virtual ~Application();
 	Address getjoinaddr();
 	void initTestKVPairs();
 	int run();
-	void mp1Run();
-	void mp2Run();
+	void runTicks();
+	void runEvents();
+	void wakeKVStore();
+	void step(vector<int> &nodes);
+	void mp1Run(vector<int> &nodes);
+	void mp2Run(vector<int> &nodes);
 	void fail();
 	void insertTestKVPairs();
 	int findARandomNodeThatIsAlive();
 	void deleteTest();
 	void readTest();
 	void updateTest();
+	void reportOpLatency();
+	void reportWal();
+	void reportLsm();
+	void reportStore();
+	void reportAntiEntropy();
+	void checkRings();
 };
 
 #endif /* _APPLICATION_H__ */
@@ -0,0 +1,91 @@
+/**********************************
+ * FILE NAME: CodecBench.cpp
+ *
+ * DESCRIPTION: Benchmark of the KV store message formats: time to encode and
+ * 				decode a CREATE in the text format, in the binary format into a
+ * 				Message, and in the binary format read in place by MessageView,
+ * 				and the bytes each puts on the wire
+ **********************************/
+
+#include "stdincludes.h"
+#include "Message.h"
+
+/**
+ * Macros
+ */
+#define BENCH_OPS 1000000
+#define BENCH_KEY "IMIXg"
+#define BENCH_VALUE "value0123456789012345678901234567890123456789"
+
+/**
+ * FUNCTION NAME: nowNanos
+ *
+ * RETURNS:
+ * monotonic wall clock time in nanoseconds
+ */
+static long long nowNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * FUNCTION NAME: report
+ *
+ * DESCRIPTION: Print a line of results of a format
+ */
+static void report(const char *format, long long nanos, size_t bytes, long check) {
+	printf("%-10s %12.1f %8zu %10ld\n", format, (double)nanos / BENCH_OPS, bytes, check);
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: CodecBench; every format encodes and decodes BENCH_OPS
+ * 				messages, and sums the value lengths it decoded so that the
+ * 				work cannot be left out
+ */
+int main(int argc, char *argv[]) {
+	Address from;
+	long check;
+	long long start;
+	size_t bytes = 0;
+
+	memset(from.addr, 0, sizeof(from.addr));
+	from.addr[0] = 7;
+	printf("%-10s %12s %8s %10s\n", "format", "ns/op", "bytes", "check");
+
+	check = 0;
+	start = nowNanos();
+	for ( int i = 0; i < BENCH_OPS; i++ ) {
+		Message msg(i, from, CREATE, BENCH_KEY, BENCH_VALUE, PRIMARY);
+		string data = msg.toString();
+		Message decoded(data);
+		check += decoded.value.size();
+		bytes = data.size();
+	}
+	report("text", nowNanos() - start, bytes, check);
+
+	check = 0;
+	start = nowNanos();
+	for ( int i = 0; i < BENCH_OPS; i++ ) {
+		Message msg(i, from, CREATE, BENCH_KEY, BENCH_VALUE, PRIMARY);
+		string data = msg.toBytes();
+		Message decoded(data.data(), data.size());
+		check += decoded.value.size();
+		bytes = data.size();
+	}
+	report("binary", nowNanos() - start, bytes, check);
+
+	check = 0;
+	start = nowNanos();
+	for ( int i = 0; i < BENCH_OPS; i++ ) {
+		Message msg(i, from, CREATE, BENCH_KEY, BENCH_VALUE, PRIMARY);
+		string data = msg.toBytes();
+		MessageView decoded(data.data(), data.size());
+		check += decoded.value.size();
+		bytes = data.size();
+	}
+	report("view", nowNanos() - start, bytes, check);
+	return 0;
+}
@@ -6,22 +6,299 @@
 
 #include "EmulNet.h"
 
+thread_local int EmulNet::lastStatus = EN_SENT;
+
+
+/**
+ * Constructor
+ */
+ENpool::ENpool(): mallocs(0), allocs(0), releases(0) {
+	for ( int i = 0; i < EN_NUM_SIZE_CLASSES; i++ ) {
+		freelist[i] = NULL;
+	}
+}
+
+/**
+ * Destructor
+ */
+ENpool::~ENpool() {
+	for ( unsigned int i = 0; i < slabs.size(); i++ ) {
+		free(slabs[i]);
+	}
+}
+
+/**
+ * FUNCTION NAME: refill
+ *
+ * DESCRIPTION: Carve a new slab into frames of the given size class
+ */
+void ENpool::refill(int sizeclass) {
+	int framesize = EN_MIN_FRAME << sizeclass;
+	char *slab = (char *) malloc(EN_SLAB_SIZE);
+	mallocs++;
+	slabs.push_back(slab);
+
+	for ( int off = 0; off + framesize <= EN_SLAB_SIZE; off += framesize ) {
+		en_msg *em = (en_msg *)(slab + off);
+		em->sizeclass = sizeclass;
+		em->next = freelist[sizeclass];
+		freelist[sizeclass] = em;
+	}
+}
+
+/**
+ * FUNCTION NAME: alloc
+ *
+ * DESCRIPTION: Get a frame with room for size bytes of payload
+ */
+en_msg *ENpool::alloc(int size) {
+	en_msg *em;
+	int sizeclass = 0;
+
+	lock_guard<mutex> guard(lock);
+	allocs++;
+	while ( sizeclass < EN_NUM_SIZE_CLASSES && (int)sizeof(en_msg) + size > (EN_MIN_FRAME << sizeclass) ) {
+		sizeclass++;
+	}
+	if ( sizeclass == EN_NUM_SIZE_CLASSES ) {
+		em = (en_msg *) malloc(sizeof(en_msg) + size);
+		mallocs++;
+		em->sizeclass = -1;
+		return em;
+	}
+
+	if ( freelist[sizeclass] == NULL ) {
+		refill(sizeclass);
+	}
+	em = freelist[sizeclass];
+	freelist[sizeclass] = em->next;
+	return em;
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Give a frame back to its free list
+ */
+void ENpool::release(en_msg *em) {
+	lock_guard<mutex> guard(lock);
+	releases++;
+	if ( em->sizeclass < 0 ) {
+		free(em);
+		return;
+	}
+	em->next = freelist[em->sizeclass];
+	freelist[em->sizeclass] = em;
+}
+
+/**
+ * Constructor
+ */
+ENwheel::ENwheel(): now(0), overflow(NULL), pending(0) {
+	for ( int l = 0; l < EN_WHEEL_LEVELS; l++ ) {
+		for ( int i = 0; i < EN_WHEEL_SLOTS; i++ ) {
+			slots[l][i] = NULL;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: place
+ *
+ * DESCRIPTION: Put a frame in the lowest level whose span around the current
+ * 				time still covers its delivery time
+ */
+void ENwheel::place(en_msg *em) {
+	for ( int l = 0; l < EN_WHEEL_LEVELS; l++ ) {
+		if ( ((em->deliver ^ now) >> (EN_WHEEL_BITS * (l + 1))) == 0 ) {
+			int slot = (em->deliver >> (EN_WHEEL_BITS * l)) & (EN_WHEEL_SLOTS - 1);
+			em->next = slots[l][slot];
+			slots[l][slot] = em;
+			return;
+		}
+	}
+	em->next = overflow;
+	overflow = em;
+}
+
+/**
+ * FUNCTION NAME: insert
+ *
+ * DESCRIPTION: Hold a frame until em->deliver, which must be in the future
+ */
+void ENwheel::insert(en_msg *em) {
+	assert(em->deliver > now);
+	pending++;
+	place(em);
+}
+
+/**
+ * FUNCTION NAME: advance
+ *
+ * DESCRIPTION: Move the wheel forward to the given time
+ *
+ * RETURNS:
+ * list of frames that became due, linked through en_msg::next
+ */
+en_msg *ENwheel::advance(int to) {
+	en_msg *due = NULL;
+
+	if ( pending == 0 ) {
+		if ( to > now ) {
+			now = to;
+		}
+		return NULL;
+	}
+
+	while ( now < to ) {
+		now++;
+
+		// Cascade every level whose lower levels have just wrapped around
+		if ( (now & ((1 << (EN_WHEEL_BITS * EN_WHEEL_LEVELS)) - 1)) == 0 ) {
+			en_msg *em = overflow;
+			overflow = NULL;
+			while ( em ) {
+				en_msg *next = em->next;
+				place(em);
+				em = next;
+			}
+		}
+		for ( int l = EN_WHEEL_LEVELS - 1; l > 0; l-- ) {
+			if ( (now & ((1 << (EN_WHEEL_BITS * l)) - 1)) == 0 ) {
+				int slot = (now >> (EN_WHEEL_BITS * l)) & (EN_WHEEL_SLOTS - 1);
+				en_msg *em = slots[l][slot];
+				slots[l][slot] = NULL;
+				while ( em ) {
+					en_msg *next = em->next;
+					place(em);
+					em = next;
+				}
+			}
+		}
+
+		en_msg *em = slots[0][now & (EN_WHEEL_SLOTS - 1)];
+		slots[0][now & (EN_WHEEL_SLOTS - 1)] = NULL;
+		while ( em ) {
+			en_msg *next = em->next;
+			em->next = due;
+			due = em;
+			pending--;
+			em = next;
+		}
+	}
+	return due;
+}
+
+/**
+ * FUNCTION NAME: drain
+ *
+ * DESCRIPTION: Take every frame out of the wheel regardless of its delivery time
+ */
+en_msg *ENwheel::drain() {
+	en_msg *all = overflow;
+	overflow = NULL;
+	for ( int l = 0; l < EN_WHEEL_LEVELS; l++ ) {
+		for ( int i = 0; i < EN_WHEEL_SLOTS; i++ ) {
+			en_msg *em = slots[l][i];
+			slots[l][i] = NULL;
+			while ( em ) {
+				en_msg *next = em->next;
+				em->next = all;
+				all = em;
+				em = next;
+			}
+		}
+	}
+	pending = 0;
+	return all;
+}
+
+/**
+ * FUNCTION NAME: sample
+ *
+ * DESCRIPTION: Draw a latency from the given random stream, rounded to whole time units
+ */
+int en_latency::sample(unsigned int *seed) {
+	double lat = 0;
+	double u1, u2;
+
+	switch ( model ) {
+		case CONSTANT_LATENCY:
+			lat = mean;
+			break;
+		case UNIFORM_LATENCY:
+			lat = min + (max - min) * ((double)rand_r(seed) / RAND_MAX);
+			break;
+		case LOGNORMAL_LATENCY:
+			// Box-Muller for a standard normal, then exp() around the median
+			u1 = ((double)rand_r(seed) + 1) / ((double)RAND_MAX + 1);
+			u2 = (double)rand_r(seed) / RAND_MAX;
+			lat = min + mean * exp(sigma * sqrt(-2 * log(u1)) * cos(2 * M_PI * u2));
+			if ( max > 0 && lat > max ) {
+				lat = max;
+			}
+			break;
+		default:
+			break;
+	}
+	return lat <= 0 ? 0 : (int)(lat + 0.5);
+}
+
+/**
+ * FUNCTION NAME: push
+ *
+ * DESCRIPTION: Add a frame to the inbox; safe against other pushes and a take
+ */
+void en_inbox::push(en_msg *em) {
+	en_msg *old = head.load(memory_order_relaxed);
+	do {
+		em->next = old;
+	} while ( !head.compare_exchange_weak(old, em, memory_order_release, memory_order_relaxed) );
+}
+
+/**
+ * FUNCTION NAME: take
+ *
+ * DESCRIPTION: Empty the inbox
+ *
+ * RETURNS:
+ * the frames in the order they were pushed, linked through en_msg::next
+ */
+en_msg *en_inbox::take() {
+	en_msg *em = head.exchange(NULL, memory_order_acquire);
+	en_msg *fifo = NULL;
+
+	while ( em ) {
+		en_msg *next = em->next;
+		em->next = fifo;
+		fifo = em;
+		em = next;
+	}
+	return fifo;
+}
+
 /**
  * Constructor
  */
 EmulNet::EmulNet(Params *p)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
-	int i,j;
 	par = p;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			sent_msgs[i][j] = 0;
-			recv_msgs[i][j] = 0;
-		}
+	latency.model = par->LATENCY_MODEL;
+	latency.min = par->LATENCY_MIN;
+	latency.max = par->LATENCY_MAX;
+	latency.mean = par->LATENCY_MEAN;
+	latency.sigma = par->LATENCY_SIGMA;
+	lastDrain = 0;
+	shaped = latency.model != NO_LATENCY || par->LINK_BANDWIDTH > 0;
+	multicasts = 0;
+	shared = 0;
+	batchGrows = 0;
+	for ( int i = 0; i < EN_NUM_STATUS; i++ ) {
+		statusCount[i] = 0;
 	}
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
@@ -30,32 +307,56 @@ EmulNet::EmulNet(Params *p)
  * Copy constructor
  */
 EmulNet::EmulNet(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
+	this->traffic = anotherEmulNet.traffic;
+	this->seeds = anotherEmulNet.seeds;
+	this->sendSeq = anotherEmulNet.sendSeq;
+	this->emulnet = anotherEmulNet.emulnet;
+	this->latency = anotherEmulNet.latency;
+	this->links = anotherEmulNet.links;
+	this->backlog.clear();
+	for ( map<pair<int, int>, en_link>::iterator it = links.begin(); it != links.end(); ++it ) {
+		if ( it->second.backlogged ) {
+			this->backlog.push_back(&it->second);
 		}
 	}
-	this->emulnet = anotherEmulNet.emulnet;
+	this->lastDrain = anotherEmulNet.lastDrain;
+	this->shaped = anotherEmulNet.shaped;
+	for ( int i = 0; i < EN_NUM_STATUS; i++ ) {
+		this->statusCount[i] = anotherEmulNet.statusCount[i].load();
+	}
+	this->multicasts = anotherEmulNet.multicasts.load();
+	this->shared = anotherEmulNet.shared.load();
+	this->batchGrows = anotherEmulNet.batchGrows.load();
 }
 
 /**
  * Assignment operator overloading
  */
 EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
+	this->traffic = anotherEmulNet.traffic;
+	this->seeds = anotherEmulNet.seeds;
+	this->sendSeq = anotherEmulNet.sendSeq;
+	this->emulnet = anotherEmulNet.emulnet;
+	this->latency = anotherEmulNet.latency;
+	this->links = anotherEmulNet.links;
+	this->backlog.clear();
+	for ( map<pair<int, int>, en_link>::iterator it = links.begin(); it != links.end(); ++it ) {
+		if ( it->second.backlogged ) {
+			this->backlog.push_back(&it->second);
 		}
 	}
-	this->emulnet = anotherEmulNet.emulnet;
+	this->lastDrain = anotherEmulNet.lastDrain;
+	this->shaped = anotherEmulNet.shaped;
+	for ( int i = 0; i < EN_NUM_STATUS; i++ ) {
+		this->statusCount[i] = anotherEmulNet.statusCount[i].load();
+	}
+	this->multicasts = anotherEmulNet.multicasts.load();
+	this->shared = anotherEmulNet.shared.load();
+	this->batchGrows = anotherEmulNet.batchGrows.load();
 	return *this;
 }
 
@@ -64,6 +365,228 @@ EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
  */
 EmulNet::~EmulNet() {}
 
+/**
+ * FUNCTION NAME: countTraffic
+ *
+ * DESCRIPTION: Count a message of size bytes that node sent (or received) in
+ * 				this tick, in the window of ticks it falls in
+ */
+void EmulNet::countTraffic(int node, bool sent, int size) {
+	int time = par->getcurrtime();
+	assert(node >= 0 && node < (int)traffic.size() && time >= 0);
+	en_traffic &tr = traffic[node];
+	// a new window comes zeroed
+	en_traffic_window &window = tr.windows[time / EN_TRAFFIC_WINDOW];
+	if ( sent ) {
+		window.sent[time % EN_TRAFFIC_WINDOW]++;
+		tr.sentbytes += size;
+	}
+	else {
+		window.recv[time % EN_TRAFFIC_WINDOW]++;
+		tr.recvbytes += size;
+	}
+}
+
+/**
+ * FUNCTION NAME: deliver
+ *
+ * DESCRIPTION: Make a frame visible in the inbox of its destination
+ */
+void EmulNet::deliver(en_msg *em) {
+	en_inbox *box = emulnet.getInbox(*(int *)(em->to.addr));
+
+	if ( box == NULL ) {
+		// no such node
+		emulnet.currbuffsize--;
+		discard(em);
+		return;
+	}
+	box->push(em);
+}
+
+/**
+ * FUNCTION NAME: getLink
+ *
+ * DESCRIPTION: State of the link from src to dst, created on first use
+ */
+en_link *EmulNet::getLink(int src, int dst) {
+	pair<map<pair<int, int>, en_link>::iterator, bool> ins;
+	en_link fresh;
+
+	memset(&fresh, 0, sizeof(fresh));
+	fresh.src = src;
+	fresh.dst = dst;
+	fresh.tokens = par->LINK_BURST;
+	fresh.refilled = par->getcurrtime();
+	ins = links.insert(make_pair(make_pair(src, dst), fresh));
+	return &ins.first->second;
+}
+
+/**
+ * FUNCTION NAME: refill
+ *
+ * DESCRIPTION: Add the tokens earned since the last refill, up to the bucket size
+ */
+void EmulNet::refill(en_link *link) {
+	int now = par->getcurrtime();
+
+	if ( now > link->refilled ) {
+		link->tokens += par->LINK_BANDWIDTH * (now - link->refilled);
+		if ( link->tokens > par->LINK_BURST ) {
+			link->tokens = par->LINK_BURST;
+		}
+		link->refilled = now;
+	}
+}
+
+/**
+ * FUNCTION NAME: transmit
+ *
+ * DESCRIPTION: Put a frame on the wire; it shows up at the receiver after the link latency
+ */
+void EmulNet::transmit(en_msg *em, en_link *link) {
+	unsigned int *seed = &seeds[*(int *)(em->from.addr)];
+	int delay = (link != NULL && link->haslatency) ? link->latency.sample(seed) : latency.sample(seed);
+
+	em->deliver = par->getcurrtime() + delay;
+	notify(*(int *)(em->to.addr), em->deliver);
+	if ( delay == 0 ) {
+		deliver(em);
+	}
+	else {
+		wheel.insert(em);
+	}
+}
+
+/**
+ * FUNCTION NAME: linkOrder
+ *
+ * DESCRIPTION: Order of links by source, then destination
+ */
+static bool linkOrder(en_link *a, en_link *b) {
+	return a->src != b->src ? a->src < b->src : a->dst < b->dst;
+}
+
+/**
+ * FUNCTION NAME: frameOrder
+ *
+ * DESCRIPTION: Order of frames by source, then by when the source sent them
+ */
+static bool frameOrder(en_msg *a, en_msg *b) {
+	int froma = *(int *)(a->from.addr);
+	int fromb = *(int *)(b->from.addr);
+	return froma != fromb ? froma < fromb : a->seq < b->seq;
+}
+
+/**
+ * FUNCTION NAME: drainLinks
+ *
+ * DESCRIPTION: Transmit the queued frames that the bandwidth earned since the
+ * 				last time step allows
+ */
+void EmulNet::drainLinks() {
+	unsigned int i, kept = 0;
+
+	if ( lastDrain == par->getcurrtime() ) {
+		return;
+	}
+	lastDrain = par->getcurrtime();
+
+	// links were backlogged in whatever order the senders' threads got here
+	sort(backlog.begin(), backlog.end(), linkOrder);
+	for ( i = 0; i < backlog.size(); i++ ) {
+		en_link *link = backlog[i];
+
+		refill(link);
+		// A frame larger than the bucket may go once the bucket is full
+		while ( link->head && (link->tokens >= link->head->size || link->tokens >= par->LINK_BURST) ) {
+			en_msg *em = link->head;
+			link->head = em->next;
+			link->depth--;
+			link->tokens -= em->size;
+			transmit(em, link);
+		}
+		if ( link->head == NULL ) {
+			link->tail = NULL;
+			link->backlogged = false;
+		}
+		else {
+			// the rest may go on the next time step
+			notify(link->dst, par->getcurrtime() + 1);
+			backlog[kept++] = link;
+		}
+	}
+	backlog.resize(kept);
+}
+
+/**
+ * FUNCTION NAME: advance
+ *
+ * DESCRIPTION: Bring the network up to the current time: send what the links
+ * 				have bandwidth for and deliver every frame whose time has arrived
+ */
+void EmulNet::advance() {
+	if ( !shaped ) {
+		return;
+	}
+	lock_guard<mutex> guard(lock);
+	drainLinks();
+
+	en_msg *em = wheel.advance(par->getcurrtime());
+	while ( em ) {
+		en_msg *next = em->next;
+		deliver(em);
+		em = next;
+	}
+}
+
+/**
+ * FUNCTION NAME: drop
+ *
+ * DESCRIPTION: Account for a frame that was not accepted
+ *
+ * RETURNS:
+ * 0, the size ENsend reports for a dropped frame
+ */
+int EmulNet::drop(int cause) {
+	lastStatus = cause;
+	statusCount[cause]++;
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: setLinkLatency
+ *
+ * DESCRIPTION: Use a different latency distribution for one direction of a link
+ */
+void EmulNet::setLinkLatency(Address *from, Address *to, en_latency lat) {
+	lock_guard<mutex> guard(lock);
+	shaped = true;
+	en_link *link = getLink(*(int *)(from->addr), *(int *)(to->addr));
+	link->haslatency = true;
+	link->latency = lat;
+}
+
+/**
+ * FUNCTION NAME: ENlastStatus
+ *
+ * DESCRIPTION: Outcome of the last ENsend, one of ENsendStatus
+ */
+int EmulNet::ENlastStatus() {
+	return lastStatus;
+}
+
+/**
+ * FUNCTION NAME: ENbacklog
+ *
+ * DESCRIPTION: Number of frames waiting for bandwidth on the link from one node to another
+ */
+int EmulNet::ENbacklog(Address *from, Address *to) {
+	lock_guard<mutex> guard(lock);
+	map<pair<int, int>, en_link>::iterator it = links.find(make_pair(*(int *)(from->addr), *(int *)(to->addr)));
+	return (it == links.end()) ? 0 : it->second.depth;
+}
+
 /**
  * FUNCTION NAME: ENinit
  *
@@ -71,109 +594,235 @@ EmulNet::~EmulNet() {}
  */
 void *EmulNet::ENinit(Address *myaddr, short port) {
 	// Initialize data structures for this member
-	*(int *)(myaddr->addr) = emulnet.nextid++;
+	int id = emulnet.nextid++;
+	*(int *)(myaddr->addr) = id;
     *(short *)(&myaddr->addr[4]) = 0;
+	if ( id >= (int)emulnet.inbox.size() ) {
+		emulnet.inbox.resize(id + 1);
+		traffic.resize(id + 1);
+		seeds.resize(id + 1);
+		sendSeq.resize(id + 1, 0);
+	}
+	seeds[id] = rand();
 	return myaddr;
 }
 
 /**
- * FUNCTION NAME: ENsend
+ * FUNCTION NAME: ENsendv
  *
- * DESCRIPTION: EmulNet send function
+ * DESCRIPTION: Send one payload to n destinations. The payload is copied into
+ * 				the network once and every destination gets a frame referring to
+ * 				it. A destination with a patch (patches[i].len > 0) gets its own
+ * 				copy with those bytes overwritten instead. patches may be NULL.
  *
  * RETURNS:
- * size
+ * number of destinations the payload was accepted for
  */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
+int EmulNet::ENsendv(Address *myaddr, Address *toaddrs, int n, char *data, int size, en_patch *patches) {
 	en_msg *em;
-	static char temp[2048];
-	int sendmsg = rand() % 100;
+	en_msg *body = NULL;
+	int accepted = 0;
+	int src = *(int *)(myaddr->addr);
 
-	if( (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
-		return 0;
+	if ( n > 1 ) {
+		multicasts++;
 	}
+	advance();
 
-	em = (en_msg *)malloc(sizeof(en_msg) + size);
-	em->size = size;
-
-	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
-	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
-	memcpy(em + 1, data, size);
+	for ( int i = 0; i < n; i++ ) {
+		Address *toaddr = &toaddrs[i];
+		int sendmsg = rand_r(&seeds[src]) % 100;
 
-	emulnet.buff[emulnet.currbuffsize++] = em;
+		if ( emulnet.currbuffsize >= ENBUFFSIZE ) {
+			drop(EN_DROP_BUFFFULL);
+			continue;
+		}
+		if ( size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE ) {
+			drop(EN_DROP_OVERSIZE);
+			continue;
+		}
+		if ( par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100) ) {
+			drop(EN_DROP_LOSS);
+			continue;
+		}
 
-	int src = *(int *)(myaddr->addr);
-	int time = par->getcurrtime();
+		int dst = *(int *)(toaddr->addr);
+		en_link *link = NULL;
+		bool wait = false;
+		unique_lock<mutex> guard(lock, defer_lock);
+		if ( shaped ) {
+			guard.lock();
+		}
+		if ( par->LINK_BANDWIDTH > 0 ) {
+			link = getLink(src, dst);
+			refill(link);
+			// No bandwidth left: wait in the egress queue if there is room
+			wait = link->head != NULL || (link->tokens < size && link->tokens < par->LINK_BURST);
+			if ( wait && link->depth >= par->LINK_QUEUE_DEPTH ) {
+				drop(EN_DROP_CONGESTION);
+				continue;
+			}
+		}
+		else if ( !links.empty() ) {
+			map<pair<int, int>, en_link>::iterator it = links.find(make_pair(src, dst));
+			if ( it != links.end() ) {
+				link = &it->second;
+			}
+		}
 
-	assert(src <= MAX_NODES);
-	assert(time < MAX_TIME);
+		if ( n == 1 || (patches != NULL && patches[i].len > 0) ) {
+			// A payload of its own
+			em = pool.alloc(size);
+			em->data = (char *)(em + 1);
+			em->refs = 1;
+			memcpy(em->data, data, size);
+			if ( patches != NULL && patches[i].len > 0 ) {
+				memcpy(em->data + patches[i].offset, patches[i].bytes, patches[i].len);
+			}
+		}
+		else {
+			// A bare header referring to the payload shared by all destinations;
+			// the sender holds a reference of its own until every frame is out
+			if ( body == NULL ) {
+				body = pool.alloc(size);
+				body->data = (char *)(body + 1);
+				body->refs = 1;
+				memcpy(body->data, data, size);
+			}
+			em = pool.alloc(0);
+			em->data = body->data;
+			__atomic_add_fetch(&body->refs, 1, __ATOMIC_RELAXED);
+			shared++;
+		}
+		em->size = size;
+		em->seq = sendSeq[src]++;
 
-	sent_msgs[src][time]++;
+		memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
+		memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
+		emulnet.currbuffsize++;
 
-	#ifdef DEBUGLOG
-		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
-	#endif
+		if ( wait ) {
+			em->next = NULL;
+			if ( link->tail ) {
+				link->tail->next = em;
+			}
+			else {
+				link->head = em;
+			}
+			link->tail = em;
+			link->depth++;
+			if ( !link->backlogged ) {
+				link->backlogged = true;
+				backlog.push_back(link);
+			}
+			// drained from the next time step on
+			notify(link->dst, par->getcurrtime() + 1);
+			lastStatus = EN_QUEUED;
+		}
+		else {
+			if ( par->LINK_BANDWIDTH > 0 ) {
+				link->tokens -= size;
+			}
+			transmit(em, link);
+			lastStatus = EN_SENT;
+		}
+		statusCount[lastStatus]++;
+		accepted++;
 
-	return size;
-}
+		countTraffic(src, true, size);
+	}
 
-/**
- * FUNCTION NAME: ENsend
- *
- * DESCRIPTION: EmulNet send function
- *
- * RETURNS:
- * size
- */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
-	char * str = (char *) malloc(data.length() * sizeof(char));
-	memcpy(str, data.c_str(), data.size());
-	int ret = this->ENsend(myaddr, toaddr, str, (data.length() * sizeof(char)));
-	free(str);
-	return ret;
+	if ( body != NULL ) {
+		ENrelease(body->data);
+	}
+	return accepted;
 }
 
 /**
  * FUNCTION NAME: ENrecv
  *
  * DESCRIPTION: EmulNet receive function
+ * 				Only the inbox of the receiving node is visited, so the cost of a
+ * 				receive is proportional to the number of messages addressed to it.
+ * 				The payload is handed to the queue in place; the node gives it
+ * 				back with ENrelease once it has handled the message.
+ * 				Frames still held back by the link latency are not visible yet.
+ * 				Frames come out grouped by source, each source's in the order it
+ * 				sent them, however the sending threads interleaved.
  *
  * RETURN:
  * 0
  */
 int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
 	// times is always assumed to be 1
-	int i;
-	char* tmp;
+	unsigned int i;
 	int sz;
+	size_t capacity;
 	en_msg *emsg;
+	en_inbox *box;
 
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
+	advance();
+	box = emulnet.getInbox(*(int *)(myaddr->addr));
 
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
+	if ( box == NULL ) {
+		return 0;
+	}
 
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
+	// Take the whole inbox; anything sent while delivering waits for the next call
+	vector<en_msg *> &batch = box->batch;
+	batch.clear();
+	capacity = batch.capacity();
+	for( emsg = box->take(); emsg != NULL; emsg = emsg->next ) {
+		batch.push_back(emsg);
+	}
+	if ( batch.capacity() != capacity ) {
+		batchGrows++;
+	}
+	// Senders on other threads pushed in any order; hand the frames out in one
+	// that only depends on what was sent
+	if ( batch.size() > 1 ) {
+		sort(batch.begin(), batch.end(), frameOrder);
+	}
 
-			(*enq)(queue, (char *)tmp, sz);
+	for( i = 0; i < batch.size(); i++ ) {
+		emsg = batch[i];
+		sz = emsg->size;
+		emulnet.currbuffsize--;
 
-			free(emsg);
+		(*enq)(queue, emsg->data, sz);
+		if ( emsg->data != (char *)(emsg + 1) ) {
+			// only the header belonged to this destination
+			pool.release(emsg);
+		}
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+		countTraffic(*(int *)(myaddr->addr), false, sz);
+	}
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+	return 0;
+}
 
-			recv_msgs[dst][time]++;
-		}
+/**
+ * FUNCTION NAME: ENrelease
+ *
+ * DESCRIPTION: Give back the payload of a message handed out by ENrecv
+ */
+void EmulNet::ENrelease(char *data) {
+	en_msg *body = ENpool::frameOf(data);
+	if ( __atomic_sub_fetch(&body->refs, 1, __ATOMIC_ACQ_REL) == 0 ) {
+		pool.release(body);
 	}
+}
 
-	return 0;
+/**
+ * FUNCTION NAME: discard
+ *
+ * DESCRIPTION: Free a frame that will never be delivered
+ */
+void EmulNet::discard(en_msg *em) {
+	if ( em->data != (char *)(em + 1) ) {
+		ENrelease(em->data);
+	}
+	pool.release(em);
 }
 
 /**
@@ -184,37 +833,79 @@ int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct ti
 int EmulNet::ENcleanup() {
 	emulnet.nextid=0;
 	int i, j;
-	int sent_total, recv_total;
+	unsigned int sent_total, recv_total;
 
 	FILE* file = fopen("msgcount.log", "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	en_msg *em;
+	for ( i = 0; i < (int)emulnet.inbox.size(); i++ ) {
+		em = emulnet.inbox[i].take();
+		while ( em ) {
+			en_msg *next = em->next;
+			discard(em);
+			em = next;
+		}
+	}
+	em = wheel.drain();
+	while ( em ) {
+		en_msg *next = em->next;
+		discard(em);
+		em = next;
+	}
+	for ( i = 0; i < (int)backlog.size(); i++ ) {
+		em = backlog[i]->head;
+		while ( em ) {
+			en_msg *next = em->next;
+			discard(em);
+			em = next;
+		}
+		backlog[i]->head = backlog[i]->tail = NULL;
+		backlog[i]->depth = 0;
+		backlog[i]->backlogged = false;
 	}
+	backlog.clear();
+	emulnet.currbuffsize = 0;
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
 		fprintf(file, "node %3d ", i);
 		sent_total = 0;
 		recv_total = 0;
+		en_traffic none = en_traffic();
+		en_traffic &tr = i < (int)traffic.size() ? traffic[i] : none;
+		auto window = tr.windows.end();
 
 		for (j = 0; j < par->getcurrtime(); j++) {
+			unsigned int sent = 0, recv = 0;
+			if ( j % EN_TRAFFIC_WINDOW == 0 ) {
+				window = tr.windows.find(j / EN_TRAFFIC_WINDOW);
+			}
+			if ( window != tr.windows.end() ) {
+				sent = window->second.sent[j % EN_TRAFFIC_WINDOW];
+				recv = window->second.recv[j % EN_TRAFFIC_WINDOW];
+			}
 
-			sent_total += sent_msgs[i][j];
-			recv_total += recv_msgs[i][j];
+			sent_total += sent;
+			recv_total += recv;
 			if (i != 67) {
-				fprintf(file, " (%4d, %4d)", sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, " (%4u, %4u)", sent, recv);
 				if (j % 10 == 9) {
 					fprintf(file, "\n         ");
 				}
 			}
 			else {
-				fprintf(file, "special %4d %4d %4d\n", j, sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, "special %4d %4u %4u\n", j, sent, recv);
 			}
 		}
 		fprintf(file, "\n");
-		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
+		fprintf(file, "node %3d sent_total %6u  recv_total %6u  sent_bytes %8ld  recv_bytes %8ld\n\n", i, sent_total, recv_total, tr.sentbytes, tr.recvbytes);
 	}
 
+	fprintf(file, "frame pool: allocs %ld  releases %ld  mallocs %ld  batch grows %ld\n", pool.allocs, pool.releases, pool.mallocs, batchGrows.load());
+	fprintf(file, "multicast: sends %ld  shared payloads %ld\n", multicasts.load(), shared.load());
+	fprintf(file, "sends: sent %ld  queued %ld  dropped: buffer full %ld  oversize %ld  loss %ld  congestion %ld\n",
+			statusCount[EN_SENT].load(), statusCount[EN_QUEUED].load(), statusCount[EN_DROP_BUFFFULL].load(),
+			statusCount[EN_DROP_OVERSIZE].load(), statusCount[EN_DROP_LOSS].load(), statusCount[EN_DROP_CONGESTION].load());
+
 	fclose(file);
 	return 0;
 }
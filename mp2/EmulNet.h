@@ -7,13 +7,22 @@
 #ifndef _EMULNET_H_
 #define _EMULNET_H_
 
-#define MAX_NODES 1000
-#define MAX_TIME 3600
 #define ENBUFFSIZE 30000
+// ticks of traffic counted together, see en_traffic
+#define EN_TRAFFIC_WINDOW 64
+// frame size classes of the pool are 64, 128, ..., 4096 bytes
+#define EN_MIN_FRAME 64
+#define EN_NUM_SIZE_CLASSES 7
+#define EN_SLAB_SIZE 65536
+// delivery wheel: EN_WHEEL_LEVELS levels of 2^EN_WHEEL_BITS slots
+#define EN_WHEEL_BITS 6
+#define EN_WHEEL_SLOTS (1 << EN_WHEEL_BITS)
+#define EN_WHEEL_LEVELS 4
 
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "Transport.h"
 
 using namespace std;
 
@@ -27,27 +36,184 @@ typedef struct en_msg {
 	Address from;
 	// Destination node
 	Address to;
+	// Size class of the pool this frame was carved from, -1 if malloc'ed
+	int sizeclass;
+	// Time at which the frame becomes visible to the receiver
+	int deliver;
+	// Payload, right after this header unless the frame shares another frame's payload
+	char *data;
+	// Number of frames still holding this frame's payload, changed atomically
+	int refs;
+	// Position among the frames sent by the source node
+	int seq;
+	// Next frame on the pool free list, in the same wheel slot or in the same inbox
+	struct en_msg *next;
 }en_msg;
 
+/**
+ * Class Name: ENpool
+ *
+ * DESCRIPTION: Slab allocator for en_msg frames. Frames are carved out of
+ * 				EN_SLAB_SIZE slabs and recycled through one free list per size
+ * 				class, so a steady state send/receive does not call malloc.
+ * 				Senders and receivers on any thread may share one pool.
+ */
+class ENpool {
+private:
+	mutex lock;
+	en_msg *freelist[EN_NUM_SIZE_CLASSES];
+	vector<char *> slabs;
+	void refill(int sizeclass);
+public:
+	// malloc calls made for slabs and oversize frames
+	long mallocs;
+	// frames handed out and given back
+	long allocs;
+	long releases;
+	ENpool();
+	virtual ~ENpool();
+	en_msg *alloc(int size);
+	void release(en_msg *em);
+	static en_msg *frameOf(char *payload) {
+		return ((en_msg *)payload) - 1;
+	}
+};
+
+/**
+ * Class Name: ENwheel
+ *
+ * DESCRIPTION: Hierarchical timing wheel holding frames until their delivery
+ * 				time. Level 0 has one slot per time unit; every level above has
+ * 				slots EN_WHEEL_SLOTS times as wide and is cascaded into the level
+ * 				below whenever that level wraps around.
+ */
+class ENwheel {
+private:
+	int now;
+	en_msg *slots[EN_WHEEL_LEVELS][EN_WHEEL_SLOTS];
+	en_msg *overflow;
+	void place(en_msg *em);
+public:
+	// frames held by the wheel
+	int pending;
+	ENwheel();
+	void insert(en_msg *em);
+	en_msg *advance(int to);
+	en_msg *drain();
+};
+
+/**
+ * Struct Name: en_latency
+ *
+ * DESCRIPTION: Latency distribution of a link, see latencyTYPE in Params.h
+ */
+typedef struct en_latency {
+	int model;
+	double min;
+	double max;
+	double mean;
+	double sigma;
+	int sample(unsigned int *seed);
+}en_latency;
+
+/**
+ * Struct Name: en_link
+ *
+ * DESCRIPTION: State of one direction of a link: an optional latency override,
+ * 				the token bucket and the frames waiting for bandwidth
+ */
+typedef struct en_link {
+	int src;
+	int dst;
+	bool haslatency;
+	en_latency latency;
+	double tokens;
+	int refilled;
+	// egress queue, linked through en_msg::next
+	en_msg *head;
+	en_msg *tail;
+	int depth;
+	bool backlogged;
+}en_link;
+
+/**
+ * Outcome of the last send, EN_SENT and EN_QUEUED mean the frame was accepted
+ */
+enum ENsendStatus {
+	EN_SENT,
+	EN_QUEUED,
+	EN_DROP_BUFFFULL,
+	EN_DROP_OVERSIZE,
+	EN_DROP_LOSS,
+	EN_DROP_CONGESTION,
+	EN_NUM_STATUS
+};
+
+/**
+ * Struct Name: en_traffic_window
+ *
+ * DESCRIPTION: Messages sent and received by one node in each of
+ * 				EN_TRAFFIC_WINDOW consecutive ticks
+ */
+typedef struct en_traffic_window {
+	unsigned int sent[EN_TRAFFIC_WINDOW];
+	unsigned int recv[EN_TRAFFIC_WINDOW];
+}en_traffic_window;
+
+/**
+ * Struct Name: en_traffic
+ *
+ * DESCRIPTION: Traffic of one node: the windows of ticks it sent or received
+ * 				anything in, by window number, and its bytes over the whole run.
+ * 				A window with no traffic takes no memory.
+ */
+typedef struct en_traffic {
+	map<int, en_traffic_window> windows;
+	long sentbytes;
+	long recvbytes;
+}en_traffic;
+
+/**
+ * Struct Name: en_inbox
+ *
+ * DESCRIPTION: Frames delivered to one node. Any number of threads may push;
+ * 				only the thread running the node takes them out.
+ */
+typedef struct en_inbox {
+	// newest frame first, linked through en_msg::next
+	atomic<en_msg *> head;
+	// frames of the receive in progress, kept from one receive to the next
+	// so a steady state receive does not allocate
+	vector<en_msg *> batch;
+	en_inbox(): head(NULL) {}
+	en_inbox(const en_inbox &another): head(another.head.load()) {}
+	en_inbox& operator = (const en_inbox &another) {
+		head.store(another.head.load());
+		return *this;
+	}
+	void push(en_msg *em);
+	en_msg *take();
+}en_inbox;
+
 /**
  * Class Name: EM
+ *
+ * DESCRIPTION: Messages in flight, kept in one inbox per destination node id
+ * 				so that a receive only touches the frames addressed to that node.
+ * 				Inboxes are added by ENinit, before any node runs.
  */
 class EM {
 public:
 	int nextid;
-	int currbuffsize;
+	atomic<int> currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
+	vector<en_inbox> inbox;
 	EM() {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->inbox = anotherEM.inbox;
 		return *this;
 	}
 	int getNextId() {
@@ -68,6 +234,12 @@ public:
 	void setFirstEltIndex(int firsteltindex) {
 		this->firsteltindex = firsteltindex;
 	}
+	en_inbox * getInbox(int id) {
+		if ( id < 0 || id >= (int)inbox.size() ) {
+			return NULL;
+		}
+		return &inbox[id];
+	}
 	virtual ~EM() {}
 };
 
@@ -75,24 +247,63 @@ public:
  * CLASS NAME: EmulNet
  *
  * DESCRIPTION: This class defines an emulated network
+ * 				Nodes may send and receive from different threads as long as
+ * 				each node is run by one thread at a time. Without a latency or
+ * 				bandwidth model a frame goes straight to the lock-free inbox of
+ * 				its destination; the wheel and the links are shared under a lock.
  */
-class EmulNet
+class EmulNet : public Transport
 { 	
 private:
 	Params* par;
-	int sent_msgs[MAX_NODES + 1][MAX_TIME];
-	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	// Per node traffic, grown on demand by the thread running the node
+	vector<en_traffic> traffic;
+	// Per node random stream and number of frames sent, used by the thread running the node
+	vector<unsigned int> seeds;
+	vector<int> sendSeq;
 	int enInited;
 	EM emulnet;
+	ENwheel wheel;
+	// Latency of every link without an override
+	en_latency latency;
+	// Links with an override or a token bucket, keyed by (source id, destination id)
+	map<pair<int, int>, en_link> links;
+	// Links with frames waiting for bandwidth
+	vector<en_link *> backlog;
+	int lastDrain;
+	// latency or bandwidth is modelled, so frames go through the wheel and links
+	bool shaped;
+	// guards the wheel, the links and the backlog
+	mutex lock;
+	static thread_local int lastStatus;
+	atomic<long> statusCount[EN_NUM_STATUS];
+	void countTraffic(int node, bool sent, int size);
+	en_link *getLink(int src, int dst);
+	void refill(en_link *link);
+	void transmit(en_msg *em, en_link *link);
+	void deliver(en_msg *em);
+	void drainLinks();
+	void advance();
+	int drop(int cause);
+	void discard(en_msg *em);
+	// multicast sends and how many destinations shared one payload
+	atomic<long> multicasts;
+	atomic<long> shared;
+	// receives that had to grow their inbox's batch buffer
+	atomic<long> batchGrows;
+	ENpool pool;
 public:
  	EmulNet(Params *p);
  	EmulNet(EmulNet &anotherEmulNet);
  	EmulNet& operator = (EmulNet &anotherEmulNet);
  	virtual ~EmulNet();
 	void *ENinit(Address *myaddr, short port);
-	int ENsend(Address *myaddr, Address *toaddr, string data);
-	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
+	int ENsendv(Address *myaddr, Address *toaddrs, int n, char *data, int size, en_patch *patches);
 	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	void ENrelease(char *data);
+	void setLinkLatency(Address *from, Address *to, en_latency lat);
+	int ENlastStatus();
+	int ENbacklog(Address *from, Address *to);
 	int ENcleanup();
 };
 
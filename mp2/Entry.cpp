@@ -1,5 +1,5 @@
 /**********************************
- * FILE NAME: Application.h
+ * FILE NAME: Entry.cpp
  *
  * DESCRIPTION: Entry class definition
  **********************************/
@@ -8,41 +8,107 @@
 /**
  * constructor
  */
-Entry::Entry(string _value, int _timestamp, ReplicaType _replica){
-	this->delimiter = ":";
+Entry::Entry(string _value, unsigned long long _timestamp, int _replica){
 	value = _value;
 	timestamp = _timestamp;
 	replica = _replica;
+	tombstone = false;
 }
 
 /**
  * constructor
  *
- * DESCRIPTION: Convert string to get an Entry object
+ * DESCRIPTION: Decode a record written by toBytes(). A record that is not one
+ * 				gives an empty value with timestamp 0.
  */
-Entry::Entry(string entry){
-	vector<string> tuple;
-	this->delimiter = ":";
-	size_t pos = entry.find(delimiter);
-	size_t start = 0;
-	while (pos != string::npos) {
-		string field = entry.substr(start, pos-start);
-		tuple.push_back(field);
-		start = pos + delimiter.size();
-		pos = entry.find(delimiter, start);
+Entry::Entry(string_view record){
+	entry_header header;
+
+	value = "";
+	timestamp = 0;
+	replica = PRIMARY;
+	tombstone = false;
+	if ( record.size() < sizeof(entry_header) ) {
+		return;
+	}
+	memcpy(&header, record.data(), sizeof(entry_header));
+	if ( header.valuelen > record.size() - sizeof(entry_header) ) {
+		return;
 	}
-	tuple.push_back(entry.substr(start));
+	value.assign(record.data() + sizeof(entry_header), header.valuelen);
+	timestamp = header.timestamp;
+	replica = header.replica;
+	tombstone = (header.flags & ENTRY_TOMBSTONE) != 0;
+}
+
+/**
+ * FUNCTION NAME: toBytes
+ *
+ * DESCRIPTION: Convert the object to its record: an entry_header, then the value
+ */
+string Entry::toBytes() {
+	string record;
+
+	encode(record, value, timestamp, replica, tombstone ? ENTRY_TOMBSTONE : 0);
+	return record;
+}
+
+/**
+ * FUNCTION NAME: encode
+ *
+ * DESCRIPTION: Write the record of an entry into out without building an Entry
+ */
+void Entry::encode(string &out, string_view value, unsigned long long timestamp, int replica, int flags) {
+	entry_header header;
+
+	memset(&header, 0, sizeof(entry_header));
+	header.timestamp = timestamp;
+	header.valuelen = value.size();
+	header.replica = replica;
+	header.flags = flags;
+	out.clear();
+	out.append((char *)&header, sizeof(entry_header));
+	out.append(value.data(), value.size());
+}
+
+/**
+ * FUNCTION NAME: view
+ *
+ * DESCRIPTION: Read a record in place. value points into the record.
+ *
+ * RETURNS:
+ * true if the record is well formed
+ * false otherwise, with an empty value and timestamp 0
+ */
+bool Entry::view(string_view record, string_view &value, unsigned long long &timestamp) {
+	entry_header header;
 
-	value = tuple.at(0);
-	timestamp = stoi(tuple.at(1));
-	replica = static_cast<ReplicaType>(stoi(tuple.at(2)));
+	value = string_view();
+	timestamp = 0;
+	if ( record.size() < sizeof(entry_header) ) {
+		return false;
+	}
+	memcpy(&header, record.data(), sizeof(entry_header));
+	if ( header.valuelen > record.size() - sizeof(entry_header) ) {
+		return false;
+	}
+	value = record.substr(sizeof(entry_header), header.valuelen);
+	timestamp = header.timestamp;
+	return true;
 }
 
 /**
- * FUNCTION NAME: converToString
+ * FUNCTION NAME: isTombstone
  *
- * DESCRIPTION: Convert the object to a string representation
+ * RETURNS:
+ * true if the record is the tombstone a delete left
  */
-string Entry::convertToString() {
-	return value + delimiter + to_string(timestamp) + delimiter + to_string(replica);
+bool Entry::isTombstone(string_view record) {
+	entry_header header;
+
+	if ( record.size() < sizeof(entry_header) ) {
+		return false;
+	}
+	memcpy(&header, record.data(), sizeof(entry_header));
+	return (header.flags & ENTRY_TOMBSTONE) != 0;
 }
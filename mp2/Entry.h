@@ -1,25 +1,56 @@
 /**********************************
- * FILE NAME: Application.h
+ * FILE NAME: Entry.h
  *
  * DESCRIPTION: Header file Entry class
  **********************************/
 
+#ifndef ENTRY_H_
+#define ENTRY_H_
+
 #include "stdincludes.h"
 #include "Message.h"
 
+/**
+ * Struct Name: entry_header
+ *
+ * DESCRIPTION: Fixed part of a stored entry, followed by valuelen bytes of
+ * 				value. timestamp is the version the coordinator gave the write
+ * 				(see MP2Node::stamp); the larger one wins. A delete leaves a
+ * 				record with ENTRY_TOMBSTONE set and no value, so it competes
+ * 				with the writes to the key like any other write.
+ */
+typedef struct entry_header {
+	unsigned long long timestamp;
+	unsigned int valuelen;
+	unsigned char replica;
+	unsigned char flags;
+	char pad[2];
+}entry_header;
+
+// entry_header::flags: the key was deleted at timestamp
+#define ENTRY_TOMBSTONE 0x01
+
 /**
  * CLASS NAME: Entry
  *
- * DESCRIPTION: This class describes the entry for each key in the DHT
+ * DESCRIPTION: This class describes the entry for each key in the DHT. The
+ * 				hash table holds it as the record written by toBytes().
  */
 class Entry{
 public:
 	string value;
-	int timestamp;
-	ReplicaType replica;
-	string delimiter;
+	unsigned long long timestamp;
+	int replica;
+	bool tombstone;
 
-	Entry(string entry);
-	Entry(string _value, int _timestamp, ReplicaType _replica);
-	string convertToString();
+	Entry(string_view record);
+	Entry(string _value, unsigned long long _timestamp, int _replica);
+	string toBytes();
+	// write a record into out, reusing its buffer
+	static void encode(string &out, string_view value, unsigned long long timestamp, int replica, int flags = 0);
+	// read the value and timestamp of a record without copying the value
+	static bool view(string_view record, string_view &value, unsigned long long &timestamp);
+	static bool isTombstone(string_view record);
 };
+
+#endif /* ENTRY_H_ */
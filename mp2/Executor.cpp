@@ -0,0 +1,123 @@
+/**********************************
+ * FILE NAME: Executor.cpp
+ *
+ * DESCRIPTION: Thread pool running the nodes of a tick
+ **********************************/
+
+#include "Executor.h"
+
+/**
+ * Constructor
+ *
+ * Starts workers - 1 threads; the thread calling run is the last worker
+ */
+Executor::Executor(int workers) {
+	jobSize = 0;
+	chunk = 1;
+	next = 0;
+	generation = 0;
+	busy = 0;
+	stopping = false;
+	for ( int i = 1; i < workers; i++ ) {
+		threads.push_back(thread(&Executor::work, this));
+	}
+}
+
+/**
+ * Destructor
+ */
+Executor::~Executor() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	started.notify_all();
+	for ( unsigned int i = 0; i < threads.size(); i++ ) {
+		threads[i].join();
+	}
+}
+
+/**
+ * FUNCTION NAME: size
+ *
+ * DESCRIPTION: Number of threads running a job, the caller included
+ */
+int Executor::size() {
+	return threads.size() + 1;
+}
+
+/**
+ * FUNCTION NAME: runChunks
+ *
+ * DESCRIPTION: Take chunks of the current job's indices until none are left
+ */
+void Executor::runChunks() {
+	int first;
+
+	while ( (first = next.fetch_add(chunk)) < jobSize ) {
+		int last = min(first + chunk, jobSize);
+		for ( int i = first; i < last; i++ ) {
+			job(i);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: work
+ *
+ * DESCRIPTION: Loop of a pool thread: wait for a job, help with it, report back
+ */
+void Executor::work() {
+	long seen = 0;
+
+	while ( true ) {
+		{
+			unique_lock<mutex> guard(lock);
+			started.wait(guard, [&] { return stopping || generation != seen; });
+			if ( stopping ) {
+				return;
+			}
+			seen = generation;
+		}
+
+		runChunks();
+
+		{
+			lock_guard<mutex> guard(lock);
+			if ( --busy == 0 ) {
+				finished.notify_one();
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Call fn(i) for every i in [0, n) and wait until all calls returned
+ */
+void Executor::run(int n, function<void(int)> fn) {
+	if ( threads.empty() ) {
+		for ( int i = 0; i < n; i++ ) {
+			fn(i);
+		}
+		return;
+	}
+
+	{
+		lock_guard<mutex> guard(lock);
+		job = fn;
+		jobSize = n;
+		// a few chunks per thread keeps them busy without contending on next
+		chunk = max(1, n / (size() * 8));
+		next = 0;
+		busy = threads.size();
+		generation++;
+	}
+	started.notify_all();
+
+	runChunks();
+
+	unique_lock<mutex> guard(lock);
+	finished.wait(guard, [&] { return busy == 0; });
+}
@@ -0,0 +1,48 @@
+/**********************************
+ * FILE NAME: Executor.h
+ *
+ * DESCRIPTION: Header file of the thread pool running the nodes of a tick
+ **********************************/
+
+#ifndef _EXECUTOR_H_
+#define _EXECUTOR_H_
+
+#include "stdincludes.h"
+#include <thread>
+#include <condition_variable>
+#include <functional>
+
+/**
+ * CLASS NAME: Executor
+ *
+ * DESCRIPTION: Runs a job for every node index of a phase on a fixed set of
+ * 				threads. The calling thread takes part, and run only returns when
+ * 				every index is done, so consecutive phases are separated by a
+ * 				barrier. With one worker the job runs on the calling thread in
+ * 				index order.
+ */
+class Executor {
+private:
+	vector<thread> threads;
+	mutex lock;
+	condition_variable started;
+	condition_variable finished;
+	function<void(int)> job;
+	int jobSize;
+	int chunk;
+	atomic<int> next;
+	// bumped for every job so a worker can tell a new one from a spurious wakeup
+	long generation;
+	// workers still in the current job
+	int busy;
+	bool stopping;
+	void work();
+	void runChunks();
+public:
+	Executor(int workers);
+	virtual ~Executor();
+	int size();
+	void run(int n, function<void(int)> fn);
+};
+
+#endif /* _EXECUTOR_H_ */
@@ -0,0 +1,493 @@
+/**********************************
+ * FILE NAME: FlatTable.cpp
+ *
+ * DESCRIPTION: Definition of FlatTable class functions
+ **********************************/
+
+#include "FlatTable.h"
+
+/**
+ * Constructor of the FlatTable class
+ */
+FlatTable::FlatTable() {
+	ctrl = NULL;
+	slots = NULL;
+	capacity = 0;
+	used = 0;
+	growthLeft = 0;
+	arena = NULL;
+	arenaUsed = 0;
+	arenaCapacity = 0;
+	arenaFree = 0;
+	for ( int i = 0; i < FT_CLASSES; i++ ) {
+		freeList[i] = FT_NONE;
+	}
+}
+
+/**
+ * Destructor of the FlatTable class
+ */
+FlatTable::~FlatTable() {
+	clear();
+}
+
+/**
+ * FUNCTION NAME: hashOf
+ *
+ * DESCRIPTION: Hash of a key; the low 7 bits go to the control byte, the rest pick the group.
+ * 				std::hash is mixed again, the same way as for the key's token
+ * 				(KVStore::tokenOf): the keys of a HashTable partition share the
+ * 				top bits, which only a table of 2^48 groups would use.
+ */
+size_t FlatTable::hashOf(string_view key) {
+	unsigned long long h = std::hash<string_view>()(key);
+
+	// finalizer of MurmurHash3
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+/**
+ * FUNCTION NAME: matchGroup
+ *
+ * RETURNS:
+ * bit i set for every control byte i of the group equal to h2
+ */
+unsigned int FlatTable::matchGroup(const signed char *group, signed char h2) {
+#ifdef __SSE2__
+	__m128i bytes = _mm_loadu_si128((const __m128i *)group);
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8(h2)));
+#else
+	unsigned int mask = 0;
+	for ( int i = 0; i < FT_GROUP; i++ ) {
+		if ( group[i] == h2 ) {
+			mask |= 1u << i;
+		}
+	}
+	return mask;
+#endif
+}
+
+/**
+ * FUNCTION NAME: sizeClass
+ *
+ * RETURNS:
+ * arena size class of len bytes, len > 0
+ */
+int FlatTable::sizeClass(size_t len) {
+	if ( len <= FT_SMALL_CLASS ) {
+		return (len + 7) / 8 - 1;
+	}
+	// FT_SMALL_CLASS * 2 is the first power of two class
+	return FT_SMALL_CLASS / 8 + (64 - __builtin_clzl(len - 1)) - 9;
+}
+
+/**
+ * FUNCTION NAME: classBytes
+ *
+ * RETURNS:
+ * bytes of arena a block of the size class takes
+ */
+size_t FlatTable::classBytes(int sizeClass) {
+	if ( sizeClass < FT_SMALL_CLASS / 8 ) {
+		return (sizeClass + 1) * 8;
+	}
+	return (size_t)1 << (sizeClass - FT_SMALL_CLASS / 8 + 9);
+}
+
+/**
+ * FUNCTION NAME: allocate
+ *
+ * DESCRIPTION: Take a block for len bytes from its free list, or from the end of
+ * 				the arena. Growing the arena moves it.
+ *
+ * RETURNS:
+ * offset of the block in the arena
+ */
+unsigned int FlatTable::allocate(size_t len) {
+	int c = sizeClass(len);
+	size_t bytes = classBytes(c);
+	unsigned int offset;
+
+	if ( freeList[c] != FT_NONE ) {
+		offset = freeList[c];
+		memcpy(&freeList[c], arena + offset, sizeof(unsigned int));
+		arenaFree -= bytes;
+		return offset;
+	}
+	assert(arenaUsed + bytes < FT_NONE);
+	if ( arenaUsed + bytes > arenaCapacity ) {
+		size_t newCapacity = arenaCapacity ? arenaCapacity * 2 : 1024;
+		while ( newCapacity < arenaUsed + bytes ) {
+			newCapacity *= 2;
+		}
+		arena = (char *) realloc(arena, newCapacity);
+		arenaCapacity = newCapacity;
+	}
+	offset = arenaUsed;
+	arenaUsed += bytes;
+	return offset;
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Put the block of len bytes at offset on the free list of its size class
+ */
+void FlatTable::release(unsigned int offset, size_t len) {
+	int c = sizeClass(len);
+
+	// blocks are at least 8 bytes, room for the link
+	memcpy(arena + offset, &freeList[c], sizeof(unsigned int));
+	freeList[c] = offset;
+	arenaFree += classBytes(c);
+}
+
+/**
+ * FUNCTION NAME: store
+ *
+ * DESCRIPTION: Copy bytes, which must not lie in the arena, into a new block
+ *
+ * RETURNS:
+ * offset of the block, 0 for no bytes
+ */
+unsigned int FlatTable::store(string_view bytes) {
+	unsigned int offset;
+
+	if ( bytes.empty() ) {
+		return 0;
+	}
+	offset = allocate(bytes.size());
+	memcpy(arena + offset, bytes.data(), bytes.size());
+	return offset;
+}
+
+/**
+ * FUNCTION NAME: keyOf
+ */
+string_view FlatTable::keyOf(ft_slot *slot) {
+	if ( slot->keylen <= FT_INLINE_KEY ) {
+		return string_view(slot->key.bytes, slot->keylen);
+	}
+	return string_view(arena + slot->key.offset, slot->keylen);
+}
+
+/**
+ * FUNCTION NAME: valueOf
+ */
+string_view FlatTable::valueOf(ft_slot *slot) {
+	if ( slot->valuelen == 0 ) {
+		return string_view();
+	}
+	return string_view(arena + slot->value, slot->valuelen);
+}
+
+/**
+ * FUNCTION NAME: entryAt
+ */
+ft_entry FlatTable::entryAt(size_t index) {
+	ft_entry entry;
+
+	entry.first = keyOf(&slots[index]);
+	entry.second = valueOf(&slots[index]);
+	return entry;
+}
+
+/**
+ * FUNCTION NAME: destroy
+ *
+ * DESCRIPTION: Give the arena blocks of a slot back
+ */
+void FlatTable::destroy(ft_slot *slot) {
+	if ( slot->keylen > FT_INLINE_KEY ) {
+		release(slot->key.offset, slot->keylen);
+	}
+	if ( slot->valuelen > 0 ) {
+		release(slot->value, slot->valuelen);
+	}
+}
+
+/**
+ * FUNCTION NAME: findIndex
+ *
+ * RETURNS:
+ * slot of key, capacity if it is not in the table
+ */
+size_t FlatTable::findIndex(string_view key, size_t hash) {
+	size_t groups = capacity / FT_GROUP;
+	size_t g, step;
+	signed char h2 = hash & 0x7F;
+
+	if ( capacity == 0 ) {
+		return capacity;
+	}
+	g = (hash >> 7) & (groups - 1);
+	for ( step = 1; step <= groups; step++ ) {
+		const signed char *group = ctrl + g * FT_GROUP;
+		unsigned int match = matchGroup(group, h2);
+		while ( match ) {
+			size_t index = g * FT_GROUP + __builtin_ctz(match);
+			if ( slots[index].keylen == key.size() && keyOf(&slots[index]) == key ) {
+				return index;
+			}
+			match &= match - 1;
+		}
+		if ( matchGroup(group, FT_EMPTY) ) {
+			// the key would have been put here
+			return capacity;
+		}
+		// triangular steps visit every group once
+		g = (g + step) & (groups - 1);
+	}
+	return capacity;
+}
+
+/**
+ * FUNCTION NAME: freeIndex
+ *
+ * RETURNS:
+ * first empty or erased slot on the probe sequence of hash
+ */
+size_t FlatTable::freeIndex(size_t hash) {
+	size_t groups = capacity / FT_GROUP;
+	size_t g = (hash >> 7) & (groups - 1);
+	size_t step;
+
+	for ( step = 1; ; step++ ) {
+		const signed char *group = ctrl + g * FT_GROUP;
+		for ( int i = 0; i < FT_GROUP; i++ ) {
+			if ( group[i] < 0 ) {
+				return g * FT_GROUP + i;
+			}
+		}
+		g = (g + step) & (groups - 1);
+	}
+}
+
+/**
+ * FUNCTION NAME: rehash
+ *
+ * DESCRIPTION: Move every entry to a table of newCapacity slots, dropping the
+ * 				erased ones. The slots keep their arena blocks.
+ */
+void FlatTable::rehash(size_t newCapacity) {
+	signed char *oldCtrl = ctrl;
+	ft_slot *oldSlots = slots;
+	size_t oldCapacity = capacity;
+	size_t i;
+
+	ctrl = (signed char *) malloc(newCapacity);
+	memset(ctrl, FT_EMPTY, newCapacity);
+	slots = (ft_slot *) malloc(newCapacity * sizeof(ft_slot));
+	capacity = newCapacity;
+	growthLeft = newCapacity - newCapacity / 8 - used;
+
+	for ( i = 0; i < oldCapacity; i++ ) {
+		if ( oldCtrl[i] >= 0 ) {
+			size_t hash = hashOf(keyOf(&oldSlots[i]));
+			size_t index = freeIndex(hash);
+			ctrl[index] = hash & 0x7F;
+			slots[index] = oldSlots[i];
+		}
+	}
+	free(oldCtrl);
+	free(oldSlots);
+
+	if ( arenaFree * 2 > arenaUsed ) {
+		compact();
+	}
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: Copy the live blocks into a new arena without gaps and forget
+ * 				the free lists
+ */
+void FlatTable::compact() {
+	char *oldArena = arena;
+	size_t i;
+
+	arena = NULL;
+	arenaCapacity = 0;
+	arenaUsed = 0;
+	arenaFree = 0;
+	for ( i = 0; i < FT_CLASSES; i++ ) {
+		freeList[i] = FT_NONE;
+	}
+	for ( i = 0; i < capacity; i++ ) {
+		ft_slot *slot = &slots[i];
+		if ( ctrl[i] < 0 ) {
+			continue;
+		}
+		if ( slot->keylen > FT_INLINE_KEY ) {
+			slot->key.offset = store(string_view(oldArena + slot->key.offset, slot->keylen));
+		}
+		if ( slot->valuelen > 0 ) {
+			slot->value = store(string_view(oldArena + slot->value, slot->valuelen));
+		}
+	}
+	free(oldArena);
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * RETURNS:
+ * the entry of key, end() if there is none
+ */
+FlatTable::iterator FlatTable::find(string_view key) {
+	return iterator(this, findIndex(key, hashOf(key)));
+}
+
+/**
+ * FUNCTION NAME: emplace
+ *
+ * DESCRIPTION: Insert key with value unless key is already there, as std::map does
+ *
+ * RETURNS:
+ * the entry of key and whether it was inserted
+ */
+pair<FlatTable::iterator, bool> FlatTable::emplace(string_view key, string_view value) {
+	size_t hash = hashOf(key);
+	size_t index = findIndex(key, hash);
+	ft_slot slot;
+
+	if ( index < capacity ) {
+		return make_pair(iterator(this, index), false);
+	}
+	if ( growthLeft == 0 ) {
+		// double, unless erased slots are most of what fills the table
+		if ( capacity == 0 ) {
+			rehash(FT_GROUP);
+		}
+		else if ( used >= (capacity - capacity / 8) / 2 ) {
+			rehash(capacity * 2);
+		}
+		else {
+			rehash(capacity);
+		}
+	}
+
+	memset(&slot, 0, sizeof(slot));
+	slot.keylen = key.size();
+	if ( key.size() <= FT_INLINE_KEY ) {
+		memcpy(slot.key.bytes, key.data(), key.size());
+	}
+	else {
+		slot.key.offset = store(key);
+	}
+	slot.valuelen = value.size();
+	slot.value = store(value);
+
+	index = freeIndex(hash);
+	if ( ctrl[index] == FT_EMPTY ) {
+		growthLeft--;
+	}
+	ctrl[index] = hash & 0x7F;
+	slots[index] = slot;
+	used++;
+	return make_pair(iterator(this, index), true);
+}
+
+/**
+ * FUNCTION NAME: assign
+ *
+ * DESCRIPTION: Replace the value of the entry it points to. The old block is
+ * 				reused when the new value falls in the same size class.
+ */
+void FlatTable::assign(iterator it, string_view value) {
+	ft_slot *slot;
+
+	if ( it.index >= capacity || ctrl[it.index] < 0 ) {
+		return;
+	}
+	slot = &slots[it.index];
+	if ( slot->valuelen > 0 && value.size() > 0 && sizeClass(slot->valuelen) == sizeClass(value.size()) ) {
+		memmove(arena + slot->value, value.data(), value.size());
+	}
+	else {
+		if ( slot->valuelen > 0 ) {
+			release(slot->value, slot->valuelen);
+		}
+		slot->value = store(value);
+	}
+	slot->valuelen = value.size();
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * DESCRIPTION: Remove the entry it points to
+ */
+void FlatTable::erase(iterator it) {
+	if ( it.index >= capacity || ctrl[it.index] < 0 ) {
+		return;
+	}
+	destroy(&slots[it.index]);
+	ctrl[it.index] = FT_DELETED;
+	used--;
+}
+
+/**
+ * FUNCTION NAME: erase
+ *
+ * RETURNS:
+ * number of entries removed, 0 or 1
+ */
+size_t FlatTable::erase(string_view key) {
+	iterator it = find(key);
+
+	if ( it == end() ) {
+		return 0;
+	}
+	erase(it);
+	return 1;
+}
+
+/**
+ * FUNCTION NAME: count
+ *
+ * RETURNS:
+ * 1 if key is in the table, 0 otherwise
+ */
+size_t FlatTable::count(string_view key) {
+	return find(key) == end() ? 0 : 1;
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Remove every entry and give the memory back
+ */
+void FlatTable::clear() {
+	free(ctrl);
+	free(slots);
+	free(arena);
+	ctrl = NULL;
+	slots = NULL;
+	capacity = 0;
+	used = 0;
+	growthLeft = 0;
+	arena = NULL;
+	arenaUsed = 0;
+	arenaCapacity = 0;
+	arenaFree = 0;
+	for ( int i = 0; i < FT_CLASSES; i++ ) {
+		freeList[i] = FT_NONE;
+	}
+}
+
+/**
+ * FUNCTION NAME: bytesUsed
+ *
+ * RETURNS:
+ * bytes held by the table
+ */
+size_t FlatTable::bytesUsed() {
+	return capacity * (1 + sizeof(ft_slot)) + arenaCapacity;
+}
@@ -0,0 +1,185 @@
+/**********************************
+ * FILE NAME: FlatTable.h
+ *
+ * DESCRIPTION: Header file of the open addressing table behind HashTable
+ **********************************/
+
+#ifndef FLATTABLE_H_
+#define FLATTABLE_H_
+
+#include "stdincludes.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Macros
+ */
+// slots whose control bytes are probed together
+#define FT_GROUP 16
+// control byte of a slot that never held an entry; ends a probe
+#define FT_EMPTY ((signed char)0x80)
+// control byte of a slot whose entry was erased; a probe goes on past it
+#define FT_DELETED ((signed char)0xFE)
+// keys up to this long are kept in the slot itself
+#define FT_INLINE_KEY 12
+// arena size classes: multiples of 8 bytes up to FT_SMALL_CLASS, then powers of two
+#define FT_SMALL_CLASS 256
+#define FT_CLASSES 56
+// end of a free list
+#define FT_NONE 0xFFFFFFFFu
+
+/**
+ * Struct Name: ft_slot
+ *
+ * DESCRIPTION: An entry of the table. The key is in the slot when it is at most
+ * 				FT_INLINE_KEY bytes, otherwise in the arena like the value.
+ * 				Arena positions are 32 bit, so a table holds at most 4 GiB of
+ * 				keys and values.
+ */
+typedef struct ft_slot {
+	unsigned int keylen;
+	union {
+		char bytes[FT_INLINE_KEY];
+		unsigned int offset;
+	} key;
+	unsigned int value;
+	unsigned int valuelen;
+}ft_slot;
+
+/**
+ * Struct Name: ft_entry
+ *
+ * DESCRIPTION: What iterating the table gives: views of the key and value,
+ * 				valid until the table is changed
+ */
+typedef struct ft_entry {
+	string_view first;
+	string_view second;
+}ft_entry;
+
+/**
+ * CLASS NAME: FlatTable
+ *
+ * DESCRIPTION: String to string table with open addressing in the style of a
+ * 				Swiss table. Every slot has a control byte holding 7 bits of
+ * 				the hash of its key, or FT_EMPTY / FT_DELETED. A lookup
+ * 				compares the 16 control bytes of a group at once (SSE2 when
+ * 				available) and only looks at the keys of the matching slots;
+ * 				groups are probed quadratically. The table is kept at most 7/8
+ * 				full, counting erased slots.
+ *
+ * 				Keys and values are stored in one append-only arena per table.
+ * 				The space of an updated or erased value goes to a free list of
+ * 				its size class for the next value of that class, and the arena
+ * 				is compacted when the table is rehashed with more than half of
+ * 				it free.
+ *
+ * 				It has the part of the std::map interface HashTable uses.
+ * 				Iteration order is the slot order, not the key order.
+ */
+class FlatTable {
+public:
+	typedef ft_entry value_type;
+
+	/**
+	 * CLASS NAME: iterator
+	 *
+	 * DESCRIPTION: Walks the full slots
+	 */
+	class iterator {
+	private:
+		FlatTable *table;
+		size_t index;
+		// what operator-> points to
+		ft_entry entry;
+		void skip() {
+			while ( index < table->capacity && table->ctrl[index] < 0 ) {
+				index++;
+			}
+		}
+	public:
+		iterator() : table(NULL), index(0) {}
+		iterator(FlatTable *table, size_t index) : table(table), index(index) {
+			skip();
+		}
+		ft_entry operator*() const {
+			return table->entryAt(index);
+		}
+		ft_entry *operator->() {
+			entry = table->entryAt(index);
+			return &entry;
+		}
+		iterator &operator++() {
+			index++;
+			skip();
+			return *this;
+		}
+		bool operator==(const iterator &other) const {
+			return index == other.index;
+		}
+		bool operator!=(const iterator &other) const {
+			return index != other.index;
+		}
+		friend class FlatTable;
+	};
+
+private:
+	// capacity control bytes and slots; capacity is 0 or a power of two >= FT_GROUP
+	signed char *ctrl;
+	ft_slot *slots;
+	size_t capacity;
+	size_t used;
+	// slots that may still turn from empty to full before the table grows
+	size_t growthLeft;
+	// keys and values
+	char *arena;
+	size_t arenaUsed;
+	size_t arenaCapacity;
+	// bytes on the free lists
+	size_t arenaFree;
+	unsigned int freeList[FT_CLASSES];
+	static size_t hashOf(string_view key);
+	static unsigned int matchGroup(const signed char *group, signed char h2);
+	static int sizeClass(size_t len);
+	static size_t classBytes(int sizeClass);
+	unsigned int allocate(size_t len);
+	void release(unsigned int offset, size_t len);
+	unsigned int store(string_view bytes);
+	string_view keyOf(ft_slot *slot);
+	string_view valueOf(ft_slot *slot);
+	ft_entry entryAt(size_t index);
+	void destroy(ft_slot *slot);
+	size_t findIndex(string_view key, size_t hash);
+	size_t freeIndex(size_t hash);
+	void rehash(size_t newCapacity);
+	void compact();
+
+public:
+	FlatTable();
+	FlatTable(const FlatTable &other) = delete;
+	FlatTable &operator=(const FlatTable &other) = delete;
+	virtual ~FlatTable();
+	iterator begin() {
+		return iterator(this, 0);
+	}
+	iterator end() {
+		return iterator(this, capacity);
+	}
+	iterator find(string_view key);
+	pair<iterator, bool> emplace(string_view key, string_view value);
+	void assign(iterator it, string_view value);
+	void erase(iterator it);
+	size_t erase(string_view key);
+	size_t count(string_view key);
+	size_t size() {
+		return used;
+	}
+	bool empty() {
+		return used == 0;
+	}
+	void clear();
+	size_t bytesUsed();
+};
+
+#endif /* FLATTABLE_H_ */
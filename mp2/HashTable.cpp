@@ -6,10 +6,170 @@
 
 #include "HashTable.h"
 
-HashTable::HashTable() {}
+HashTable::HashTable() {
+	wal = NULL;
+	memset(stats, 0, sizeof(stats));
+}
 
 HashTable::~HashTable() {}
 
+/**
+ * FUNCTION NAME: inSnapshot
+ *
+ * DESCRIPTION: Find key, of partition, in the snapshot
+ */
+bool HashTable::inSnapshot(int partition, string_view key, string_view &value) {
+	if ( !snapshot.isOpen() ) {
+		return false;
+	}
+	prefixKey(snapKey, partition, key);
+	return snapshot.find(snapKey, value);
+}
+
+/**
+ * FUNCTION NAME: snapshotRange
+ *
+ * DESCRIPTION: The records of partition in the snapshot: first to last - 1
+ */
+void HashTable::snapshotRange(int partition, size_t &first, size_t &last) {
+	first = last = 0;
+	if ( snapshot.isOpen() ) {
+		prefixKey(snapKey, partition, "");
+		first = snapshot.lowerBound(snapKey);
+		prefixKey(snapKey, partition + 1, "");
+		last = snapshot.lowerBound(snapKey);
+	}
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Find key in the changes since the snapshot, then in the snapshot
+ *
+ * RETURNS:
+ * true and its value in value if the table has key
+ * false otherwise
+ */
+bool HashTable::lookup(string_view key, string_view &value) {
+	int partition = partitionOf(key);
+	ht_store::iterator search;
+
+	search = hashTable[partition].find(key);
+	if ( search != hashTable[partition].end() ) {
+		value = search->second;
+		return !value.empty();
+	}
+	return inSnapshot(partition, key, value);
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Set the value of key, whether the table has it or not
+ */
+void HashTable::put(string_view key, string_view value) {
+	int partition = partitionOf(key);
+	ht_store &table = hashTable[partition];
+	ht_store::iterator search;
+	string_view old;
+
+	search = table.find(key);
+	if ( search == table.end() ) {
+		if ( !inSnapshot(partition, key, old) ) {
+			stats[partition].keys++;
+			stats[partition].bytes += key.size();
+		}
+		stats[partition].bytes += value.size() - old.size();
+		table.emplace(key, value);
+		return;
+	}
+	if ( search->second.empty() ) {
+		// a deleted key of the snapshot
+		stats[partition].keys++;
+		stats[partition].bytes += key.size();
+	}
+	stats[partition].bytes += value.size() - search->second.size();
+#ifdef MAP_HASHTABLE
+	search->second.assign(value);
+#else
+	table.assign(search, value);
+#endif
+}
+
+/**
+ * FUNCTION NAME: remove
+ *
+ * DESCRIPTION: Delete key. A key of the snapshot is kept in hashTable with an
+ * 				empty value, which hides it.
+ *
+ * RETURNS:
+ * true if the table had key
+ * false otherwise
+ */
+bool HashTable::remove(string_view key) {
+	int partition = partitionOf(key);
+	ht_store &table = hashTable[partition];
+	ht_store::iterator search;
+	string_view old;
+
+	search = table.find(key);
+	if ( search != table.end() ) {
+		if ( search->second.empty() ) {
+			return false;
+		}
+		stats[partition].keys--;
+		stats[partition].bytes -= key.size() + search->second.size();
+		if ( inSnapshot(partition, key, old) ) {
+#ifdef MAP_HASHTABLE
+			search->second.clear();
+#else
+			table.assign(search, "");
+#endif
+		}
+		else {
+			table.erase(search);
+		}
+		return true;
+	}
+	if ( inSnapshot(partition, key, old) ) {
+		stats[partition].keys--;
+		stats[partition].bytes -= key.size() + old.size();
+		table.emplace(key, "");
+		return true;
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: drop
+ *
+ * DESCRIPTION: Delete every key of partition
+ */
+void HashTable::drop(int partition) {
+	size_t first, last;
+
+	hashTable[partition].clear();
+	snapshotRange(partition, first, last);
+	for ( size_t i = first; i < last; i++ ) {
+		hashTable[partition].emplace(snapshot.keyAt(i).substr(KV_PREFIX), "");
+	}
+	stats[partition].keys = 0;
+	stats[partition].bytes = 0;
+}
+
+/**
+ * FUNCTION NAME: reset
+ *
+ * DESCRIPTION: Drop every entry, the snapshot's too
+ */
+void HashTable::reset() {
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		hashTable[i].clear();
+	}
+	snapshot.close();
+	memset(stats, 0, sizeof(stats));
+}
+
 /**
  * FUNCTION NAME: create
  *
@@ -19,8 +179,15 @@ HashTable::~HashTable() {}
  * true on SUCCESS
  * false in FAILURE
  */
-bool HashTable::create(string key, string value) {
-	hashTable.emplace(key, value);
+bool HashTable::create(string_view key, string_view value) {
+	string_view old;
+
+	if ( !lookup(key, old) ) {
+		put(key, value);
+		if ( wal != NULL ) {
+			wal->append(WAL_PUT, key, value);
+		}
+	}
 	return true;
 }
 
@@ -30,16 +197,15 @@ bool HashTable::create(string key, string value) {
  * DESCRIPTION: This function searches for the key in the hash table
  *
  * RETURNS:
- * string value if found
- * else it returns a NULL
+ * the value if found, valid until the table is changed
+ * else an empty string
  */
-string HashTable::read(string key) {
-	map<string, string>::iterator search;
+string_view HashTable::read(string_view key) {
+	string_view value;
 
-	search = hashTable.find(key);
-	if ( search != hashTable.end() ) {
+	if ( lookup(key, value) ) {
 		// Value found
-		return search->second;
+		return value;
 	}
 	else {
 		// Value not found
@@ -57,16 +223,18 @@ string HashTable::read(string key) {
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::update(string key, string newValue) {
-	map<string, string>::iterator update;
+bool HashTable::update(string_view key, string_view newValue) {
+	string_view old;
 
-	if (read(key).empty()) {
+	if ( !lookup(key, old) ) {
 		// Key not found
 		return false;
 	}
 	// Key found
-	//update = hashTable.at(key) = newValue;
-	hashTable.at(key) = newValue;
+	put(key, newValue);
+	if ( wal != NULL ) {
+		wal->append(WAL_PUT, key, newValue);
+	}
 	// Update successful
 	return true;
 }
@@ -80,17 +248,13 @@ bool HashTable::update(string key, string newValue) {
  * true on SUCCESS
  * false on FAILURE
  */
-bool HashTable::deleteKey(string key) {
-	uint eraseCount = 0;
-
-	if (read(key).empty()) {
+bool HashTable::deleteKey(string_view key) {
+	if ( !remove(key) ) {
 		// Key not found
 		return false;
 	}
-	eraseCount = hashTable.erase(key);
-	if ( eraseCount < 1 ) {
-		// Could not erase
-		return false;
+	if ( wal != NULL ) {
+		wal->append(WAL_DELETE, key, "");
 	}
 	// Delete was successful
 	return true;
@@ -106,7 +270,7 @@ bool HashTable::deleteKey(string key) {
  * false otherwise
  */
 bool HashTable::isEmpty() {
-	return hashTable.empty();
+	return currentSize() == 0;
 }
 
 /**
@@ -118,7 +282,12 @@ bool HashTable::isEmpty() {
  * size of the table as unit
  */
 unsigned long HashTable::currentSize() {
-	return (unsigned  long)hashTable.size();
+	unsigned long size = 0;
+
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		size += stats[i].keys;
+	}
+	return size;
 }
 
 /**
@@ -127,7 +296,10 @@ unsigned long HashTable::currentSize() {
  * DESCRIPTION: Clear all contents from the hash table
  */
 void HashTable::clear() {
-	hashTable.clear();
+	reset();
+	if ( wal != NULL ) {
+		wal->append(WAL_CLEAR, "", "");
+	}
 }
 
 /**
@@ -138,7 +310,212 @@ void HashTable::clear() {
  * RETURNS:
  * unsigned long count (Should be always 1)
  */
-unsigned long HashTable::count(string key) {
-	return (unsigned long) hashTable.count(key);
+unsigned long HashTable::count(string_view key) {
+	string_view value;
+
+	return lookup(key, value) ? 1 : 0;
 }
 
+/**
+ * FUNCTION NAME: forEach
+ *
+ * DESCRIPTION: Call visit with every key and value of the table, partition by
+ * 				partition, in no particular order within one. The table must
+ * 				not be changed meanwhile.
+ */
+void HashTable::forEach(function<void(string_view, string_view)> visit) {
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		forEachIn(i, visit);
+	}
+}
+
+/**
+ * FUNCTION NAME: forEachIn
+ *
+ * DESCRIPTION: Call visit with every key and value of partition
+ */
+void HashTable::forEachIn(int partition, function<void(string_view, string_view)> visit) {
+	ht_store &table = hashTable[partition];
+	size_t first, last;
+
+	for ( auto it = table.begin(); it != table.end(); ++it ) {
+		if ( !it->second.empty() ) {
+			visit(it->first, it->second);
+		}
+	}
+	snapshotRange(partition, first, last);
+	for ( size_t i = first; i < last; i++ ) {
+		string_view key = snapshot.keyAt(i).substr(KV_PREFIX);
+		if ( table.find(key) == table.end() ) {
+			visit(key, snapshot.valueAt(i));
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: dropPartition
+ *
+ * DESCRIPTION: Delete every key of partition, for a range the node no longer
+ * 				has a replica of
+ */
+void HashTable::dropPartition(int partition) {
+	if ( stats[partition].keys == 0 ) {
+		return;
+	}
+	drop(partition);
+	if ( wal != NULL ) {
+		prefixKey(snapKey, partition, "");
+		wal->append(WAL_DROP, snapKey, "");
+	}
+}
+
+/**
+ * FUNCTION NAME: partitionStats
+ */
+kv_partition_stats HashTable::partitionStats(int partition) {
+	return stats[partition];
+}
+
+/**
+ * FUNCTION NAME: openSnapshot
+ *
+ * DESCRIPTION: Serve the entries of the snapshot at path, if there is one, and
+ * 				write the next checkpoint there. Call before attachLog, whose
+ * 				records are the changes made after the snapshot.
+ *
+ * RETURNS:
+ * true if a snapshot was opened
+ */
+bool HashTable::openSnapshot(string path) {
+	size_t first, last;
+
+	snapshotPath = path;
+	reset();
+	if ( !snapshot.open(path) ) {
+		return false;
+	}
+	// a partition is a run of records, so its size is in the index
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		snapshotRange(i, first, last);
+		stats[i].keys = last - first;
+		stats[i].bytes = snapshot.span(first, last) - (last - first) * (sizeof(snap_record) + KV_PREFIX);
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: attachLog
+ *
+ * DESCRIPTION: Replay the log into the table, then log every change from now on.
+ * 				The table keeps the log but does not own it.
+ *
+ * RETURNS:
+ * number of records replayed
+ */
+long HashTable::attachLog(WriteAheadLog *wal) {
+	long replayed;
+
+	this->wal = NULL;
+	replayed = wal->replay(replayWrapper, this);
+	this->wal = wal;
+	return replayed;
+}
+
+/**
+ * FUNCTION NAME: replayWrapper
+ *
+ * DESCRIPTION: Apply one record of the log to the table passed as env
+ */
+void HashTable::replayWrapper(void *env, int op, string_view key, string_view value) {
+	HashTable *ht = (HashTable *)env;
+
+	switch ( op ) {
+		case WAL_PUT:
+			ht->put(key, value);
+			break;
+		case WAL_DELETE:
+			ht->remove(key);
+			break;
+		case WAL_CLEAR:
+			ht->reset();
+			break;
+		case WAL_DROP:
+			if ( key.size() == KV_PREFIX ) {
+				ht->drop((unsigned char)key[0] << 8 | (unsigned char)key[1]);
+			}
+			break;
+	}
+}
+
+/**
+ * FUNCTION NAME: deltaSize
+ *
+ * DESCRIPTION: Entries changed since the last checkpoint, deletions included
+ */
+unsigned long HashTable::deltaSize() {
+	unsigned long size = 0;
+
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		size += hashTable[i].size();
+	}
+	return size;
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Write the whole table to a new snapshot, merging the changes
+ * 				into the old one in key order, then serve the new one and
+ * 				empty the log: everything in it is in the snapshot now.
+ * 				Values read from the table before are no longer valid.
+ *
+ * RETURNS:
+ * number of entries in the snapshot, 0 if there is no snapshot path
+ */
+size_t HashTable::checkpoint() {
+	vector<pair<string_view, string_view> > delta;
+	size_t written;
+
+	if ( snapshotPath.empty() ) {
+		return 0;
+	}
+	SnapshotWriter writer(snapshotPath);
+	for ( int p = 0; p < KV_PARTITIONS; p++ ) {
+		size_t i, last, j = 0;
+
+		delta.clear();
+		for ( auto it = hashTable[p].begin(); it != hashTable[p].end(); ++it ) {
+			delta.emplace_back(it->first, it->second);
+		}
+		sort(delta.begin(), delta.end());
+		snapshotRange(p, i, last);
+		while ( i < last || j < delta.size() ) {
+			string_view key = i < last ? snapshot.keyAt(i).substr(KV_PREFIX) : string_view();
+			if ( j < delta.size() && (i == last || delta[j].first <= key) ) {
+				if ( i < last && delta[j].first == key ) {
+					// changed since the old snapshot
+					i++;
+				}
+				if ( !delta[j].second.empty() ) {
+					prefixKey(snapKey, p, delta[j].first);
+					writer.add(snapKey, delta[j].second);
+				}
+				j++;
+			}
+			else {
+				writer.add(snapshot.keyAt(i), snapshot.valueAt(i));
+				i++;
+			}
+		}
+	}
+	written = writer.finish();
+
+	if ( wal != NULL ) {
+		wal->reset();
+	}
+	for ( int p = 0; p < KV_PARTITIONS; p++ ) {
+		hashTable[p].clear();
+	}
+	snapshot.open(snapshotPath);
+	return written;
+}
@@ -13,26 +13,75 @@
 #include "stdincludes.h"
 #include "common.h"
 #include "Entry.h"
+#include "FlatTable.h"
+#include "KVStore.h"
+#include "Snapshot.h"
+
+/**
+ * Storage engine, chosen at build time: the open addressing FlatTable, or
+ * std::map when MAP_HASHTABLE is defined (make HASHTABLE=map)
+ */
+#ifdef MAP_HASHTABLE
+// less<> lets keys be looked up by string_view without a copy
+typedef map<string, string, less<> > ht_store;
+#else
+typedef FlatTable ht_store;
+#endif
 
 /**
  * CLASS NAME: HashTable
  *
- * DESCRIPTION: This class is a wrapper to the map provided by C++ STL.
+ * DESCRIPTION: This class is a wrapper to the in memory storage engine (see ht_store).
+ * 				Nothing may depend on the order of its entries. With a log
+ * 				attached, every change made through it is appended to the log.
+ *
+ * 				With a snapshot open, the table is the snapshot with the
+ * 				changes since made to it: hashTable then only holds those
+ * 				changes, and an empty value in it marks a key of the snapshot
+ * 				that was deleted. So values themselves must not be empty.
  *
+ * 				Keys are split by partition: hashTable has one store per
+ * 				partition, and the snapshot is sorted by partition first
+ * 				(its keys start with the partition, see KVStore::prefixKey).
  */
-class HashTable {
+class HashTable : public KVStore {
+private:
+	// NULL when the table is not logged
+	WriteAheadLog *wal;
+	// entries as of the last checkpoint
+	Snapshot snapshot;
+	string snapshotPath;
+	// a key as it is in the snapshot
+	string snapKey;
+	kv_partition_stats stats[KV_PARTITIONS];
+	static void replayWrapper(void *env, int op, string_view key, string_view value);
+	bool inSnapshot(int partition, string_view key, string_view &value);
+	void snapshotRange(int partition, size_t &first, size_t &last);
+	bool lookup(string_view key, string_view &value);
+	void put(string_view key, string_view value);
+	bool remove(string_view key);
+	void drop(int partition);
+	void reset();
 public:
-	map<string, string> hashTable;
+	ht_store hashTable[KV_PARTITIONS];
 //public:
 	HashTable();
-	bool create(string key, string value);
-	string read(string key);
-	bool update(string key, string newValue);
-	bool deleteKey(string key);
+	bool create(string_view key, string_view value);
+	string_view read(string_view key);
+	bool update(string_view key, string_view newValue);
+	bool deleteKey(string_view key);
 	bool isEmpty();
 	unsigned long currentSize();
 	void clear();
-	unsigned long count(string key);
+	unsigned long count(string_view key);
+	void forEach(function<void(string_view, string_view)> visit);
+	void forEachIn(int partition, function<void(string_view, string_view)> visit);
+	void dropPartition(int partition);
+	kv_partition_stats partitionStats(int partition);
+	bool openSnapshot(string path);
+	long attachLog(WriteAheadLog *wal);
+	unsigned long deltaSize();
+	size_t checkpoint();
 	virtual ~HashTable();
 };
 
@@ -0,0 +1,133 @@
+/**********************************
+ * FILE NAME: KVStore.h
+ *
+ * DESCRIPTION: Interface of the storage engines a node keeps its keys in
+ **********************************/
+
+#ifndef _KVSTORE_H_
+#define _KVSTORE_H_
+
+#include "stdincludes.h"
+#include "WriteAheadLog.h"
+#include <functional>
+
+/*
+ * Macros
+ */
+// partitions of a store: slices of the ring of equal width (see partitionOf)
+#define KV_PARTITION_BITS 9
+#define KV_PARTITIONS (1 << KV_PARTITION_BITS)
+// bytes of the partition number an engine may put before the keys it keeps in key order
+#define KV_PREFIX 2
+
+/**
+ * Struct Name: kv_span
+ *
+ * DESCRIPTION: The ring tokens after lo up to and including hi, going round
+ * 				past the largest token; the whole ring if lo == hi
+ */
+typedef struct kv_span {
+	unsigned long long lo;
+	unsigned long long hi;
+}kv_span;
+
+/**
+ * Struct Name: kv_partition_stats
+ *
+ * DESCRIPTION: Size of a partition: its keys, and the bytes of their keys and
+ * 				values
+ */
+typedef struct kv_partition_stats {
+	unsigned long keys;
+	unsigned long long bytes;
+}kv_partition_stats;
+
+/**
+ * CLASS NAME: KVStore
+ *
+ * DESCRIPTION: The local store of a node: HashTable in memory, or LsmTree on
+ * 				disk, picked by STORAGE in the config file. Values must not be
+ * 				empty. A value returned by read is valid until the store is
+ * 				used again.
+ *
+ * 				With a log attached, every change is appended to it, and
+ * 				checkpoint saves the changes since the last one elsewhere so
+ * 				the log can be emptied.
+ *
+ * 				Keys are kept by partition, the keys of one slice of the ring,
+ * 				so the keys of a stretch of the ring can be enumerated or
+ * 				dropped, and its size known, without going through the others.
+ * 				A key is placed at its own token; a ring position may fall
+ * 				inside a partition, so the keys of a partition need not share
+ * 				their replicas.
+ */
+class KVStore {
+public:
+	KVStore() {}
+	virtual ~KVStore() {}
+	// position of a key on the 64-bit ring
+	static unsigned long long tokenOf(string_view key) {
+		// std::hash of the key as a string, through the finalizer of MurmurHash3
+		unsigned long long h = hash<string_view>()(key);
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccdULL;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53ULL;
+		h ^= h >> 33;
+		return h;
+	}
+	static int partitionOf(string_view key) {
+		return partitionAt(tokenOf(key));
+	}
+	// partition whose slice of the ring holds token
+	static int partitionAt(unsigned long long token) {
+		return (int)(token >> (64 - KV_PARTITION_BITS));
+	}
+	// first token of the slice of a partition
+	static unsigned long long partitionToken(int partition) {
+		return (unsigned long long)partition << (64 - KV_PARTITION_BITS);
+	}
+	static bool inSpan(unsigned long long token, const kv_span &span) {
+		return span.lo == span.hi || token - span.lo - 1 < span.hi - span.lo;
+	}
+	// true if the whole slice of partition is in span
+	static bool covers(const kv_span &span, int partition) {
+		unsigned long long first = partitionToken(partition) - span.lo - 1;
+		unsigned long long last = first + (1ULL << (64 - KV_PARTITION_BITS)) - 1;
+		return span.lo == span.hi || (first <= last && last < span.hi - span.lo);
+	}
+	// partitions span is in: first to first + count - 1, around the ring
+	static void partitionsOf(const kv_span &span, int &first, int &count) {
+		int last = partitionAt(span.hi);
+		first = partitionAt(span.lo + 1);
+		count = (last - first + KV_PARTITIONS) % KV_PARTITIONS + 1;
+		if ( span.lo == span.hi || (count == 1 && span.hi - span.lo > (1ULL << (64 - KV_PARTITION_BITS))) ) {
+			// round the ring back into the partition it started in
+			count = KV_PARTITIONS;
+		}
+	}
+	// partition, big endian so that keys sort by partition first, then key
+	static void prefixKey(string &out, int partition, string_view key) {
+		out.resize(KV_PREFIX);
+		out[0] = (char)(partition >> 8);
+		out[1] = (char)partition;
+		out.append(key);
+	}
+	virtual bool create(string_view key, string_view value) = 0;
+	virtual string_view read(string_view key) = 0;
+	virtual bool update(string_view key, string_view newValue) = 0;
+	virtual bool deleteKey(string_view key) = 0;
+	virtual bool isEmpty() = 0;
+	virtual unsigned long currentSize() = 0;
+	virtual void clear() = 0;
+	virtual unsigned long count(string_view key) = 0;
+	virtual void forEach(function<void(string_view, string_view)> visit) = 0;
+	virtual void forEachIn(int partition, function<void(string_view, string_view)> visit) = 0;
+	virtual void dropPartition(int partition) = 0;
+	virtual kv_partition_stats partitionStats(int partition) = 0;
+	virtual long attachLog(WriteAheadLog *wal) = 0;
+	virtual unsigned long deltaSize() = 0;
+	virtual size_t checkpoint() = 0;
+};
+
+#endif /* _KVSTORE_H_ */
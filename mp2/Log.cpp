@@ -12,6 +12,7 @@
 Log::Log(Params *p) {
 	par = p;
 	firstTime = false;
+	held = false;
 }
 
 /**
@@ -20,6 +21,8 @@ Log::Log(Params *p) {
 Log::Log(const Log &anotherLog) {
 	this->par = anotherLog.par;
 	this->firstTime = anotherLog.firstTime;
+	this->held = anotherLog.held;
+	this->pending = anotherLog.pending;
 }
 
 /**
@@ -28,6 +31,8 @@ Log::Log(const Log &anotherLog) {
 Log& Log::operator = (const Log& anotherLog) {
 	this->par = anotherLog.par;
 	this->firstTime = anotherLog.firstTime;
+	this->held = anotherLog.held;
+	this->pending = anotherLog.pending;
 	return *this;
 }
 
@@ -40,18 +45,50 @@ Log::~Log() {}
  * FUNCTION NAME: LOG
  *
  * DESCRIPTION: Print out to file dbg.log, along with Address of node.
+ * 				While the log is held the line is kept with the lines of the
+ * 				node at addr and written out by merge.
  */
 void Log::LOG(Address *addr, const char * str, ...) {
 
+	va_list vararglist;
+	char buffer[30000];
+	char stdstring[30];
+	int id = *(int *)(addr->addr);
+
+	sprintf(stdstring, "%d.%d.%d.%d:%d ", addr->addr[0], addr->addr[1], addr->addr[2], addr->addr[3], *(short *)&addr->addr[4]);
+
+	va_start(vararglist, str);
+	vsprintf(buffer, str, vararglist);
+	va_end(vararglist);
+
+	if ( held && id >= 0 && id < (int)pending.size() ) {
+		log_entry entry;
+		entry.address = stdstring;
+		entry.time = par->getcurrtime();
+		entry.text = buffer;
+		pending[id].push_back(entry);
+		return;
+	}
+
+	write(stdstring, par->getcurrtime(), buffer);
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Append one line to dbg.log, or to stats.log for #STATSLOG# lines
+ */
+void Log::write(const char *address, int time, const char *text) {
+
 	static FILE *fp;
 	static FILE *fp2;
-	va_list vararglist;
-	static char buffer[30000];
 	static int numwrites;
-	static char stdstring[30];
 	static char stdstring2[40];
 	static char stdstring3[40]; 
 	static int dbg_opened=0;
+	static mutex lock;
+
+	lock_guard<mutex> guard(lock);
 
 	if(dbg_opened != 639){
 		numwrites=0;
@@ -68,13 +105,6 @@ void Log::LOG(Address *addr, const char * str, ...) {
 
 		dbg_opened=639;
 	}
-	else 
-
-	sprintf(stdstring, "%d.%d.%d.%d:%d ", addr->addr[0], addr->addr[1], addr->addr[2], addr->addr[3], *(short *)&addr->addr[4]);
-
-	va_start(vararglist, str);
-	vsprintf(buffer, str, vararglist);
-	va_end(vararglist);
 
 	if (!firstTime) {
 		int magicNumber = 0;
@@ -87,16 +117,16 @@ void Log::LOG(Address *addr, const char * str, ...) {
 		firstTime = true;
 	}
 
-	if(memcmp(buffer, "#STATSLOG#", 10)==0){
-		fprintf(fp2, "\n %s", stdstring);
-		fprintf(fp2, "[%d] ", par->getcurrtime());
+	if(memcmp(text, "#STATSLOG#", 10)==0){
+		fprintf(fp2, "\n %s", address);
+		fprintf(fp2, "[%d] ", time);
 
-		fprintf(fp2, buffer);
+		fputs(text, fp2);
 	}
 	else{
-		fprintf(fp, "\n %s", stdstring);
-		fprintf(fp, "[%d] ", par->getcurrtime());
-		fprintf(fp, buffer);
+		fprintf(fp, "\n %s", address);
+		fprintf(fp, "[%d] ", time);
+		fputs(text, fp);
 
 	}
 
@@ -108,13 +138,45 @@ void Log::LOG(Address *addr, const char * str, ...) {
 
 }
 
+/**
+ * FUNCTION NAME: hold
+ *
+ * DESCRIPTION: Keep every line logged from now on per node, so that nodes
+ * 				running on different threads do not interleave their lines
+ */
+void Log::hold() {
+	pending.resize(par->EN_GPSZ + 1);
+	held = true;
+}
+
+/**
+ * FUNCTION NAME: merge
+ *
+ * DESCRIPTION: Write out the lines kept since hold, one node after the other,
+ * 				by increasing or decreasing node id. The result does not depend
+ * 				on which thread ran which node.
+ */
+void Log::merge(bool descending) {
+	int n = pending.size();
+
+	held = false;
+	for ( int i = 0; i < n; i++ ) {
+		int id = descending ? n - 1 - i : i;
+		for ( unsigned int j = 0; j < pending[id].size(); j++ ) {
+			log_entry &entry = pending[id][j];
+			write(entry.address.c_str(), entry.time, entry.text.c_str());
+		}
+		pending[id].clear();
+	}
+}
+
 /**
  * FUNCTION NAME: logNodeAdd
  *
  * DESCRIPTION: To Log a node add
  */
 void Log::logNodeAdd(Address *thisNode, Address *addedAddr) {
-	static char stdstring[100];
+	char stdstring[100];
 	sprintf(stdstring, "Node %d.%d.%d.%d:%d joined at time %d", addedAddr->addr[0], addedAddr->addr[1], addedAddr->addr[2], addedAddr->addr[3], *(short *)&addedAddr->addr[4], par->getcurrtime());
     LOG(thisNode, stdstring);
 }
@@ -125,7 +187,7 @@ void Log::logNodeAdd(Address *thisNode, Address *addedAddr) {
  * DESCRIPTION: To log a node remove
  */
 void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
-	static char stdstring[30];
+	char stdstring[100];
 	sprintf(stdstring, "Node %d.%d.%d.%d:%d removed at time %d", removedAddr->addr[0], removedAddr->addr[1], removedAddr->addr[2], removedAddr->addr[3], *(short *)&removedAddr->addr[4], par->getcurrtime());
     LOG(thisNode, stdstring);
 }
@@ -135,14 +197,14 @@ void Log::logNodeRemove(Address *thisNode, Address *removedAddr) {
  *
  * DESCRTION: Call this function after successfully create a key value pair
  */
-void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
+void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value){
+	char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: create success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: create success at time %d, transID=%d, key=%.*s, value=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data(), (int)value.size(), value.data());
     LOG(address, stdstring);
 }
 
@@ -151,14 +213,14 @@ void Log::logCreateSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function after successfully reading a key
  */
-void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, string key, string value){
-    static char stdstring[100];
+void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value){
+    char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: read success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: read success at time %d, transID=%d, key=%.*s, value=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data(), (int)value.size(), value.data());
     LOG(address, stdstring);
 }
 
@@ -167,14 +229,14 @@ void Log::logReadSuccess(Address * address, bool isCoordinator, int transID, str
  *
  * DESCRIPTION: Call this function after successfully updating a key
  */
-void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
+void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue){
+    char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: update success at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: update success at time %d, transID=%d, key=%.*s, value=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data(), (int)newValue.size(), newValue.data());
     LOG(address, stdstring);
 }
 
@@ -183,14 +245,14 @@ void Log::logUpdateSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function after successfully deleting a key
  */
-void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, string_view key){
+    char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: delete success at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: delete success at time %d, transID=%d, key=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data());
     LOG(address, stdstring);
 }
 
@@ -199,14 +261,14 @@ void Log::logDeleteSuccess(Address * address, bool isCoordinator, int transID, s
  *
  * DESCRIPTION: Call this function if CREATE failed
  */
-void Log::logCreateFail(Address * address, bool isCoordinator, int transID, string key, string value){
-	static char stdstring[100];
+void Log::logCreateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view value){
+	char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: create fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), value.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: create fail at time %d, transID=%d, key=%.*s, value=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data(), (int)value.size(), value.data());
     LOG(address, stdstring);
 }
 
@@ -216,14 +278,14 @@ void Log::logCreateFail(Address * address, bool isCoordinator, int transID, stri
  *
  * DESCRIPTION: Call this function if READ failed
  */
-void Log::logReadFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+void Log::logReadFail(Address * address, bool isCoordinator, int transID, string_view key){
+    char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: read fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: read fail at time %d, transID=%d, key=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data());
     LOG(address, stdstring);
 }
 
@@ -232,14 +294,14 @@ void Log::logReadFail(Address * address, bool isCoordinator, int transID, string
  *
  * DESCRIPTION: Call this function if UPDATE failed
  */
-void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, string key, string newValue){
-    static char stdstring[100];
+void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue){
+    char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: update fail at time %d, transID=%d, key=%s, value=%s", str.c_str(), par->getcurrtime(), transID, key.c_str(), newValue.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: update fail at time %d, transID=%d, key=%.*s, value=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data(), (int)newValue.size(), newValue.data());
     LOG(address, stdstring);
 }
 
@@ -248,13 +310,13 @@ void Log::logUpdateFail(Address * address, bool isCoordinator, int transID, stri
  *
  * DESCRIPTION: Call this function if DELETE failed
  */
-void Log::logDeleteFail(Address * address, bool isCoordinator, int transID, string key){
-    static char stdstring[100];
+void Log::logDeleteFail(Address * address, bool isCoordinator, int transID, string_view key){
+    char stdstring[100];
 	string str;
 	if (isCoordinator)
 		str = "coordinator";
 	else
 		str = "server";
-	sprintf(stdstring, "%s: delete fail at time %d, transID=%d, key=%s", str.c_str(), par->getcurrtime(), transID, key.c_str());
+	snprintf(stdstring, sizeof(stdstring), "%s: delete fail at time %d, transID=%d, key=%.*s", str.c_str(), par->getcurrtime(), transID, (int)key.size(), key.data());
     LOG(address, stdstring);
 }
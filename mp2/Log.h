@@ -20,6 +20,17 @@
 #define DBG_LOG "dbg.log"
 #define STATS_LOG "stats.log"
 
+/**
+ * Struct Name: log_entry
+ *
+ * DESCRIPTION: A line kept back while the log is held
+ */
+typedef struct log_entry {
+	string address;
+	int time;
+	string text;
+}log_entry;
+
 /**
  * CLASS NAME: Log
  *
@@ -29,24 +40,30 @@ class Log{
 private:
 	Params *par;
 	bool firstTime;
+	// lines kept per node id while held
+	bool held;
+	vector< vector<log_entry> > pending;
+	void write(const char *address, int time, const char *text);
 public:
 	Log(Params *p);
 	Log(const Log &anotherLog);
 	Log& operator = (const Log &anotherLog);
 	virtual ~Log();
 	void LOG(Address *, const char * str, ...);
+	void hold();
+	void merge(bool descending);
 	void logNodeAdd(Address *, Address *);
 	void logNodeRemove(Address *, Address *);
 	// success
-	void logCreateSuccess(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logReadSuccess(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logUpdateSuccess(Address * address, bool isCoordinator, int transID, string key, string newValue);
-	void logDeleteSuccess(Address * address, bool isCoordinator, int transID, string key);
+	void logCreateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value);
+	void logReadSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view value);
+	void logUpdateSuccess(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue);
+	void logDeleteSuccess(Address * address, bool isCoordinator, int transID, string_view key);
 	// fail
-	void logCreateFail(Address * address, bool isCoordinator, int transID, string key, string value);
-	void logReadFail(Address * address, bool isCoordinator, int transID, string key);
-	void logUpdateFail(Address * address, bool isCoordinator, int transID, string key, string newValue);
-	void logDeleteFail(Address * address, bool isCoordinator, int transID, string key);
+	void logCreateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view value);
+	void logReadFail(Address * address, bool isCoordinator, int transID, string_view key);
+	void logUpdateFail(Address * address, bool isCoordinator, int transID, string_view key, string_view newValue);
+	void logDeleteFail(Address * address, bool isCoordinator, int transID, string_view key);
 };
 
 #endif /* _LOG_H_ */
@@ -0,0 +1,110 @@
+/**********************************
+ * FILE NAME: LsmBench.cpp
+ *
+ * DESCRIPTION: Benchmark of the LSM tree storage engine: write amplification
+ * 				of a load of creates then updates, and read amplification and
+ * 				latency of random reads, a quarter of them of absent keys, with
+ * 				and without bloom filters
+ **********************************/
+
+#include "stdincludes.h"
+#include "LsmTree.h"
+
+/**
+ * Macros
+ */
+#define BENCH_VALUE_SIZE 100
+#define BENCH_MEMTABLE_BYTES (4 << 20)
+
+/**
+ * FUNCTION NAME: keyOf
+ *
+ * DESCRIPTION: The i-th key of the load; odd i past the load are absent keys
+ */
+static string keyOf(long i) {
+	char key[32];
+	snprintf(key, sizeof(key), "key%012ld", i);
+	return key;
+}
+
+/**
+ * FUNCTION NAME: settle
+ *
+ * DESCRIPTION: Wait for the compactions the load started to finish, until the
+ * 				tree wrote nothing for a second
+ */
+static void settle(LsmTree &tree) {
+	long written;
+	do {
+		written = tree.getDiskBytesWritten();
+		this_thread::sleep_for(chrono::seconds(1));
+	} while ( tree.getDiskBytesWritten() != written );
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Load keys keys and update half of them, then read reads random
+ * 				keys, with bloomBits bits of bloom filter per key
+ */
+static void run(long keys, long reads, int bloomBits) {
+	LsmTree tree("lsmbench." + to_string(getpid()) + "/tree", BENCH_MEMTABLE_BYTES, bloomBits, true);
+	string value(BENCH_VALUE_SIZE, 'v');
+	unsigned int seed = 1;
+
+	auto start = chrono::steady_clock::now();
+	for ( long i = 0; i < keys; i++ ) {
+		tree.create(keyOf(2 * i), value);
+	}
+	for ( long i = 0; i < keys / 2; i++ ) {
+		value[i % BENCH_VALUE_SIZE] = 'a' + i % 26;
+		tree.update(keyOf(2 * (rand_r(&seed) % keys)), value);
+	}
+	tree.checkpoint();
+	settle(tree);
+	double loadSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	long lookups = tree.getLookups(), blockReads = tree.getBlockReads();
+	vector<double> latency;
+	latency.reserve(reads);
+	for ( long i = 0; i < reads; i++ ) {
+		long k = rand_r(&seed) % keys;
+		// one read in four of a key that was never written
+		string key = keyOf(i % 4 == 3 ? 2 * k + 1 : 2 * k);
+		auto before = chrono::steady_clock::now();
+		tree.read(key);
+		latency.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - before).count());
+	}
+	sort(latency.begin(), latency.end());
+	lookups = tree.getLookups() - lookups;
+	blockReads = tree.getBlockReads() - blockReads;
+
+	printf("%10d %10.2f %12.2f %12.1f %12.1f %12.1f %12ld\n", bloomBits,
+			(double)tree.getDiskBytesWritten() / tree.getUserBytes(),
+			lookups > 0 ? (double)blockReads / lookups : 0.0,
+			latency[latency.size() / 2], latency[(latency.size() * 99) / 100], loadSeconds, tree.getCompactions());
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: LsmBench [keys [reads [bloom bits ...]]]
+ */
+int main(int argc, char *argv[]) {
+	long keys = argc > 1 ? atol(argv[1]) : 2000000;
+	long reads = argc > 2 ? atol(argv[2]) : 200000;
+	vector<int> bloomBits;
+
+	for ( int i = 3; i < argc; i++ ) {
+		bloomBits.push_back(atoi(argv[i]));
+	}
+	if ( bloomBits.empty() ) {
+		bloomBits = {10, 0};
+	}
+	printf("%10s %10s %12s %12s %12s %12s %12s\n", "bloom_bits", "write_amp", "blocks/read",
+			"read_p50_us", "read_p99_us", "load_s", "compactions");
+	for ( int bits : bloomBits ) {
+		run(keys, reads, bits);
+	}
+	return 0;
+}
@@ -0,0 +1,889 @@
+/**********************************
+ * FILE NAME: LsmTree.cpp
+ *
+ * DESCRIPTION: Definition of the log-structured storage engine
+ **********************************/
+
+#include "LsmTree.h"
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+/**
+ * CLASS NAME: LsmCursor
+ *
+ * DESCRIPTION: What LsmTree::merge walks: the records of the memtable or of a
+ * 				table, in key order
+ */
+class LsmCursor {
+public:
+	virtual ~LsmCursor() {}
+	virtual bool valid() = 0;
+	virtual string_view key() = 0;
+	virtual string_view value() = 0;
+	virtual void next() = 0;
+};
+
+class MemtableCursor : public LsmCursor {
+private:
+	map<string, string, less<> >::iterator it;
+	map<string, string, less<> >::iterator end;
+public:
+	MemtableCursor(map<string, string, less<> > &memtable, string_view start) : it(memtable.lower_bound(start)), end(memtable.end()) {}
+	bool valid() {
+		return it != end;
+	}
+	string_view key() {
+		return it->first;
+	}
+	string_view value() {
+		return it->second;
+	}
+	void next() {
+		++it;
+	}
+};
+
+class TableCursor : public LsmCursor {
+private:
+	SSTableCursor cursor;
+public:
+	TableCursor(shared_ptr<SSTable> table, string_view start) : cursor(table, start) {}
+	bool valid() {
+		return cursor.valid();
+	}
+	string_view key() {
+		return cursor.key();
+	}
+	string_view value() {
+		return cursor.value();
+	}
+	void next() {
+		cursor.next();
+	}
+};
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: Open the tree in dir, creating it (and its parent) if missing,
+ * 				and start its compaction thread
+ */
+LsmTree::LsmTree(string dir, size_t memtableLimit, int bloomBits, bool temporary) {
+	size_t slash = dir.rfind('/');
+
+	this->dir = dir;
+	this->temporary = temporary;
+	this->memtableLimit = memtableLimit;
+	this->bloomBits = bloomBits;
+	memtableBytes = 0;
+	wal = NULL;
+	replaying = false;
+	stopping = false;
+	nextNumber = 1;
+	userBytes = 0;
+	flushBytes = 0;
+	compactReadBytes = 0;
+	compactWriteBytes = 0;
+	compactions = 0;
+	lookups = 0;
+	blockReads = 0;
+	memset(stats, 0, sizeof(stats));
+	memset(flushedStats, 0, sizeof(flushedStats));
+	if ( (slash != string::npos && slash > 0 && mkdir(dir.substr(0, slash).c_str(), 0755) < 0 && errno != EEXIST)
+			|| (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) ) {
+		perror("mkdir");
+		exit(1);
+	}
+	loadManifest();
+	compactor = thread(&LsmTree::compactLoop, this);
+}
+
+/**
+ * Destructor
+ *
+ * DESCRIPTION: Wait for a compaction under way. The memtable is not written
+ * 				out: it is in the log, if there is one.
+ */
+LsmTree::~LsmTree() {
+	{
+		lock_guard<mutex> guard(lock);
+		stopping = true;
+	}
+	wakeup.notify_all();
+	compactor.join();
+	if ( temporary ) {
+		for ( int i = 0; i < LSM_LEVELS; i++ ) {
+			for ( auto &table : levels[i] ) {
+				unlink(table->path.c_str());
+			}
+		}
+		unlink((dir + "/MANIFEST").c_str());
+		rmdir(dir.c_str());
+		// the parent too, once every tree in it is gone
+		size_t slash = dir.rfind('/');
+		if ( slash != string::npos && slash > 0 ) {
+			rmdir(dir.substr(0, slash).c_str());
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: tablePath
+ */
+string LsmTree::tablePath(unsigned long number) {
+	return dir + "/" + to_string(number) + ".sst";
+}
+
+/**
+ * FUNCTION NAME: loadManifest
+ *
+ * DESCRIPTION: Open the tables the MANIFEST lists, and remove the files a crash
+ * 				left behind that it does not list. The partition sizes it has
+ * 				are those of the tables.
+ */
+void LsmTree::loadManifest() {
+	FILE *fp = fopen((dir + "/MANIFEST").c_str(), "r");
+	vector<unsigned long> live;
+	unsigned long number, keys;
+	unsigned long long bytes;
+	int level, partition;
+	char line[256];
+	DIR *d;
+	struct dirent *de;
+
+	while ( fp != NULL && fgets(line, sizeof(line), fp) != NULL ) {
+		if ( sscanf(line, "next %lu", &number) == 1 ) {
+			nextNumber = max(nextNumber, number);
+		}
+		else if ( sscanf(line, "partition %d %lu %llu", &partition, &keys, &bytes) == 3 ) {
+			if ( partition >= 0 && partition < KV_PARTITIONS ) {
+				flushedStats[partition].keys = keys;
+				flushedStats[partition].bytes = bytes;
+			}
+		}
+		else if ( sscanf(line, "%d %lu", &level, &number) == 2 ) {
+			if ( level < 0 || level >= LSM_LEVELS ) {
+				continue;
+			}
+			shared_ptr<SSTable> table = make_shared<SSTable>(tablePath(number), number);
+			if ( table->isOpen() ) {
+				levels[level].push_back(table);
+				live.push_back(number);
+			}
+			nextNumber = max(nextNumber, number + 1);
+		}
+	}
+	if ( fp != NULL ) {
+		fclose(fp);
+	}
+	memcpy(stats, flushedStats, sizeof(stats));
+	sort(levels[0].begin(), levels[0].end(), [](const shared_ptr<SSTable> &a, const shared_ptr<SSTable> &b) {
+		return a->number > b->number;
+	});
+	for ( int i = 1; i < LSM_LEVELS; i++ ) {
+		sort(levels[i].begin(), levels[i].end(), [](const shared_ptr<SSTable> &a, const shared_ptr<SSTable> &b) {
+			return a->smallest < b->smallest;
+		});
+	}
+
+	d = opendir(dir.c_str());
+	while ( d != NULL && (de = readdir(d)) != NULL ) {
+		string name = de->d_name;
+		if ( name.size() > 4 && name.compare(name.size() - 4, 4, ".sst") == 0
+				&& find(live.begin(), live.end(), strtoul(name.c_str(), NULL, 10)) == live.end() ) {
+			unlink((dir + "/" + name).c_str());
+		}
+	}
+	if ( d != NULL ) {
+		closedir(d);
+	}
+}
+
+/**
+ * FUNCTION NAME: writeManifest
+ *
+ * DESCRIPTION: Replace the MANIFEST with the tables of every level now. Called
+ * 				with lock held.
+ */
+void LsmTree::writeManifest() {
+	string path = dir + "/MANIFEST";
+	string tmpPath = path + ".tmp";
+	FILE *fp = fopen(tmpPath.c_str(), "w");
+
+	if ( fp == NULL ) {
+		perror("fopen");
+		exit(1);
+	}
+	fprintf(fp, "next %lu\n", nextNumber);
+	for ( int i = 0; i < LSM_LEVELS; i++ ) {
+		for ( auto &table : levels[i] ) {
+			fprintf(fp, "%d %lu\n", i, table->number);
+		}
+	}
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		if ( flushedStats[i].keys > 0 ) {
+			fprintf(fp, "partition %d %lu %llu\n", i, flushedStats[i].keys, flushedStats[i].bytes);
+		}
+	}
+	if ( fflush(fp) != 0 || fdatasync(fileno(fp)) < 0 ) {
+		perror("manifest");
+		exit(1);
+	}
+	fclose(fp);
+	if ( rename(tmpPath.c_str(), path.c_str()) < 0 ) {
+		perror("rename");
+		exit(1);
+	}
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: Find key in the memtable, then in the level 0 tables from the
+ * 				newest, then in the one table of every other level whose range
+ * 				holds it. The first record found is the latest. key is
+ * 				prefixed with its partition.
+ *
+ * RETURNS:
+ * true and its value in value if the tree has key
+ * false otherwise
+ */
+bool LsmTree::lookup(string_view key, string_view &value) {
+	int reads = 0;
+	bool found = false;
+
+	lookups++;
+	auto search = memtable.find(key);
+	if ( search != memtable.end() ) {
+		value = search->second;
+		return !value.empty();
+	}
+
+	lock_guard<mutex> guard(lock);
+	for ( auto &table : levels[0] ) {
+		if ( (found = table->get(key, readBuffer, blockBuffer, reads)) ) {
+			break;
+		}
+	}
+	for ( int i = 1; i < LSM_LEVELS && !found; i++ ) {
+		// first table whose range does not end below key
+		auto table = lower_bound(levels[i].begin(), levels[i].end(), key, [](const shared_ptr<SSTable> &t, string_view k) {
+			return string_view(t->largest()) < k;
+		});
+		if ( table != levels[i].end() ) {
+			found = (*table)->get(key, readBuffer, blockBuffer, reads);
+		}
+	}
+	blockReads += reads;
+	if ( !found || readBuffer.empty() ) {
+		value = string_view();
+		return false;
+	}
+	value = readBuffer;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: Set key, prefixed with its partition, in the memtable, an empty
+ * 				value to delete it, and write the memtable out if it is full.
+ * 				had and oldlen tell whether the tree had key, and its value
+ * 				length, for the size of the partition.
+ */
+void LsmTree::put(string_view key, string_view value, bool had, size_t oldlen) {
+	kv_partition_stats &partition = stats[(unsigned char)key[0] << 8 | (unsigned char)key[1]];
+	auto search = memtable.find(key);
+
+	if ( had ) {
+		partition.keys--;
+		partition.bytes -= key.size() - KV_PREFIX + oldlen;
+	}
+	if ( !value.empty() ) {
+		partition.keys++;
+		partition.bytes += key.size() - KV_PREFIX + value.size();
+	}
+
+	if ( search == memtable.end() ) {
+		memtable.emplace(key, value);
+		memtableBytes += key.size() + value.size() + LSM_ENTRY_OVERHEAD;
+	}
+	else {
+		memtableBytes = memtableBytes - search->second.size() + value.size();
+		search->second.assign(value);
+	}
+	userBytes += key.size() + value.size();
+	if ( !replaying && memtableBytes >= memtableLimit ) {
+		flush();
+	}
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Write the memtable out as the newest level 0 table. Deletions
+ * 				are kept, older tables may have the key. The log is emptied:
+ * 				all it had is in the table.
+ */
+void LsmTree::flush() {
+	unsigned long number;
+
+	if ( memtable.empty() ) {
+		return;
+	}
+	{
+		lock_guard<mutex> guard(lock);
+		number = nextNumber++;
+	}
+	SSTableWriter writer(tablePath(number), bloomBits);
+	for ( auto &it : memtable ) {
+		writer.add(it.first, it.second);
+	}
+	flushBytes += writer.finish();
+	shared_ptr<SSTable> table = make_shared<SSTable>(tablePath(number), number);
+	if ( !table->isOpen() ) {
+		fprintf(stderr, "Error: cannot read back %s\n", table->path.c_str());
+		exit(1);
+	}
+	{
+		lock_guard<mutex> guard(lock);
+		levels[0].insert(levels[0].begin(), table);
+		memcpy(flushedStats, stats, sizeof(stats));
+		writeManifest();
+	}
+	memtable.clear();
+	memtableBytes = 0;
+	if ( wal != NULL ) {
+		wal->reset();
+	}
+	wakeup.notify_one();
+}
+
+/**
+ * FUNCTION NAME: drop
+ *
+ * DESCRIPTION: Delete every key of partition
+ */
+void LsmTree::drop(int partition) {
+	vector<string> keys;
+	string start, end;
+
+	prefixKey(start, partition, "");
+	prefixKey(end, partition + 1, "");
+	scan(start, end, [&](string_view key, string_view value) {
+		keys.emplace_back(key);
+	});
+	for ( auto &key : keys ) {
+		prefixKey(keyBuffer, partition, key);
+		put(keyBuffer, "", false, 0);
+	}
+	stats[partition].keys = 0;
+	stats[partition].bytes = 0;
+}
+
+/**
+ * FUNCTION NAME: reset
+ *
+ * DESCRIPTION: Drop every table and the memtable
+ */
+void LsmTree::reset() {
+	lock_guard<mutex> guard(lock);
+
+	memset(stats, 0, sizeof(stats));
+	memset(flushedStats, 0, sizeof(flushedStats));
+	for ( int i = 0; i < LSM_LEVELS; i++ ) {
+		for ( auto &table : levels[i] ) {
+			unlink(table->path.c_str());
+		}
+		levels[i].clear();
+		compactPointer[i].clear();
+	}
+	writeManifest();
+	memtable.clear();
+	memtableBytes = 0;
+}
+
+/**
+ * FUNCTION NAME: merge
+ *
+ * DESCRIPTION: Call emit with every key from start to end (excluded, an empty
+ * 				end is none) of the memtable (if withMemtable) and of tables,
+ * 				in key order, once, with the value of the first of them, in
+ * 				that order, that has the key. Deletions included.
+ */
+void LsmTree::merge(bool withMemtable, vector<shared_ptr<SSTable> > &tables, string_view start, string_view end,
+		function<void(string_view, string_view)> emit) {
+	vector<unique_ptr<LsmCursor> > cursors;
+
+	if ( withMemtable ) {
+		cursors.emplace_back(new MemtableCursor(memtable, start));
+	}
+	for ( auto &table : tables ) {
+		cursors.emplace_back(new TableCursor(table, start));
+	}
+	while ( true ) {
+		int best = -1;
+		for ( int i = 0; i < (int)cursors.size(); i++ ) {
+			// on a tie the earlier cursor wins
+			if ( cursors[i]->valid() && (best < 0 || cursors[i]->key() < cursors[best]->key()) ) {
+				best = i;
+			}
+		}
+		if ( best < 0 || (!end.empty() && cursors[best]->key() >= end) ) {
+			break;
+		}
+		emit(cursors[best]->key(), cursors[best]->value());
+		for ( int i = 0; i < (int)cursors.size(); i++ ) {
+			if ( i != best && cursors[i]->valid() && cursors[i]->key() == cursors[best]->key() ) {
+				cursors[i]->next();
+			}
+		}
+		cursors[best]->next();
+	}
+}
+
+/**
+ * FUNCTION NAME: pickCompaction
+ *
+ * DESCRIPTION: Find the level most over its size and what to compact out of
+ * 				it: all of level 0, or the table of another level following
+ * 				the last one compacted, so every key range gets its turn.
+ * 				Called with lock held.
+ *
+ * RETURNS:
+ * true if a level is due
+ */
+bool LsmTree::pickCompaction(lsm_compaction &job) {
+	double best = 1;
+	double target = LSM_LEVEL_BASE;
+	string_view smallest, largest;
+
+	job.level = -1;
+	if ( (double)levels[0].size() / LSM_L0_TRIGGER >= best ) {
+		best = (double)levels[0].size() / LSM_L0_TRIGGER;
+		job.level = 0;
+	}
+	for ( int i = 1; i < LSM_LEVELS - 1; i++, target *= LSM_LEVEL_RATIO ) {
+		double bytes = 0;
+		for ( auto &table : levels[i] ) {
+			bytes += table->fileSize;
+		}
+		if ( bytes / target > best ) {
+			best = bytes / target;
+			job.level = i;
+		}
+	}
+	if ( job.level < 0 ) {
+		return false;
+	}
+
+	job.inputs[0].clear();
+	job.inputs[1].clear();
+	if ( job.level == 0 ) {
+		job.inputs[0] = levels[0];
+	}
+	else {
+		auto next = upper_bound(levels[job.level].begin(), levels[job.level].end(), compactPointer[job.level],
+				[](const string &k, const shared_ptr<SSTable> &t) {
+			return k < t->smallest;
+		});
+		job.inputs[0].push_back(next != levels[job.level].end() ? *next : levels[job.level].front());
+		compactPointer[job.level] = job.inputs[0].back()->largest();
+	}
+	smallest = job.inputs[0].front()->smallest;
+	largest = job.inputs[0].front()->largest();
+	for ( auto &table : job.inputs[0] ) {
+		smallest = min(smallest, string_view(table->smallest));
+		largest = max(largest, string_view(table->largest()));
+	}
+	for ( auto &table : levels[job.level + 1] ) {
+		if ( !(string_view(table->largest()) < smallest || largest < string_view(table->smallest)) ) {
+			job.inputs[1].push_back(table);
+		}
+	}
+	job.bottom = true;
+	for ( int i = job.level + 2; i < LSM_LEVELS; i++ ) {
+		job.bottom = job.bottom && levels[i].empty();
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: compact
+ *
+ * DESCRIPTION: Merge the inputs of job into new tables of the next level, cut
+ * 				at LSM_TABLE_BYTES. Runs without lock: tables never change.
+ *
+ * RETURNS:
+ * the new tables
+ */
+vector<shared_ptr<SSTable> > LsmTree::compact(lsm_compaction &job) {
+	vector<shared_ptr<SSTable> > inputs = job.inputs[0];
+	vector<shared_ptr<SSTable> > outputs;
+	unique_ptr<SSTableWriter> writer;
+	unsigned long number = 0;
+
+	// level 0 is newest first, and any input of a level is newer than those of the next
+	inputs.insert(inputs.end(), job.inputs[1].begin(), job.inputs[1].end());
+	for ( auto &table : inputs ) {
+		compactReadBytes += table->fileSize;
+	}
+	auto close = [&]() {
+		if ( writer != NULL && writer->getCount() > 0 ) {
+			compactWriteBytes += writer->finish();
+			outputs.push_back(make_shared<SSTable>(tablePath(number), number));
+		}
+		writer.reset();
+	};
+	merge(false, inputs, "", "", [&](string_view key, string_view value) {
+		if ( value.empty() && job.bottom ) {
+			// nothing older is left for the deletion to hide
+			return;
+		}
+		if ( writer == NULL ) {
+			lock_guard<mutex> guard(lock);
+			number = nextNumber++;
+			writer.reset(new SSTableWriter(tablePath(number), bloomBits));
+		}
+		writer->add(key, value);
+		if ( writer->bytesWritten() >= LSM_TABLE_BYTES ) {
+			close();
+		}
+	});
+	close();
+	return outputs;
+}
+
+/**
+ * FUNCTION NAME: install
+ *
+ * DESCRIPTION: Replace the inputs of job with its outputs and remove the input
+ * 				files. If the tree was cleared meanwhile, the outputs are
+ * 				dropped instead. Called with lock held.
+ */
+void LsmTree::install(lsm_compaction &job, vector<shared_ptr<SSTable> > &outputs) {
+	for ( int k = 0; k < 2; k++ ) {
+		for ( auto &table : job.inputs[k] ) {
+			vector<shared_ptr<SSTable> > &level = levels[job.level + k];
+			if ( find(level.begin(), level.end(), table) == level.end() ) {
+				for ( auto &output : outputs ) {
+					unlink(output->path.c_str());
+				}
+				return;
+			}
+		}
+	}
+	for ( int k = 0; k < 2; k++ ) {
+		vector<shared_ptr<SSTable> > &level = levels[job.level + k];
+		for ( auto &table : job.inputs[k] ) {
+			level.erase(find(level.begin(), level.end(), table));
+		}
+	}
+	vector<shared_ptr<SSTable> > &next = levels[job.level + 1];
+	next.insert(next.end(), outputs.begin(), outputs.end());
+	sort(next.begin(), next.end(), [](const shared_ptr<SSTable> &a, const shared_ptr<SSTable> &b) {
+		return a->smallest < b->smallest;
+	});
+	writeManifest();
+	for ( int k = 0; k < 2; k++ ) {
+		for ( auto &table : job.inputs[k] ) {
+			// open tables stay readable until their last reference goes
+			unlink(table->path.c_str());
+		}
+	}
+	compactions++;
+}
+
+/**
+ * FUNCTION NAME: compactLoop
+ *
+ * DESCRIPTION: Body of the compaction thread: compact while a level is due,
+ * 				then wait for a flush
+ */
+void LsmTree::compactLoop() {
+	unique_lock<mutex> guard(lock);
+
+	while ( !stopping ) {
+		lsm_compaction job;
+		if ( !pickCompaction(job) ) {
+			wakeup.wait(guard);
+			continue;
+		}
+		guard.unlock();
+		vector<shared_ptr<SSTable> > outputs = compact(job);
+		guard.lock();
+		install(job, outputs);
+	}
+}
+
+/**
+ * FUNCTION NAME: create
+ *
+ * DESCRIPTION: Insert key with value unless the tree has it
+ *
+ * RETURNS:
+ * true
+ */
+bool LsmTree::create(string_view key, string_view value) {
+	string_view old;
+
+	prefixKey(keyBuffer, partitionOf(key), key);
+	if ( !lookup(keyBuffer, old) ) {
+		put(keyBuffer, value, false, 0);
+		if ( wal != NULL ) {
+			wal->append(WAL_PUT, key, value);
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: read
+ *
+ * RETURNS:
+ * the value of key, valid until the tree is used again
+ * else an empty string
+ */
+string_view LsmTree::read(string_view key) {
+	string_view value;
+
+	prefixKey(keyBuffer, partitionOf(key), key);
+	if ( lookup(keyBuffer, value) ) {
+		return value;
+	}
+	return "";
+}
+
+/**
+ * FUNCTION NAME: update
+ *
+ * RETURNS:
+ * true if the tree had key
+ * false otherwise
+ */
+bool LsmTree::update(string_view key, string_view newValue) {
+	string_view old;
+
+	prefixKey(keyBuffer, partitionOf(key), key);
+	if ( !lookup(keyBuffer, old) ) {
+		return false;
+	}
+	put(keyBuffer, newValue, true, old.size());
+	if ( wal != NULL ) {
+		wal->append(WAL_PUT, key, newValue);
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: deleteKey
+ *
+ * RETURNS:
+ * true if the tree had key
+ * false otherwise
+ */
+bool LsmTree::deleteKey(string_view key) {
+	string_view old;
+
+	prefixKey(keyBuffer, partitionOf(key), key);
+	if ( !lookup(keyBuffer, old) ) {
+		return false;
+	}
+	put(keyBuffer, "", true, old.size());
+	if ( wal != NULL ) {
+		wal->append(WAL_DELETE, key, "");
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: isEmpty
+ */
+bool LsmTree::isEmpty() {
+	return currentSize() == 0;
+}
+
+/**
+ * FUNCTION NAME: currentSize
+ */
+unsigned long LsmTree::currentSize() {
+	unsigned long size = 0;
+
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		size += stats[i].keys;
+	}
+	return size;
+}
+
+/**
+ * FUNCTION NAME: clear
+ */
+void LsmTree::clear() {
+	reset();
+	if ( wal != NULL ) {
+		wal->append(WAL_CLEAR, "", "");
+	}
+}
+
+/**
+ * FUNCTION NAME: count
+ */
+unsigned long LsmTree::count(string_view key) {
+	string_view value;
+
+	prefixKey(keyBuffer, partitionOf(key), key);
+	return lookup(keyBuffer, value) ? 1 : 0;
+}
+
+/**
+ * FUNCTION NAME: scan
+ *
+ * DESCRIPTION: Call visit with every key from start to end (excluded, an empty
+ * 				end is none) and its value, in key order, without the partition
+ * 				before the key. Only reads the tables that overlap the range.
+ */
+void LsmTree::scan(string_view start, string_view end, function<void(string_view, string_view)> visit) {
+	vector<shared_ptr<SSTable> > tables;
+
+	{
+		lock_guard<mutex> guard(lock);
+		for ( int i = 0; i < LSM_LEVELS; i++ ) {
+			for ( auto &table : levels[i] ) {
+				if ( string_view(table->largest()) >= start && (end.empty() || string_view(table->smallest) < end) ) {
+					tables.push_back(table);
+				}
+			}
+		}
+	}
+	merge(true, tables, start, end, [&](string_view key, string_view value) {
+		if ( !value.empty() ) {
+			visit(key.substr(KV_PREFIX), value);
+		}
+	});
+}
+
+/**
+ * FUNCTION NAME: forEach
+ *
+ * DESCRIPTION: Call visit with every key and value, partition by partition and
+ * 				in key order within one. The tree must not be changed meanwhile;
+ * 				compactions may go on.
+ */
+void LsmTree::forEach(function<void(string_view, string_view)> visit) {
+	scan("", "", visit);
+}
+
+/**
+ * FUNCTION NAME: forEachIn
+ *
+ * DESCRIPTION: Call visit with every key and value of partition, in key order
+ */
+void LsmTree::forEachIn(int partition, function<void(string_view, string_view)> visit) {
+	string start, end;
+
+	prefixKey(start, partition, "");
+	prefixKey(end, partition + 1, "");
+	scan(start, end, visit);
+}
+
+/**
+ * FUNCTION NAME: dropPartition
+ *
+ * DESCRIPTION: Delete every key of partition, for a range the node no longer
+ * 				has a replica of
+ */
+void LsmTree::dropPartition(int partition) {
+	if ( stats[partition].keys == 0 ) {
+		return;
+	}
+	drop(partition);
+	if ( wal != NULL ) {
+		prefixKey(keyBuffer, partition, "");
+		wal->append(WAL_DROP, keyBuffer, "");
+	}
+}
+
+/**
+ * FUNCTION NAME: partitionStats
+ */
+kv_partition_stats LsmTree::partitionStats(int partition) {
+	return stats[partition];
+}
+
+/**
+ * FUNCTION NAME: attachLog
+ *
+ * DESCRIPTION: Replay the log into the memtable, then log every change from
+ * 				now on. The tree keeps the log but does not own it.
+ *
+ * RETURNS:
+ * number of records replayed
+ */
+long LsmTree::attachLog(WriteAheadLog *wal) {
+	long replayed;
+
+	this->wal = NULL;
+	replaying = true;
+	replayed = wal->replay(replayWrapper, this);
+	replaying = false;
+	this->wal = wal;
+	if ( memtableBytes >= memtableLimit ) {
+		flush();
+	}
+	return replayed;
+}
+
+/**
+ * FUNCTION NAME: replayWrapper
+ *
+ * DESCRIPTION: Apply one record of the log to the tree passed as env
+ */
+void LsmTree::replayWrapper(void *env, int op, string_view key, string_view value) {
+	LsmTree *tree = (LsmTree *)env;
+	string_view old;
+	bool had;
+
+	switch ( op ) {
+		case WAL_PUT:
+		case WAL_DELETE:
+			prefixKey(tree->keyBuffer, partitionOf(key), key);
+			had = tree->lookup(tree->keyBuffer, old);
+			if ( had || op == WAL_PUT ) {
+				tree->put(tree->keyBuffer, value, had, old.size());
+			}
+			break;
+		case WAL_CLEAR:
+			tree->reset();
+			break;
+		case WAL_DROP:
+			if ( key.size() == KV_PREFIX ) {
+				tree->drop((unsigned char)key[0] << 8 | (unsigned char)key[1]);
+			}
+			break;
+	}
+}
+
+/**
+ * FUNCTION NAME: deltaSize
+ *
+ * DESCRIPTION: Entries of the memtable, deletions included
+ */
+unsigned long LsmTree::deltaSize() {
+	return (unsigned long)memtable.size();
+}
+
+/**
+ * FUNCTION NAME: checkpoint
+ *
+ * DESCRIPTION: Write the memtable out, which empties the log
+ *
+ * RETURNS:
+ * number of entries written
+ */
+size_t LsmTree::checkpoint() {
+	size_t n = memtable.size();
+
+	flush();
+	return n;
+}
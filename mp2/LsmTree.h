@@ -0,0 +1,159 @@
+/**********************************
+ * FILE NAME: LsmTree.h
+ *
+ * DESCRIPTION: Header file of the log-structured storage engine
+ **********************************/
+
+#ifndef _LSMTREE_H_
+#define _LSMTREE_H_
+
+#include "stdincludes.h"
+#include "KVStore.h"
+#include "SSTable.h"
+#include <thread>
+#include <condition_variable>
+
+/*
+ * Macros
+ */
+#define LSM_LEVELS 7
+// level 0 tables that make level 0 due for compaction
+#define LSM_L0_TRIGGER 4
+// bytes of level 1 that make it due for compaction; every level after holds LSM_LEVEL_RATIO times more
+#define LSM_LEVEL_BASE (10 << 20)
+#define LSM_LEVEL_RATIO 10
+// compaction starts a new output table once one has this many bytes
+#define LSM_TABLE_BYTES (2 << 20)
+// bytes a memtable entry is counted for besides its key and value
+#define LSM_ENTRY_OVERHEAD 64
+
+/**
+ * Struct Name: lsm_compaction
+ *
+ * DESCRIPTION: A compaction of inputs[0], tables of level, with inputs[1], the
+ * 				tables of the next level they overlap, into the next level.
+ * 				Deletions are dropped when no level below has any table.
+ */
+typedef struct lsm_compaction {
+	int level;
+	vector<shared_ptr<SSTable> > inputs[2];
+	bool bottom;
+}lsm_compaction;
+
+/**
+ * CLASS NAME: LsmTree
+ *
+ * DESCRIPTION: Storage engine for more keys than fit in memory. Writes go to a
+ * 				sorted memtable, which is written out as a level 0 table once
+ * 				it holds LSM_MEMTABLE_BYTES (or at a checkpoint). A deletion is
+ * 				a record with an empty value, hiding the key in older tables.
+ *
+ * 				Level 0 tables may overlap; in every other level the tables
+ * 				hold disjoint key ranges. A thread of the tree compacts a level
+ * 				into the next when it grows past its size, so a lookup reads
+ * 				at most one block per level 0 table and one per other level,
+ * 				fewer thanks to the bloom filter of every table.
+ *
+ * 				The tables of every level are listed in the MANIFEST file of
+ * 				the directory, rewritten whole on every change, with the size
+ * 				of every partition as of the last flush. The memtable is only
+ * 				on disk through the write-ahead log, if one is attached.
+ *
+ * 				Keys are kept with their partition before them (see
+ * 				KVStore::prefixKey), so a partition is a range of every table.
+ */
+class LsmTree : public KVStore {
+private:
+	string dir;
+	// the directory is removed with the tree
+	bool temporary;
+	size_t memtableLimit;
+	int bloomBits;
+	// an empty value is a deletion
+	map<string, string, less<> > memtable;
+	size_t memtableBytes;
+	WriteAheadLog *wal;
+	bool replaying;
+	// the key of an operation, with its partition
+	string keyBuffer;
+	kv_partition_stats stats[KV_PARTITIONS];
+	string readBuffer;
+	string blockBuffer;
+
+	// everything below is shared with the compaction thread and guarded by lock
+	mutex lock;
+	condition_variable wakeup;
+	thread compactor;
+	bool stopping;
+	// level 0 newest first, the others by key
+	vector<shared_ptr<SSTable> > levels[LSM_LEVELS];
+	// largest key of the last table compacted out of every level
+	string compactPointer[LSM_LEVELS];
+	unsigned long nextNumber;
+	// stats as of the last flush, what the tables hold
+	kv_partition_stats flushedStats[KV_PARTITIONS];
+
+	// totals, for the stats log
+	atomic<long> userBytes;
+	atomic<long> flushBytes;
+	atomic<long> compactReadBytes;
+	atomic<long> compactWriteBytes;
+	atomic<long> compactions;
+	atomic<long> lookups;
+	atomic<long> blockReads;
+
+	string tablePath(unsigned long number);
+	void loadManifest();
+	void writeManifest();
+	bool lookup(string_view key, string_view &value);
+	void put(string_view key, string_view value, bool had, size_t oldlen);
+	void flush();
+	void drop(int partition);
+	void reset();
+	void merge(bool withMemtable, vector<shared_ptr<SSTable> > &tables, string_view start, string_view end,
+			function<void(string_view, string_view)> emit);
+	void scan(string_view start, string_view end, function<void(string_view, string_view)> visit);
+	bool pickCompaction(lsm_compaction &job);
+	vector<shared_ptr<SSTable> > compact(lsm_compaction &job);
+	void install(lsm_compaction &job, vector<shared_ptr<SSTable> > &outputs);
+	void compactLoop();
+	static void replayWrapper(void *env, int op, string_view key, string_view value);
+
+public:
+	LsmTree(string dir, size_t memtableLimit, int bloomBits, bool temporary);
+	LsmTree(const LsmTree &other) = delete;
+	LsmTree &operator=(const LsmTree &other) = delete;
+	virtual ~LsmTree();
+	bool create(string_view key, string_view value);
+	string_view read(string_view key);
+	bool update(string_view key, string_view newValue);
+	bool deleteKey(string_view key);
+	bool isEmpty();
+	unsigned long currentSize();
+	void clear();
+	unsigned long count(string_view key);
+	void forEach(function<void(string_view, string_view)> visit);
+	void forEachIn(int partition, function<void(string_view, string_view)> visit);
+	void dropPartition(int partition);
+	kv_partition_stats partitionStats(int partition);
+	long attachLog(WriteAheadLog *wal);
+	unsigned long deltaSize();
+	size_t checkpoint();
+	long getUserBytes() {
+		return userBytes;
+	}
+	long getDiskBytesWritten() {
+		return flushBytes + compactWriteBytes;
+	}
+	long getCompactions() {
+		return compactions;
+	}
+	long getLookups() {
+		return lookups;
+	}
+	long getBlockReads() {
+		return blockReads;
+	}
+};
+
+#endif /* _LSMTREE_H_ */
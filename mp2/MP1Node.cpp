@@ -35,18 +35,33 @@ void MP1Node::addToList(int id, short port, long heartbeat, long timestamp) {
     MemberListEntry* tmp = new MemberListEntry(id, port, heartbeat, timestamp);
     memberNode->memberList.push_back(*tmp);
     delete tmp;
+    notifyMemberChange(&addr, true);
     #ifdef DEBUGLOG
     log->logNodeAdd(&memberNode->addr, &addr);
     #endif
 }
 
+/**
+ * FUNCTION NAME: notifyMemberChange
+ *
+ * DESCRIPTION: addr joined or left the membership table: move its epoch on and
+ *              tell whoever listens (see Member::memberChanged)
+ */
+void MP1Node::notifyMemberChange(Address *addr, bool joined) {
+    memberNode->memberEpoch++;
+    if(memberNode->memberChanged != NULL) {
+        memberNode->memberChanged(memberNode->memberChangedEnv, addr, joined);
+    }
+}
+
 void MP1Node::removeNodeFromList(int id, short port) {
     for(auto& it : memberNode->memberList) {  
         if(it.id == id) {
             swap(it, memberNode->memberList.back());
             memberNode->memberList.pop_back();
+            Address nodeToRemoveAddress = getAddr(id, port);
+            notifyMemberChange(&nodeToRemoveAddress, false);
             #ifdef DEBUGLOG
-                Address nodeToRemoveAddress = getAddr(id, port);
                 log->logNodeRemove(&memberNode->addr, &nodeToRemoveAddress);
             #endif
             break;
@@ -77,14 +92,17 @@ void MP1Node::joinrepHanlder(Address *destinationAddr) {
     free(msg);
 }
 
-void MP1Node::heatbeatHandler(Address *destinationAddr) {
-    size_t msgsize = sizeof(MessageHdr) + sizeof(destinationAddr->addr) + sizeof(long) + 1;
-    MessageHdr *msg = (MessageHdr *) malloc(msgsize * sizeof(char));
-    msg->msgType = HEARTBEAT;
-    memcpy((char*)(msg + 1), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
-    memcpy((char*)(msg + 1) + sizeof(memberNode->addr.addr), &memberNode->heartbeat, sizeof(long));
-    emulNet->ENsend(&memberNode->addr, destinationAddr, (char *)msg, msgsize);
-    free(msg);
+void MP1Node::heatbeatHandler(vector<Address> &destinationAddrs) {
+    // one heartbeat, built once and shared by every destination
+    char buffer[sizeof(MessageHdr) + sizeof(memberNode->addr.addr) + sizeof(long) + 1];
+    MessageHdr hdr;
+    if(destinationAddrs.empty()) return;
+    memset(buffer, 0, sizeof(buffer));
+    hdr.msgType = HEARTBEAT;
+    memcpy(buffer, &hdr, sizeof(MessageHdr));
+    memcpy(buffer + sizeof(MessageHdr), &memberNode->addr.addr, sizeof(memberNode->addr.addr));
+    memcpy(buffer + sizeof(MessageHdr) + sizeof(memberNode->addr.addr), &memberNode->heartbeat, sizeof(long));
+    emulNet->ENsendv(&memberNode->addr, destinationAddrs.data(), destinationAddrs.size(), buffer, sizeof(buffer), NULL);
 }
 
 void MP1Node::joinrepMsgSerializer(MessageHdr *msg) {
@@ -121,7 +139,7 @@ void MP1Node::joinrepMsgDeserializer(char *data) {
  * You can add new members to the class if you think it
  * is necessary for your logic to work
  */
-MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Address *address) {
+MP1Node::MP1Node(Member *member, Params *params, Transport *emul, Log *log, Address *address) {
     for( int i = 0; i < 6; i++ ) {
         NULLADDR[i] = 0;
     }
@@ -130,6 +148,7 @@ MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Addres
     this->log = log;
     this->par = params;
     this->memberNode->addr = *address;
+    this->lastOps = -1;
 }
 
 /**
@@ -225,7 +244,7 @@ int MP1Node::initThisNode(Address *joinaddr) {
 int MP1Node::introduceSelfToGroup(Address *joinaddr) {
     MessageHdr *msg;
 #ifdef DEBUGLOG
-    static char s[1024];
+    char s[1024];
 #endif
 
     if ( 0 == memcmp((char *)&(memberNode->addr.addr), (char *)&(joinaddr->addr), sizeof(memberNode->addr.addr))) {
@@ -266,6 +285,7 @@ void MP1Node::resetStates() {
     memberNode->pingCounter = TFAIL;
     memberNode->timeOutCounter = -1;
     initMemberListTable(memberNode);
+    lastOps = -1;
 }
 /**
  * FUNCTION NAME: finishUpThisNode
@@ -292,6 +312,9 @@ void MP1Node::nodeLoop() {
         return;
     }
 
+    // Account for the time steps this node was not run for
+    catchUp();
+
     // Check my messages
     checkMessages();
 
@@ -321,6 +344,8 @@ void MP1Node::checkMessages() {
         size = memberNode->mp1q.front().size;
         memberNode->mp1q.pop();
         recvCallBack((void *)memberNode, (char *)ptr, size);
+        // the payload still lives in the network's frame, hand it back
+        emulNet->ENrelease((char *)ptr);
     }
     return;
 }
@@ -334,10 +359,10 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
     /*
      * Your code goes here
      */
-    MessageHdr* receivedMsg = (MessageHdr*) malloc(size * sizeof(char));
-    memcpy(receivedMsg, data, sizeof(MessageHdr));
+    MessageHdr receivedMsg;
+    memcpy(&receivedMsg, data, sizeof(MessageHdr));
     
-    switch(receivedMsg->msgType) {
+    switch(receivedMsg.msgType) {
         case JOINREQ : {
             // parse data
             int id; short port; long heartbeat;
@@ -401,10 +426,12 @@ void MP1Node::nodeLoopOps() {
         memberNode->heartbeat++;
         
         // Send out heartbeat messages 
+        vector<Address> destinations;
         for(auto it : memberNode->memberList) {  
             auto addr = getAddr(it.id, it.getport());
-            if(!isSameAddr(&addr)) heatbeatHandler(&addr);
+            if(!isSameAddr(&addr)) destinations.push_back(addr);
         }
+        heatbeatHandler(destinations);
         
         memberNode->pingCounter = TFAIL;
     }
@@ -419,6 +446,7 @@ void MP1Node::nodeLoopOps() {
         if(memberNode->timeOutCounter - it.timestamp > TREMOVE) {
             swap(it, memberNode->memberList.back());
             memberNode->memberList.pop_back();
+            notifyMemberChange(&addr, false);
             #ifdef DEBUGLOG
             log->logNodeRemove(&memberNode->addr, &addr);
             #endif
@@ -427,9 +455,56 @@ void MP1Node::nodeLoopOps() {
     }
 
     memberNode->timeOutCounter++;
+    lastOps = par->getcurrtime();
     return;
 }
 
+/**
+ * FUNCTION NAME: catchUp
+ *
+ * DESCRIPTION: With the event driven simulation a node in the group is not run at
+ *              time steps where nextWake says nothing happens. Count those steps
+ *              on the heartbeat and timeout counters as nodeLoopOps would have.
+ */
+void MP1Node::catchUp() {
+    if( !memberNode->inGroup || lastOps < 0 ) {
+        return;
+    }
+    int idle = par->getcurrtime() - lastOps - 1;
+    if( idle > 0 ) {
+        memberNode->pingCounter -= idle;
+        memberNode->timeOutCounter += idle;
+        lastOps += idle;
+    }
+}
+
+/**
+ * FUNCTION NAME: nextWake
+ *
+ * DESCRIPTION: Earliest time step at which nodeLoopOps does something: send a
+ *              heartbeat or remove a member. Messages wake the node up anyway.
+ *
+ * RETURNS:
+ * the time step, INT_MAX if there is none
+ */
+int MP1Node::nextWake() {
+    if( memberNode->bFailed || !memberNode->inGroup ) {
+        return INT_MAX;
+    }
+    if( lastOps < 0 ) {
+        return par->getcurrtime() + 1;
+    }
+    // nodeLoopOps at lastOps + k sees pingCounter - (k - 1) and timeOutCounter + (k - 1)
+    int wake = lastOps + memberNode->pingCounter + 1;
+    for(auto& it : memberNode->memberList) {
+        Address addr = getAddr(it.id, it.getport());
+        if(isSameAddr(&addr)) continue;
+        long k = TREMOVE + it.timestamp - memberNode->timeOutCounter + 2;
+        wake = min(wake, lastOps + (int)max(k, 1L));
+    }
+    return wake;
+}
+
 Address MP1Node::getAddr(int id, short port) {
     Address nodeaddr;
 
@@ -470,6 +545,10 @@ Address MP1Node::getJoinAddress() {
  * DESCRIPTION: Initialize the membership list
  */
 void MP1Node::initMemberListTable(Member *memberNode) {
+    for(auto& it : memberNode->memberList) {
+        Address addr = getAddr(it.id, it.port);
+        notifyMemberChange(&addr, false);
+    }
     memberNode->memberList.clear();
 }
 
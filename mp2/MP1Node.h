@@ -12,7 +12,7 @@
 #include "Log.h"
 #include "Params.h"
 #include "Member.h"
-#include "EmulNet.h"
+#include "Transport.h"
 #include "Queue.h"
 
 /**             #define TOLE 20  // time limit to remove a node
@@ -50,14 +50,17 @@ typedef struct MessageHdr {
  */
 class MP1Node {
 private:
-        EmulNet *emulNet;
+        Transport *emulNet;
         Log *log;
         Params *par;
         Member *memberNode;
         char NULLADDR[6];
+        // time nodeLoopOps last ran, -1 before the node is in the group
+        int lastOps;
+        void catchUp();
 
 public:
-        MP1Node(Member *, Params *, EmulNet *, Log *, Address *);
+        MP1Node(Member *, Params *, Transport *, Log *, Address *);
         Member * getMemberNode() {
                 return memberNode;
         }
@@ -71,6 +74,7 @@ public:
         void checkMessages();
         bool recvCallBack(void *env, char *data, int size);
         void nodeLoopOps();
+        int nextWake();
         int isNullAddress(Address *addr);
         Address getJoinAddress();
         Address getAddr(int id, short port); 
@@ -80,9 +84,10 @@ public:
         MemberListEntry* getNodeInList(int id);
         void addToList(int id, short port, long heartbeat, long timestamp);
         void removeNodeFromList(int id, short port);
+        void notifyMemberChange(Address *addr, bool joined);
         void joinreqHanlder(Address *joinaddr);
         void joinrepHanlder(Address *destinationAddr);
-        void heatbeatHandler(Address *destinationAddr);
+        void heatbeatHandler(vector<Address> &destinationAddrs);
         void joinrepMsgSerializer(MessageHdr *msg);
         void joinrepMsgDeserializer(char *data);
         void resetStates();
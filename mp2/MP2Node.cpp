@@ -8,20 +8,69 @@
 /**
  * constructor
  */
-MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log, Address * address) {
+MP2Node::MP2Node(Member *memberNode, Params *par, Transport * emulNet, Log * log, Address * address) {
 	this->memberNode = memberNode;
 	this->par = par;
 	this->emulNet = emulNet;
 	this->log = log;
-	ht = new HashTable();
 	this->memberNode->addr = *address;
+	transCount = 0;
+	wal = NULL;
+	walSince = -1;
+	lastCheckpoint = 0;
+	string name = "node" + to_string(*(int *)(address->addr));
+	if ( par->STORAGE == LSM_STORAGE ) {
+		// without a log directory the tables go to one of this process, removed on exit
+		string dir = par->WAL_DIR.empty() ? "kvdata." + to_string(getpid()) : par->WAL_DIR;
+		ht = new LsmTree(dir + "/" + name + ".lsm", par->LSM_MEMTABLE_BYTES, par->LSM_BLOOM_BITS, par->WAL_DIR.empty());
+	}
+	else {
+		HashTable *table = new HashTable();
+		if ( !par->WAL_DIR.empty() ) {
+			table->openSnapshot(par->WAL_DIR + "/" + name + ".snap");
+		}
+		ht = table;
+	}
+	if ( !par->WAL_DIR.empty() ) {
+		// the store comes back as the previous run of this node left it: what
+		// it has on disk (a snapshot or tables), and the changes logged since
+		wal = new WriteAheadLog(par->WAL_DIR, name + ".wal", par->WAL_SYNC);
+		ht->attachLog(wal);
+	}
+	hlcTime = 0;
+	hlcCount = 0;
+	merkle = new MerkleTree(ht);
+	// tombstones the previous run of this node left get their grace again
+	ht->forEach([&](string_view key, string_view record) {
+		string_view value;
+		unsigned long long version;
+
+		if (Entry::isTombstone(record)) {
+			Entry::view(record, value, version);
+			tombstones.push_back(Tombstone{tombstoneDrop(version), string(key), version});
+		}
+	});
+	// the ring follows the membership table from here on; the node itself is
+	// always on it, whether or not its table lists it (the introducer's does not)
+	vector<Node> members = getMembershipList();
+	ringNodes.insert(members.begin(), members.end());
+	ringNodes.insert(Node(memberNode->addr));
+	ringEpoch = memberNode->memberEpoch - 1;
+	memberNode->memberChanged = memberChangedWrapper;
+	memberNode->memberChangedEnv = this;
+	aeEvents = 0;
+	aeMessages = 0;
+	aeBytes = 0;
+	served = 0;
 }
 
 /**
  * Destructor
  */
 MP2Node::~MP2Node() {
+	delete merkle;
 	delete ht;
+	delete wal;
 	delete memberNode;
 }
 
@@ -29,43 +78,67 @@ MP2Node::~MP2Node() {
  * FUNCTION NAME: updateRing
  *
  * DESCRIPTION: This function does the following:
- * 				1) Gets the current membership list from the Membership Protocol (MP1Node)
- * 				   The membership list is returned as a vector of Nodes. See Node class in Node.h
- * 				2) Constructs the ring based on the membership list
+ * 				1) Checks whether the membership changed since the ring was built,
+ * 				   from the epoch of the Membership Protocol (MP1Node)
+ * 				2) If so, takes the ring from ringNodes, which memberChanged
+ * 				   keeps sorted as members join and leave
  * 				3) Calls the Stabilization Protocol
  */
 void MP2Node::updateRing() {
 	/*
-	 * Implement this. Parts of it are already implemented
-	 */
-	vector<Node> curMemList;
-	bool change = false;
-
-	/*
-	 *  Step 1. Get the current membership list from Membership Protocol / MP1
+	 *  Step 1. Compare the epoch of the membership list from Membership Protocol / MP1
 	 */
-	curMemList = getMembershipList();
+	if (ringEpoch == memberNode->memberEpoch) {
+		return;
+	}
+	ringEpoch = memberNode->memberEpoch;
 
 	/*
 	 * Step 2: Construct the ring
 	 */
-	// Sort the list based on the hashCode
-	sort(curMemList.begin(), curMemList.end());
-	ring = curMemList;
+	ring.build(ringNodes, par->REPLICAS, par->VNODES);
 
 	/*
-	 * Step 3: Run the stabilization protocol IF REQUIRED
+	 * Step 3: Run the stabilization protocol, which only acts on the partitions whose replicas changed
 	 */
-	// Run stabilization protocol if the hash table size is greater than zero and if there has been a changed in the ring
 	stabilizationProtocol();
 }
 
+/**
+ * FUNCTION NAME: memberChangedWrapper
+ *
+ * DESCRIPTION: Called by the Membership Protocol when addr joins or leaves
+ * 				(see Member::memberChanged)
+ */
+void MP2Node::memberChangedWrapper(void *env, Address *addr, bool joined) {
+	((MP2Node *)env)->memberChanged(addr, joined);
+}
+
+/**
+ * FUNCTION NAME: memberChanged
+ *
+ * DESCRIPTION: Put a member that joined into its place in ringNodes, or take
+ * 				one that left out, in O(log N). The ring itself is rebuilt
+ * 				from it on the next updateRing. The node never leaves its own
+ * 				ring: it stops running when it fails.
+ */
+void MP2Node::memberChanged(Address *addr, bool joined) {
+	Node node(*addr);
+
+	if (joined) {
+		ringNodes.insert(node);
+	} else if (!(*addr == memberNode->addr)) {
+		ringNodes.erase(node);
+	}
+}
+
 /**
  * FUNCTION NAME: getMemberhipList
  *
  * DESCRIPTION: This function goes through the membership list from the Membership protocol/MP1 and
  * 				i) generates the hash code for each member
- * 				ii) populates the ring member in MP2Node class
+ * 				ii) populates the ring member in MP2Node class; only used to start
+ * 				    ringNodes, memberChanged follows the list from there
  * 				It returns a vector of Nodes. Each element in the vector contain the following fields:
  * 				a) Address of the node
  * 				b) Hash code obtained by consistent hashing of the Address
@@ -89,48 +162,83 @@ vector<Node> MP2Node::getMembershipList() {
  *
  * DESCRIPTION: This functions hashes the key and returns the position on the ring
  * 				HASH FUNCTION USED FOR CONSISTENT HASHING
+ * 				A key is at a token of its own, the one its store partition
+ * 				is picked by
  *
  * RETURNS:
  * size_t position on the ring
  */
-size_t MP2Node::hashFunction(string key) {
-	std::hash<string> hashFunc;
-	size_t ret = hashFunc(key);
-	return ret%RING_SIZE;
+size_t MP2Node::hashFunction(string_view key) {
+	return KVStore::tokenOf(key);
 }
 
-MessageBase * MP2Node::createMessageBase(MessageType type, string key, string value){
+/**
+ * FUNCTION NAME: newTransID
+ *
+ * DESCRIPTION: Id of the next transaction this node starts, unique across
+ * 				nodes without a shared counter, so nodes on different threads
+ * 				hand out the same ids as they would on one
+ */
+int MP2Node::newTransID() {
+	return transCount++ * par->EN_GPSZ + *(int *)(memberNode->addr.addr) - 1;
+}
+
+/**
+ * FUNCTION NAME: createMessageBase
+ *
+ * DESCRIPTION: Start an operation on key, done once level of its replicas
+ * 				succeeded: ONE of them, a QUORUM (a majority), or ALL
+ */
+MessageBase * MP2Node::createMessageBase(MessageType type, string key, string value, consistencyLEVEL level){
 	//Message *message = (Message *) malloc(sizeof(Message));
 	MessageBase *messagebase = new MessageBase();
-	messagebase->id = g_transID++;
+	messagebase->id = newTransID();
 	messagebase->total = 0;
 	messagebase->success = 0;
+	messagebase->replicas = par->REPLICAS;
+	switch (level) {
+		case ONE:
+			messagebase->need = 1;
+			break;
+		case ALL:
+			messagebase->need = par->REPLICAS;
+			break;
+		default:
+			messagebase->need = par->REPLICAS / 2 + 1;
+			break;
+	}
 	messagebase->currtime = par->getcurrtime();
 	messagebase->type = type;
 	messagebase->key = key;
 	messagebase->value = value;
+	// a READ starts below every version, so the first value replied is taken
+	messagebase->version = type != READ ? stamp() : 0;
 	msg_list[messagebase->id] = messagebase;
 	return messagebase;
 }
 
 void MP2Node::dispatchMsg(MessageBase *messagebase) {
-	Message *msg;
-	vector<Node> replicas = findNodes(messagebase->key);
-	if (replicas.size() == 3) {
-		// send to first replica
-		msg = new Message(messagebase->id, memberNode->addr, messagebase->type, messagebase->key, messagebase->value, PRIMARY);
-		emulNet->ENsend(&memberNode->addr, &replicas.at(0).nodeAddress, msg->toString());
-		delete msg;
-
-		// send to second replica
-		msg = new Message(messagebase->id, memberNode->addr, messagebase->type, messagebase->key, messagebase->value, SECONDARY);
-		emulNet->ENsend(&memberNode->addr, &replicas.at(1).nodeAddress, msg->toString());
-		delete msg;
+	const int *replicas = replicasOf(messagebase->key);
+	if (replicas != NULL) {
+		// serialize once; each replica only differs in the replica type
+		Message msg(messagebase->id, memberNode->addr, messagebase->type, messagebase->key, messagebase->value, PRIMARY);
+		msg.timestamp = messagebase->version;
+		string data = msg.toBytes();
+		int offset = Message::replicaOffset(data, messagebase->type);
+		int n = ring.getReplicas();
+		Address to[MAX_REPLICAS];
+		string bytes[MAX_REPLICAS];
+		en_patch patches[MAX_REPLICAS];
 
-		// send to third replica
-		msg = new Message(messagebase->id, memberNode->addr, messagebase->type, messagebase->key, messagebase->value, TERTIARY);
-		emulNet->ENsend(&memberNode->addr, &replicas.at(2).nodeAddress, msg->toString());
-		delete msg;
+		for (int i = 0; i < n; i++) {
+			to[i] = ring.at(replicas[i]).nodeAddress;
+			bytes[i] = Message::replicaBytes(i);
+			patches[i].offset = offset;
+			// the primary's copy already has the right replica type
+			patches[i].len = (offset < 0 || i == 0) ? 0 : bytes[i].size();
+			patches[i].bytes = bytes[i].data();
+		}
+		emulNet->ENsendv(&memberNode->addr, to, n, (char *)data.data(), data.size(), patches);
 	}
 }
 
@@ -147,7 +255,16 @@ void MP2Node::clientCreate(string key, string value) {
 	/*
 	 * Implement this
 	 */
-	 dispatchMsg(createMessageBase(CREATE, key, value));
+	 clientCreate(key, value, (consistencyLEVEL)par->WRITE_CONSISTENCY);
+}
+
+/**
+ * FUNCTION NAME: clientCreate
+ *
+ * DESCRIPTION: client side CREATE API at consistency level level
+ */
+void MP2Node::clientCreate(string key, string value, consistencyLEVEL level){
+	 dispatchMsg(createMessageBase(CREATE, key, value, level));
 }
 
 /**
@@ -163,7 +280,16 @@ void MP2Node::clientRead(string key){
 	/*
 	 * Implement this
 	 */
-	 dispatchMsg(createMessageBase(READ, key, ""));
+	 clientRead(key, (consistencyLEVEL)par->READ_CONSISTENCY);
+}
+
+/**
+ * FUNCTION NAME: clientRead
+ *
+ * DESCRIPTION: client side READ API at consistency level level
+ */
+void MP2Node::clientRead(string key, consistencyLEVEL level){
+	 dispatchMsg(createMessageBase(READ, key, "", level));
 }
 
 /**
@@ -179,7 +305,16 @@ void MP2Node::clientUpdate(string key, string value){
 	/*
 	 * Implement this
 	 */
-	 dispatchMsg(createMessageBase(UPDATE, key, value));
+	 clientUpdate(key, value, (consistencyLEVEL)par->WRITE_CONSISTENCY);
+}
+
+/**
+ * FUNCTION NAME: clientUpdate
+ *
+ * DESCRIPTION: client side UPDATE API at consistency level level
+ */
+void MP2Node::clientUpdate(string key, string value, consistencyLEVEL level){
+	 dispatchMsg(createMessageBase(UPDATE, key, value, level));
 }
 
 /**
@@ -195,7 +330,16 @@ void MP2Node::clientDelete(string key){
 	/*
 	 * Implement this
 	 */
-	 dispatchMsg(createMessageBase(DELETE, key, ""));
+	 clientDelete(key, (consistencyLEVEL)par->WRITE_CONSISTENCY);
+}
+
+/**
+ * FUNCTION NAME: clientDelete
+ *
+ * DESCRIPTION: client side DELETE API at consistency level level
+ */
+void MP2Node::clientDelete(string key, consistencyLEVEL level){
+	 dispatchMsg(createMessageBase(DELETE, key, "", level));
 }
 
 /**
@@ -203,15 +347,35 @@ void MP2Node::clientDelete(string key){
  *
  * DESCRIPTION: Server side CREATE API
  * 			   	The function does the following:
- * 			   	1) Inserts key value into the local hash table
+ * 			   	1) Inserts key value into the local hash table, or replaces the
+ * 			   	   entry or tombstone there if this version is newer
  * 			   	2) Return true or false based on success or failure
  */
-bool MP2Node::createKeyValue(int id, string key, string value, ReplicaType replica) {
+bool MP2Node::createKeyValue(int id, string_view key, string_view value, int replica, unsigned long long version) {
 	/*
 	 * Implement this
 	 */
+	string_view stored, storedValue;
+	unsigned long long storedVersion;
+	bool ok;
+
+	observe(version);
 	// Insert key, value, replicaType into the hash table
-	if (ht->create(key, value)) {
+	Entry::encode(record, value, version, replica);
+	stored = ht->read(key);
+	if (stored.empty()) {
+		merkle->change(key, "", record);
+		ok = ht->create(key, record);
+	} else {
+		// last writer wins; an older create is dropped, but still succeeds
+		Entry::view(stored, storedValue, storedVersion);
+		ok = version <= storedVersion;
+		if (!ok) {
+			merkle->change(key, stored, record);
+			ok = ht->update(key, record);
+		}
+	}
+	if (ok) {
 		log->logCreateSuccess(&memberNode->addr, false, id, key, value); // log success
 		return true;
 	} else {
@@ -226,15 +390,17 @@ bool MP2Node::createKeyValue(int id, string key, string value, ReplicaType repli
  * DESCRIPTION: Server side READ API
  * 			    This function does the following:
  * 			    1) Read key from local hash table
- * 			    2) Return value
+ * 			    2) Return value, and its version in version
  */
-string MP2Node::readKey(int id, string key) {
+string_view MP2Node::readKey(int id, string_view key, unsigned long long &version) {
 	/*
 	 * Implement this
 	 */
-	// Read key from local hash table and return value
-	string value = ht->read(key);
-	if (value != "") {
+	// Read key from local hash table and return value; it stays in the table
+	string_view value, stored = ht->read(key);
+	// a tombstone reads as no value, with the version of the delete
+	Entry::view(stored, value, version);
+	if (!value.empty()) {
 		log->logReadSuccess(&memberNode->addr, false, id, key, value); // log success
 	} else {
 		log->logReadFail(&memberNode->addr, false, id, key); // log failure
@@ -247,15 +413,38 @@ string MP2Node::readKey(int id, string key) {
  *
  * DESCRIPTION: Server side UPDATE API
  * 				This function does the following:
- * 				1) Update the key to the new value in the local hash table
+ * 				1) Update the key to the new value in the local hash table,
+ * 				   unless the value there has a newer version. A key deleted
+ * 				   by an older delete is not there to update.
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::updateKeyValue(int id, string key, string value, ReplicaType replica) {
+bool MP2Node::updateKeyValue(int id, string_view key, string_view value, int replica, unsigned long long version) {
 	/*
 	 * Implement this
 	 */
+	string_view stored, storedValue;
+	unsigned long long storedVersion;
+	bool ok;
+
+	observe(version);
 	// Update key in local hash table and return true or false
-	if (ht->update(key, value)) {
+	stored = ht->read(key);
+	Entry::view(stored, storedValue, storedVersion);
+	if (stored.empty()) {
+		ok = false;
+	} else if (Entry::isTombstone(stored)) {
+		// an update older than the delete is dropped, but still succeeds
+		ok = version < storedVersion;
+	} else {
+		// last writer wins; an older update is dropped, but still succeeds
+		Entry::encode(record, value, version, replica);
+		ok = version < storedVersion;
+		if (!ok) {
+			merkle->change(key, stored, record);
+			ok = ht->update(key, record);
+		}
+	}
+	if (ok) {
 		log->logUpdateSuccess(&memberNode->addr, false, id, key, value); // log success
 		return true;
 	} else {
@@ -269,15 +458,39 @@ bool MP2Node::updateKeyValue(int id, string key, string value, ReplicaType repli
  *
  * DESCRIPTION: Server side DELETE API
  * 				This function does the following:
- * 				1) Delete the key from the local hash table
+ * 				1) Replace the entry of the key in the local hash table with a
+ * 				   tombstone, unless the entry has a newer version
  * 				2) Return true or false based on success or failure
  */
-bool MP2Node::deleteKey(int id, string key) {
+bool MP2Node::deleteKey(int id, string_view key, int replica, unsigned long long version) {
 	/*
 	 * Implement this
 	 */
+	string_view stored, storedValue;
+	unsigned long long storedVersion;
+	bool ok;
+
+	observe(version);
 	// Delete the key from the local hash table
-	if (ht->deleteKey(key)) {
+	stored = ht->read(key);
+	Entry::view(stored, storedValue, storedVersion);
+	if (stored.empty()) {
+		ok = false;
+	} else if (Entry::isTombstone(stored)) {
+		// a delete older than the one that left the tombstone is dropped, but still succeeds
+		ok = version < storedVersion;
+	} else {
+		// last writer wins; an older delete is dropped, but still succeeds
+		ok = version < storedVersion;
+		if (!ok) {
+			// the tombstone stays until the other replicas had time to learn of the delete
+			Entry::encode(record, "", version, replica, ENTRY_TOMBSTONE);
+			merkle->change(key, stored, record);
+			ok = ht->update(key, record);
+			tombstones.push_back(Tombstone{tombstoneDrop(version), string(key), version});
+		}
+	}
+	if (ok) {
 		log->logDeleteSuccess(&memberNode->addr, false, id, key); // log success
 		return true;
 	} else {
@@ -300,6 +513,8 @@ void MP2Node::checkMessages() {
 	 */
 	char * data;
 	int size;
+	string_view value;
+	unsigned long long version;
 
 	/*
 	 * Declare your local variables here
@@ -314,63 +529,126 @@ void MP2Node::checkMessages() {
 		size = memberNode->mp2q.front().size;
 		memberNode->mp2q.pop();
 
-		Message *msgRcvd = new Message(string(data, data + size));
+		// read in place; the payload lives in the network's frame until released below
+		MessageView msgRcvd(data, size);
+		if ( !msgRcvd.valid ) {
+			// not a message of this version
+			emulNet->ENrelease(data);
+			continue;
+		}
 
 		/*
 		 * Handle the message types here
 		 */
+		if (msgRcvd.type <= DELETE) {
+			served++;
+		}
 
-		Message *msgSend;
-    		switch(msgRcvd->type) {
+		switch(msgRcvd.type) {
 			case CREATE:
-				msgSend = new Message(msgRcvd->transID, memberNode->addr, REPLY, false);
-				msgSend->success = createKeyValue(msgRcvd->transID, msgRcvd->key, msgRcvd->value, msgRcvd->replica);
-				// send reply back
-				emulNet->ENsend(&memberNode->addr, &msgRcvd->fromAddr, msgSend->toString());
-				delete msgSend;
+				Message::encodeReply(reply, msgRcvd.transID, memberNode->addr, REPLY,
+						createKeyValue(msgRcvd.transID, msgRcvd.key, msgRcvd.value, msgRcvd.replica, msgRcvd.timestamp), "", 0);
+				// send reply back once the write is in the log
+				sendWriteReply(&msgRcvd.fromAddr);
 				break;
 			case READ:
-			msgSend = new Message(msgRcvd->transID, memberNode->addr, READREPLY, "");
-				msgSend->value = readKey(msgRcvd->transID, msgRcvd->key);
+				value = readKey(msgRcvd.transID, msgRcvd.key, version);
+				Message::encodeReply(reply, msgRcvd.transID, memberNode->addr, READREPLY, true, value, version);
 				// send reply back
-				emulNet->ENsend(&memberNode->addr, &msgRcvd->fromAddr, msgSend->toString());
-				delete msgSend;
+				emulNet->ENsend(&memberNode->addr, &msgRcvd.fromAddr, reply.data(), reply.size());
 				break;
 			case UPDATE:
-				msgSend = new Message(msgRcvd->transID, memberNode->addr, REPLY, false);
-				msgSend->success = updateKeyValue(msgRcvd->transID, msgRcvd->key, msgRcvd->value, msgRcvd->replica);
-				// send reply back
-				emulNet->ENsend(&memberNode->addr, &msgRcvd->fromAddr, msgSend->toString());
-				delete msgSend;
+				Message::encodeReply(reply, msgRcvd.transID, memberNode->addr, REPLY,
+						updateKeyValue(msgRcvd.transID, msgRcvd.key, msgRcvd.value, msgRcvd.replica, msgRcvd.timestamp), "", 0);
+				// send reply back once the write is in the log
+				sendWriteReply(&msgRcvd.fromAddr);
 				break;
 			case DELETE:
-				msgSend = new Message(msgRcvd->transID, memberNode->addr, REPLY, false);
-				msgSend->success = deleteKey(msgRcvd->transID, msgRcvd->key);
-				// send reply back
-				emulNet->ENsend(&memberNode->addr, &msgRcvd->fromAddr, msgSend->toString());
-				delete msgSend;
+				Message::encodeReply(reply, msgRcvd.transID, memberNode->addr, REPLY,
+						deleteKey(msgRcvd.transID, msgRcvd.key, msgRcvd.replica, msgRcvd.timestamp), "", 0);
+				// send reply back once the write is in the log
+				sendWriteReply(&msgRcvd.fromAddr);
 				break;
 			case REPLY:
-				processReply(msgRcvd->transID, msgRcvd->success, "");
+				processReply(msgRcvd.transID, msgRcvd.success, "", 0);
 				break;
 			case READREPLY:
-				processReply(msgRcvd->transID, false, msgRcvd->value);
+				observe(msgRcvd.timestamp);
+				processReply(msgRcvd.transID, false, msgRcvd.value, msgRcvd.timestamp);
+				break;
+			case MERKLE:
+				processMerkle(&msgRcvd.fromAddr, msgRcvd.key, msgRcvd.value);
+				break;
+			case REPAIR:
+				// nobody waits for the outcome of a repair
+				if (msgRcvd.success) {
+					repairTombstone(msgRcvd.key, msgRcvd.replica, msgRcvd.timestamp);
+				} else {
+					createKeyValue(msgRcvd.transID, msgRcvd.key, msgRcvd.value, msgRcvd.replica, msgRcvd.timestamp);
+				}
 				break;
 		}
-		delete msgRcvd;
+		emulNet->ENrelease(data);
 	}
 
 	/*
 	 * This function should also ensure all READ and UPDATE operation
 	 * get QUORUM replies
 	 */
-	 for(auto const& it : msg_list) {
-		 checkTimeout(msg_list[it.first], par->getcurrtime());
+	 // checkQuorum may erase the current entry, so step past it first
+	 for(auto it = msg_list.begin(); it != msg_list.end(); ) {
+		 MessageBase *messagebase = (it++)->second;
+		 checkTimeout(messagebase, par->getcurrtime());
 	 }
 
+	 dropLingering();
+	 dropTombstones();
+	 commitLog();
+	 checkpointStore();
 }
 
-void MP2Node::processReply(int id, bool success, string value){
+/**
+ * FUNCTION NAME: sendWriteReply
+ *
+ * DESCRIPTION: Send the reply to a CREATE, UPDATE or DELETE, or hold it while
+ * 				writes it may acknowledge are not committed to the log yet
+ */
+void MP2Node::sendWriteReply(Address *to) {
+	if ( wal != NULL && wal->getPending() > 0 ) {
+		heldReplies.emplace_back(*to, reply);
+	}
+	else {
+		emulNet->ENsend(&memberNode->addr, to, reply.data(), reply.size());
+	}
+}
+
+/**
+ * FUNCTION NAME: commitLog
+ *
+ * DESCRIPTION: Group commit: once the oldest uncommitted write is WAL_WINDOW
+ * 				time steps old, write every write since in one go and send
+ * 				the replies held for them
+ */
+void MP2Node::commitLog() {
+	if ( wal == NULL ) {
+		return;
+	}
+	// held replies with nothing pending: the store wrote the writes out itself and emptied the log
+	if ( (wal->getPending() > 0 || !heldReplies.empty()) && walSince < 0 ) {
+		walSince = par->getcurrtime();
+	}
+	if ( walSince < 0 || par->getcurrtime() < walSince + par->WAL_WINDOW - 1 ) {
+		return;
+	}
+	wal->commit();
+	walSince = -1;
+	for ( auto &it : heldReplies ) {
+		emulNet->ENsend(&memberNode->addr, &it.first, (char *)it.second.data(), it.second.size());
+	}
+	heldReplies.clear();
+}
+
+void MP2Node::processReply(int id, bool success, string_view value, unsigned long long version){
 	MessageBase *messagebase;
 
 	if (msg_list.find(id) != msg_list.end()) {
@@ -384,27 +662,137 @@ void MP2Node::processReply(int id, bool success, string value){
 	if (success) { // CREATE, UPDATE or DELETE
 		messagebase->success++;
 	}
-	if (value != "") { // READ
+	// READ: a value, or the tombstone of a delete (no value, but a version)
+	if (!value.empty() || version > 0) {
 		messagebase->success++;
-		messagebase->value = value;
+		// keep the newest value, so the quorum answers with it right away
+		if (version > messagebase->version) {
+			messagebase->version = version;
+			messagebase->value = value;
+		}
 	}
 	checkQuorum(messagebase);
 }
 
 void MP2Node::checkTimeout(MessageBase *messagebase, int cur_time){
-	if ((cur_time - messagebase->currtime) > 3) {
-		messagebase->total++;
+	if ((cur_time - messagebase->currtime) > OP_TIMEOUT) {
+		// replies that have not arrived by now are counted as lost
+		messagebase->total = messagebase->replicas;
 		checkQuorum(messagebase);
 	}
 }
 
+/**
+ * FUNCTION NAME: checkpointStore
+ *
+ * DESCRIPTION: Every SNAPSHOT_INTERVAL time steps, if anything changed, write
+ * 				the hash table to a new snapshot and empty the log, so that a
+ * 				restart only replays what changed since
+ */
+void MP2Node::checkpointStore() {
+	if ( wal == NULL || par->SNAPSHOT_INTERVAL <= 0 || ht->deltaSize() == 0
+			|| par->getcurrtime() < lastCheckpoint + par->SNAPSHOT_INTERVAL ) {
+		return;
+	}
+	ht->checkpoint();
+	lastCheckpoint = par->getcurrtime();
+}
+
+/**
+ * FUNCTION NAME: nextWake
+ *
+ * DESCRIPTION: Earliest time step at which checkMessages times out an operation
+ * 				this node coordinates, commits the log, drops a partition it
+ * 				kept for the new replicas, or drops a tombstone. Replies wake
+ * 				the node up anyway.
+ *
+ * RETURNS:
+ * the time step, INT_MAX if there is none
+ */
+int MP2Node::nextWake() {
+	int wake = INT_MAX;
+
+	for ( auto &it : msg_list ) {
+		wake = min(wake, it.second->currtime + OP_TIMEOUT + 1);
+	}
+	if ( walSince >= 0 ) {
+		wake = min(wake, walSince + par->WAL_WINDOW - 1);
+	}
+	if ( wal != NULL && par->SNAPSHOT_INTERVAL > 0 && ht->deltaSize() > 0 ) {
+		wake = min(wake, lastCheckpoint + par->SNAPSHOT_INTERVAL);
+	}
+	for ( auto &it : pendingDrops ) {
+		wake = min(wake, it.second);
+	}
+	if ( !tombstones.empty() ) {
+		wake = min(wake, tombstones.front().drop);
+	}
+	return wake;
+}
+
+/**
+ * FUNCTION NAME: stamp
+ *
+ * DESCRIPTION: Next version for a write this node coordinates, from a hybrid
+ * 				logical clock: the time step in the high 32 bits, then a
+ * 				logical count that orders writes within a time step after
+ * 				those this node has seen, then the node id so that no two
+ * 				nodes hand out the same version
+ *
+ * RETURNS:
+ * the version
+ */
+unsigned long long MP2Node::stamp() {
+	int now = par->getcurrtime();
+
+	if (now > hlcTime) {
+		hlcTime = now;
+		hlcCount = 0;
+	} else if (++hlcCount >> HLC_LOGICAL_BITS) {
+		// the logical count ran out; borrow the next time step
+		hlcTime++;
+		hlcCount = 0;
+	}
+	return ((unsigned long long)hlcTime << (HLC_LOGICAL_BITS + HLC_NODE_BITS))
+			| ((unsigned long long)hlcCount << HLC_NODE_BITS)
+			| (*(int *)(memberNode->addr.addr) & ((1 << HLC_NODE_BITS) - 1));
+}
+
+/**
+ * FUNCTION NAME: observe
+ *
+ * DESCRIPTION: Move the clock past a version received from another node, so
+ * 				the writes stamped here afterwards are newer than it
+ */
+void MP2Node::observe(unsigned long long version) {
+	int time = (int)(version >> (HLC_LOGICAL_BITS + HLC_NODE_BITS));
+	int count = (int)((version >> HLC_NODE_BITS) & ((1 << HLC_LOGICAL_BITS) - 1));
+
+	if (time > hlcTime) {
+		hlcTime = time;
+		hlcCount = count;
+	} else if (time == hlcTime && count > hlcCount) {
+		hlcCount = count;
+	}
+}
+
 void MP2Node::checkQuorum(MessageBase *messagebase){
-	if (messagebase->success == 2) {
+	bool done = messagebase->success >= messagebase->need;
+
+	if (done || messagebase->total >= messagebase->replicas) {
+		opLatency.push_back(par->getcurrtime() - messagebase->currtime);
+	}
+	if (done) {
 		switch(messagebase->type) {
 			case CREATE:
 				log->logCreateSuccess(&memberNode->addr, true, messagebase->id, messagebase->key, messagebase->value);
 				break;
 			case READ:
+				// the newest reply was a delete
+				if (messagebase->value.empty()) {
+					log->logReadFail(&memberNode->addr, true, messagebase->id, messagebase->key);
+					break;
+				}
 				log->logReadSuccess(&memberNode->addr, true, messagebase->id, messagebase->key, messagebase->value);
 				break;
 			case UPDATE:
@@ -418,7 +806,7 @@ void MP2Node::checkQuorum(MessageBase *messagebase){
 		}
 		msg_list.erase(messagebase->id);
 		delete(messagebase);
-	} else if (messagebase->total == 3 && messagebase->success < 2) {
+	} else if (messagebase->total >= messagebase->replicas) {
 		switch(messagebase->type) {
 			case CREATE:
 				log->logCreateFail(&memberNode->addr, true, messagebase->id, messagebase->key, messagebase->value);
@@ -447,35 +835,30 @@ void MP2Node::checkQuorum(MessageBase *messagebase){
  * 				This function is responsible for finding the replicas of a key
  */
 vector<Node> MP2Node::findNodes(string key) {
-	size_t pos = hashFunction(key);
 	vector<Node> addr_vec;
-	if (ring.size() >= 3) {
-		// if pos <= min || pos > max, the leader is the min
-		if (pos <= ring.at(0).getHashCode() || pos > ring.at(ring.size()-1).getHashCode()) {
-			addr_vec.emplace_back(ring.at(0));
-			addr_vec.emplace_back(ring.at(1));
-			addr_vec.emplace_back(ring.at(2));
-		}
-		else {
-			// go through the ring until pos <= node
-			for (int i=1; i<ring.size(); i++){
-				Node addr = ring.at(i);
-				if (pos <= addr.getHashCode()) {
-					addr_vec.emplace_back(addr);
-					addr_vec.emplace_back(ring.at((i+1)%ring.size()));
-					addr_vec.emplace_back(ring.at((i+2)%ring.size()));
-					break;
-				}
-			}
-		}
+	const int *replicas = replicasOf(key);
+	for (int i = 0; replicas != NULL && i < ring.getReplicas(); i++) {
+		addr_vec.emplace_back(ring.at(replicas[i]));
 	}
 	return addr_vec;
 }
 
+/**
+ * FUNCTION NAME: replicasOf
+ *
+ * DESCRIPTION: Find the replicas of a key without copying them out of the ring
+ *
+ * RETURNS:
+ * their indices into ring, NULL if the ring has too few nodes (see Ring::lookup)
+ */
+const int * MP2Node::replicasOf(string_view key) {
+	return ring.lookup(hashFunction(key));
+}
+
 /**
  * FUNCTION NAME: recvLoop
  *
- * DESCRIPTION: Receive messages from EmulNet and push into the queue (mp2q)
+ * DESCRIPTION: Receive messages from the network and push into the queue (mp2q)
  */
 bool MP2Node::recvLoop() {
     if ( memberNode->bFailed ) {
@@ -509,21 +892,403 @@ void MP2Node::stabilizationProtocol() {
 	 * Implement this
 	 */
 
-	int i;
-	for(i = 0; i < ring.size(); i++){
-		if(ring.at(i).nodeAddress == memberNode->addr){
-			break;
+	if (ring.sameNodes(lastRing)) {
+		return;
+	}
+
+	// the ring is cut at the positions of both rings, into segments whose
+	// replicas are the same all along before and after; only the segments
+	// whose replicas changed are compared with the new replicas, as runs of
+	// consecutive segments that go to the same ones, and those the node is
+	// no longer a replica of dropped
+	vector<unsigned long long> cuts;
+	for (size_t i = 0; i < lastRing.size(); i++) {
+		cuts.push_back(lastRing.at(i).nodeHashCode);
+	}
+	for (size_t i = 0; i < ring.size(); i++) {
+		cuts.push_back(ring.at(i).nodeHashCode);
+	}
+	sort(cuts.begin(), cuts.end());
+	cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+
+	kv_span run;
+	bool running = false;
+	vector<Address> targets;
+	bool event = false;
+	auto compare = [&]() {
+		vector<merkle_entry> root(1);
+		vector<unsigned long long> tree;
+		if (!running) {
+			return;
+		}
+		merkle->build(run, tree);
+		memset(&root[0], 0, sizeof(merkle_entry));
+		root[0].hash = tree[0];
+		for (size_t i = 0; i < targets.size(); i++) {
+			if (!(targets[i] == memberNode->addr)) {
+				sendMerkle(&targets[i], run, 0, false, root);
+			}
+		}
+		running = false;
+	};
+	for (size_t j = 0; j < cuts.size(); j++) {
+		kv_span segment;
+		segment.lo = cuts[(j + cuts.size() - 1) % cuts.size()];
+		segment.hi = cuts[j];
+		if (!holdsKeys(segment)) {
+			continue;
+		}
+		const int *before = lastRing.lookup(segment.hi);
+		const int *after = ring.lookup(segment.hi);
+		if (after == NULL) {
+			continue;
+		}
+		bool changed = before == NULL || lastRing.getReplicas() != ring.getReplicas();
+		bool mine = false;
+		for (int i = 0; i < ring.getReplicas(); i++) {
+			changed = changed || !(lastRing.at(before[i]).nodeAddress == ring.at(after[i]).nodeAddress);
+			mine = mine || ring.at(after[i]).nodeAddress == memberNode->addr;
+		}
+		if (!changed) {
+			continue;
+		}
+		event = true;
+		// the first of the old replicas still in the ring sends it; the others
+		// have the same keys. Any node sends what it had before it knew a ring.
+		bool sender = before == NULL;
+		for (int i = 0; before != NULL && i < lastRing.getReplicas(); i++) {
+			const Address &addr = lastRing.at(before[i]).nodeAddress;
+			if (ring.contains(addr)) {
+				sender = addr == memberNode->addr;
+				break;
+			}
+		}
+		if (sender) {
+			bool same = running && segment.lo == run.hi && (int)targets.size() == ring.getReplicas();
+			for (int i = 0; same && i < ring.getReplicas(); i++) {
+				same = targets[i] == ring.at(after[i]).nodeAddress;
+			}
+			if (same) {
+				run.hi = segment.hi;
+			} else {
+				compare();
+				run = segment;
+				running = true;
+				targets.clear();
+				for (int i = 0; i < ring.getReplicas(); i++) {
+					targets.push_back(ring.at(after[i]).nodeAddress);
+				}
+			}
 		}
+		if (!mine) {
+			if (sender) {
+				// the new replicas fetch what they miss from this node
+				pendingDrops.emplace_back(segment, par->getcurrtime() + MERKLE_LINGER);
+			} else {
+				dropSpan(segment);
+			}
+		}
+	}
+	compare();
+	if (event) {
+		aeEvents++;
+	}
+	lastRing = ring;
+}
+
+/**
+ * FUNCTION NAME: holdsKeys
+ *
+ * RETURNS:
+ * false if the store has no keys in the partitions span is in
+ */
+bool MP2Node::holdsKeys(const kv_span &span) {
+	int first, count;
+
+	KVStore::partitionsOf(span, first, count);
+	for (int i = 0; i < count; i++) {
+		if (ht->partitionStats((first + i) % KV_PARTITIONS).keys > 0) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: sendMerkle
+ *
+ * DESCRIPTION: Send entries, nodes of level of the tree over span, for to to
+ * 				compare with its own, in messages of up to MERKLE_BATCH of them
+ */
+void MP2Node::sendMerkle(Address *to, const kv_span &span, int level, bool final, vector<merkle_entry> &entries) {
+	merkle_header header;
+
+	memset(&header, 0, sizeof(merkle_header));
+	header.span = span;
+	header.level = level;
+	header.final = final ? 1 : 0;
+	for (size_t i = 0; i < entries.size(); i += MERKLE_BATCH) {
+		size_t n = min(entries.size() - i, (size_t)MERKLE_BATCH);
+		Message msg(newTransID(), memberNode->addr, MERKLE, string((char *)&header, sizeof(merkle_header)),
+				string((char *)&entries[i], n * sizeof(merkle_entry)));
+		string data = msg.toBytes();
+		emulNet->ENsend(&memberNode->addr, to, (char *)data.data(), data.size());
+		aeMessages++;
+		aeBytes += data.size();
 	}
+}
 
-	vector<Node> r = {ring[(i+1) % ring.size()], ring[(i+2) % ring.size()]}; // first replica and second replica
+/**
+ * FUNCTION NAME: processMerkle
+ *
+ * DESCRIPTION: Compare the nodes of a MERKLE message with this node's tree.
+ * 				Above the leaves, the children of the nodes that differ go
+ * 				back to be compared in turn. At the leaves, the keys of the
+ * 				partitions that differ go back, and, unless the leaves came
+ * 				as the answer to this node's, this node's leaves, for the
+ * 				sender to send its keys as well.
+ */
+void MP2Node::processMerkle(Address *from, string_view key, string_view value) {
+	merkle_header header;
+	vector<unsigned long long> tree;
+	vector<merkle_entry> differ;
+	int first, count;
 
-	if (hasMyReplicas.size() < 2 ||
-		  !(r[0].nodeAddress == hasMyReplicas[0].nodeAddress &&
-			  r[1].nodeAddress == hasMyReplicas[1].nodeAddress)) {
-		for(auto& it : ht->hashTable) {
-			dispatchMsg(createMessageBase(CREATE, it.first, it.second));
+	if (key.size() != sizeof(merkle_header) || value.size() % sizeof(merkle_entry) != 0) {
+		return;
+	}
+	memcpy(&header, key.data(), sizeof(merkle_header));
+	if (header.level > MERKLE_DEPTH) {
+		return;
+	}
+	KVStore::partitionsOf(header.span, first, count);
+	merkle->build(header.span, tree);
+	size_t offset = MerkleTree::offsetOf(header.level);
+	size_t width = MerkleTree::offsetOf(header.level + 1) - offset;
+	for (size_t i = 0; i < value.size(); i += sizeof(merkle_entry)) {
+		merkle_entry entry;
+		memcpy(&entry, value.data() + i, sizeof(merkle_entry));
+		if (entry.index < width && entry.hash != tree[offset + entry.index]) {
+			entry.hash = tree[offset + entry.index];
+			differ.push_back(entry);
 		}
-		hasMyReplicas = r;
 	}
+	if (differ.empty()) {
+		return;
+	}
+
+	if (header.level < MERKLE_DEPTH) {
+		size_t childOffset = MerkleTree::offsetOf(header.level + 1);
+		vector<merkle_entry> children;
+		for (auto &it : differ) {
+			for (int c = 0; c < MERKLE_FANOUT; c++) {
+				merkle_entry child;
+				memset(&child, 0, sizeof(merkle_entry));
+				child.index = it.index * MERKLE_FANOUT + c;
+				if (MerkleTree::overlaps(header.level + 1, child.index, first, count)) {
+					child.hash = tree[childOffset + child.index];
+					children.push_back(child);
+				}
+			}
+		}
+		sendMerkle(from, header.span, header.level + 1, false, children);
+		return;
+	}
+	for (auto &it : differ) {
+		sendRepair(from, it.index, header.span);
+	}
+	if (!header.final) {
+		sendMerkle(from, header.span, MERKLE_DEPTH, true, differ);
+	}
+}
+
+/**
+ * FUNCTION NAME: sendRepair
+ *
+ * DESCRIPTION: Send the keys of partition in span to to, tombstones included,
+ * 				with the versions they were written with, so they cannot
+ * 				override newer writes there. Nothing goes to a node that is
+ * 				not a replica of the key.
+ */
+void MP2Node::sendRepair(Address *to, int partition, const kv_span &span) {
+	ht->forEachIn(partition, [&](string_view key, string_view record) {
+		const int *replicas;
+		int i;
+
+		if (!KVStore::inSpan(KVStore::tokenOf(key), span) || (replicas = replicasOf(key)) == NULL) {
+			return;
+		}
+		for (i = 0; i < ring.getReplicas() && !(ring.at(replicas[i]).nodeAddress == *to); i++);
+		if (i == ring.getReplicas()) {
+			return;
+		}
+		sendEntry(to, key, record, i);
+	});
+}
+
+/**
+ * FUNCTION NAME: sendEntry
+ *
+ * DESCRIPTION: Send the entry of key, live or a tombstone, to replica number
+ * 				replica of the key in a REPAIR
+ */
+void MP2Node::sendEntry(Address *to, string_view key, string_view record, int replica) {
+	Entry entry(record);
+	Message msg(newTransID(), memberNode->addr, REPAIR, string(key), entry.value, replica);
+	msg.timestamp = entry.timestamp;
+	msg.success = entry.tombstone;
+	string data = msg.toBytes();
+	emulNet->ENsend(&memberNode->addr, to, (char *)data.data(), data.size());
+	aeMessages++;
+	aeBytes += data.size();
+}
+
+/**
+ * FUNCTION NAME: repairTombstone
+ *
+ * DESCRIPTION: Apply the tombstone of a delete another replica sent, unless the
+ * 				entry here is as new. One whose grace is over only removes
+ * 				the older entry; it is not kept again.
+ */
+void MP2Node::repairTombstone(string_view key, int replica, unsigned long long version) {
+	string_view stored, storedValue;
+	unsigned long long storedVersion;
+
+	observe(version);
+	stored = ht->read(key);
+	Entry::view(stored, storedValue, storedVersion);
+	if (!stored.empty() && version <= storedVersion) {
+		return;
+	}
+	if (tombstoneDrop(version) <= par->getcurrtime()) {
+		if (!stored.empty()) {
+			merkle->change(key, stored, "");
+			ht->deleteKey(key);
+		}
+		return;
+	}
+	Entry::encode(record, "", version, replica, ENTRY_TOMBSTONE);
+	merkle->change(key, stored, record);
+	if (stored.empty()) {
+		ht->create(key, record);
+	} else {
+		ht->update(key, record);
+	}
+	tombstones.push_back(Tombstone{tombstoneDrop(version), string(key), version});
+}
+
+/**
+ * FUNCTION NAME: dropSpan
+ *
+ * DESCRIPTION: Remove the keys in span, that the node is no longer a replica of
+ */
+void MP2Node::dropSpan(const kv_span &span) {
+	int first, count;
+	vector<string> keys;
+
+	KVStore::partitionsOf(span, first, count);
+	for (int i = 0; i < count; i++) {
+		int partition = (first + i) % KV_PARTITIONS;
+		if (KVStore::covers(span, partition)) {
+			ht->dropPartition(partition);
+			merkle->clear(partition);
+			continue;
+		}
+		keys.clear();
+		ht->forEachIn(partition, [&](string_view key, string_view record) {
+			if (KVStore::inSpan(KVStore::tokenOf(key), span)) {
+				keys.emplace_back(key);
+			}
+		});
+		for (auto &key : keys) {
+			merkle->change(key, ht->read(key), "");
+			ht->deleteKey(key);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: dropLingering
+ *
+ * DESCRIPTION: Drop the spans kept for the new replicas whose time is up,
+ * 				except where the ring made the node a replica again
+ */
+void MP2Node::dropLingering() {
+	for (auto it = pendingDrops.begin(); it != pendingDrops.end(); ) {
+		if (it->second > par->getcurrtime()) {
+			++it;
+			continue;
+		}
+		// cut the span where the replicas change, at the positions in it
+		kv_span span = it->first;
+		vector<unsigned long long> cuts;
+		for (size_t i = 0; i < ring.size(); i++) {
+			unsigned long long token = ring.at(i).nodeHashCode;
+			if (KVStore::inSpan(token, span) && token != span.hi) {
+				cuts.push_back(token - span.lo - 1);
+			}
+		}
+		sort(cuts.begin(), cuts.end());
+		cuts.erase(unique(cuts.begin(), cuts.end()), cuts.end());
+		cuts.push_back(span.hi - span.lo - 1);
+		kv_span piece;
+		piece.lo = span.lo;
+		for (auto &cut : cuts) {
+			piece.hi = span.lo + 1 + cut;
+			const int *replicas = ring.lookup(piece.hi);
+			bool mine = false;
+			for (int i = 0; replicas != NULL && i < ring.getReplicas(); i++) {
+				mine = mine || ring.at(replicas[i]).nodeAddress == memberNode->addr;
+			}
+			if (!mine && replicas != NULL) {
+				dropSpan(piece);
+			}
+			piece.lo = piece.hi;
+		}
+		it = pendingDrops.erase(it);
+	}
+}
+
+/**
+ * FUNCTION NAME: dropTombstones
+ *
+ * DESCRIPTION: Remove the tombstones of deletes made TOMBSTONE_GRACE time
+ * 				steps ago. Each goes to the other replicas of its key first,
+ * 				a last repair for any that missed the delete; they only drop
+ * 				their older entry. A key written again since keeps its entry;
+ * 				one deleted again waits for the newer tombstone.
+ */
+void MP2Node::dropTombstones() {
+	int now = par->getcurrtime();
+
+	while (!tombstones.empty() && tombstones.front().drop <= now) {
+		Tombstone &it = tombstones.front();
+		string_view stored = ht->read(it.key);
+		string_view value;
+		unsigned long long version;
+
+		Entry::view(stored, value, version);
+		if (Entry::isTombstone(stored) && version == it.version) {
+			const int *replicas = replicasOf(it.key);
+			for (int i = 0; replicas != NULL && i < ring.getReplicas(); i++) {
+				Address to = ring.at(replicas[i]).nodeAddress;
+				if (!(to == memberNode->addr)) {
+					sendEntry(&to, it.key, stored, i);
+				}
+			}
+			merkle->change(it.key, stored, "");
+			ht->deleteKey(it.key);
+		}
+		tombstones.pop_front();
+	}
+}
+
+/**
+ * FUNCTION NAME: tombstoneDrop
+ *
+ * RETURNS:
+ * the time step to drop the tombstone of a delete made at version at
+ */
+int MP2Node::tombstoneDrop(unsigned long long version) {
+	return (int)(version >> (HLC_LOGICAL_BITS + HLC_NODE_BITS)) + TOMBSTONE_GRACE;
 }
@@ -11,19 +11,47 @@
  * Header files
  */
 #include "stdincludes.h"
-#include "EmulNet.h"
+#include "Transport.h"
 #include "Node.h"
 #include "HashTable.h"
+#include "LsmTree.h"
+#include "MerkleTree.h"
 #include "Log.h"
 #include "Params.h"
 #include "Message.h"
 #include "Queue.h"
+#include "Ring.h"
 #include <unordered_map>
+#include <deque>
+
+/**
+ * Macros
+ */
+// time after which the replies still missing for an operation count as lost
+#define OP_TIMEOUT 3
+// bits of a version below the physical time: the logical counter, then the node id
+#define HLC_LOGICAL_BITS 16
+#define HLC_NODE_BITS 16
+// time a node keeps the partitions it is no longer a replica of, for the new replicas to compare with
+#define MERKLE_LINGER 20
+// time a delete leaves its tombstone for, longer than MERKLE_LINGER so that repair after a ring change still ships it
+#define TOMBSTONE_GRACE 50
 
 struct MessageBase {
 	int id, total, success, currtime;
+	// replicas the operation went to, and successful replies it waits for
+	int replicas, need;
 	MessageType type;
 	string key, value;
+	// version of a write; for a READ, that of the newest value replied so far
+	unsigned long long version;
+};
+
+// a tombstone a delete left on key, and the time step to drop it at
+struct Tombstone {
+	int drop;
+	string key;
+	unsigned long long version;
 };
 /**
  * CLASS NAME: MP2Node
@@ -42,30 +70,93 @@ private:
 	// Vector holding the previous two neighbors in the ring whose replicas I have
 	vector<Node> haveReplicasOf;
 	// Ring
-	vector<Node> ring;
-	// Hash Table
-	HashTable * ht;
+	Ring ring;
+	// members as the membership protocol reports their joins and leaves, in ring order
+	set<Node, RingOrder> ringNodes;
+	// membership epoch (see Member::memberEpoch) ring was built at
+	unsigned long ringEpoch;
+	// Ring as of the last stabilization
+	Ring lastRing;
+	// Hash Table: the local store, a HashTable or an LsmTree (see Params::STORAGE)
+	KVStore * ht;
 	// Member representing this member
 	Member *memberNode;
 	// Params object
 	Params *par;
-	// Object of EmulNet
-	EmulNet * emulNet;
+	// Network the node is attached to
+	Transport * emulNet;
 	// Object of Log
 	Log * log;
 	// after receiving replies, check majority
 	unordered_map<int, MessageBase*> msg_list;
+	// transactions started by this node; see createMessageBase
+	int transCount;
+	// time taken by every coordinated operation that completed
+	vector<int> opLatency;
+	// replies are serialized here, so the buffer is only allocated once
+	string reply;
+	// entries are encoded here before going into the hash table
+	string record;
+	// log of the hash table, NULL when there is none (see Params::WAL_DIR)
+	WriteAheadLog *wal;
+	// time step of the oldest write not yet committed, -1 if none
+	int walSince;
+	// replies to writes, held until the writes are committed
+	vector<pair<Address, string> > heldReplies;
+	// time step of the last snapshot of the hash table
+	int lastCheckpoint;
+	// hybrid logical clock: largest physical time seen, and the logical count within it
+	int hlcTime;
+	int hlcCount;
+	// hashes of the hash table, compared with the other replicas on ring changes
+	MerkleTree *merkle;
+	// spans of the ring to drop once the new replicas had time to compare, and when
+	vector<pair<kv_span, int> > pendingDrops;
+	// tombstones to drop, in the order they were written here
+	deque<Tombstone> tombstones;
+	// ring changes that had this node compare partitions, and the MERKLE and REPAIR traffic it sent
+	unsigned long aeEvents;
+	unsigned long aeMessages;
+	unsigned long long aeBytes;
+	// CREATE, READ, UPDATE and DELETE requests this node served as a replica
+	unsigned long served;
 
 public:
-	MP2Node(Member *memberNode, Params *par, EmulNet *emulNet, Log *log, Address *addressOfMember);
+	MP2Node(Member *memberNode, Params *par, Transport *emulNet, Log *log, Address *addressOfMember);
 	Member * getMemberNode() {
 		return this->memberNode;
 	}
+	vector<int> * getOpLatency() {
+		return &this->opLatency;
+	}
+	WriteAheadLog * getWal() {
+		return this->wal;
+	}
+	KVStore * getStore() {
+		return this->ht;
+	}
+	unsigned long getAeEvents() {
+		return this->aeEvents;
+	}
+	unsigned long getAeMessages() {
+		return this->aeMessages;
+	}
+	unsigned long long getAeBytes() {
+		return this->aeBytes;
+	}
+	unsigned long getServed() {
+		return this->served;
+	}
+	const Ring & getRing() {
+		return this->ring;
+	}
 
 	// ring functionalities
 	void updateRing();
 	vector<Node> getMembershipList();
-	size_t hashFunction(string key);
+	static void memberChangedWrapper(void *env, Address *addr, bool joined);
+	void memberChanged(Address *addr, bool joined);
+	size_t hashFunction(string_view key);
 	void findNeighbors();
 
 	// client side CRUD APIs
@@ -73,6 +164,11 @@ public:
 	void clientRead(string key);
 	void clientUpdate(string key, string value);
 	void clientDelete(string key);
+	// the same, at a consistency level of their own (see Params::READ_CONSISTENCY)
+	void clientCreate(string key, string value, consistencyLEVEL level);
+	void clientRead(string key, consistencyLEVEL level);
+	void clientUpdate(string key, string value, consistencyLEVEL level);
+	void clientDelete(string key, consistencyLEVEL level);
 
 	// receive messages from Emulnet
 	bool recvLoop();
@@ -80,26 +176,48 @@ public:
 
 	// handle messages from receiving queue
 	void checkMessages();
+	void sendWriteReply(Address *to);
+	void commitLog();
+	void checkpointStore();
 
 	// coordinator dispatches messages to corresponding nodes
-	MessageBase* createMessageBase(MessageType, string, string);
+	int newTransID();
+	MessageBase* createMessageBase(MessageType, string, string, consistencyLEVEL);
 	void dispatchMsg(MessageBase*);
-	void processReply(int, bool, string);
+	void processReply(int, bool, string_view, unsigned long long);
 	void checkTimeout(MessageBase*, int);
 	void checkQuorum(MessageBase*);
+	int nextWake();
+
+	// hybrid logical clock versioning the writes this node coordinates
+	unsigned long long stamp();
+	void observe(unsigned long long version);
 
 	// find the addresses of nodes that are responsible for a key
 	vector<Node> findNodes(string key);
+	const int * replicasOf(string_view key);
 
 	// server
-	bool createKeyValue(int, string, string, ReplicaType);
-	string readKey(int, string key);
-	bool updateKeyValue(int, string, string, ReplicaType);
-	bool deleteKey(int, string);
+	bool createKeyValue(int, string_view, string_view, int, unsigned long long);
+	string_view readKey(int, string_view key, unsigned long long &version);
+	bool updateKeyValue(int, string_view, string_view, int, unsigned long long);
+	bool deleteKey(int, string_view, int, unsigned long long);
+	void dropTombstones();
+	int tombstoneDrop(unsigned long long version);
 
 	// stabilization protocol - handle multiple failures
 	void stabilizationProtocol();
 
+	// anti-entropy: replicas compare hash trees of a span of the ring, then send the keys of the partitions that differ
+	bool holdsKeys(const kv_span &span);
+	void sendMerkle(Address *to, const kv_span &span, int level, bool final, vector<merkle_entry> &entries);
+	void processMerkle(Address *from, string_view key, string_view value);
+	void sendRepair(Address *to, int partition, const kv_span &span);
+	void sendEntry(Address *to, string_view key, string_view record, int replica);
+	void repairTombstone(string_view key, int replica, unsigned long long version);
+	void dropSpan(const kv_span &span);
+	void dropLingering();
+
 	~MP2Node();
 };
 
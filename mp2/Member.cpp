@@ -31,7 +31,7 @@ Address& Address::operator =(const Address& anotherAddress) {
 /**
  * Compare two Address objects
  */
-bool Address::operator ==(const Address& anotherAddress) {
+bool Address::operator ==(const Address& anotherAddress) const {
 	return !memcmp(this->addr, anotherAddress.addr, sizeof(this->addr));
 }
 
@@ -152,6 +152,9 @@ Member::Member(const Member &anotherMember) {
 	this->pingCounter = anotherMember.pingCounter;
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
+	this->memberEpoch = anotherMember.memberEpoch;
+	this->memberChanged = anotherMember.memberChanged;
+	this->memberChangedEnv = anotherMember.memberChangedEnv;
 	this->myPos = anotherMember.myPos;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
@@ -170,6 +173,9 @@ Member& Member::operator =(const Member& anotherMember) {
 	this->pingCounter = anotherMember.pingCounter;
 	this->timeOutCounter = anotherMember.timeOutCounter;
 	this->memberList = anotherMember.memberList;
+	this->memberEpoch = anotherMember.memberEpoch;
+	this->memberChanged = anotherMember.memberChanged;
+	this->memberChangedEnv = anotherMember.memberChangedEnv;
 	this->myPos = anotherMember.myPos;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
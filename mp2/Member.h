@@ -34,7 +34,7 @@ public:
 	Address(const Address &anotherAddress);
 	 // Overloaded = operator
 	Address& operator =(const Address &anotherAddress);
-	bool operator ==(const Address &anotherAddress);
+	bool operator ==(const Address &anotherAddress) const;
 	Address(string address) {
 		size_t pos = address.find(":");
 		int id = stoi(address.substr(0, pos));
@@ -106,6 +106,11 @@ public:
 	int timeOutCounter;
 	// Membership table
 	vector<MemberListEntry> memberList;
+	// version of the membership table, moved on by every join and leave
+	unsigned long memberEpoch;
+	// called with env on every join and leave, if set
+	void (*memberChanged)(void *env, Address *addr, bool joined);
+	void *memberChangedEnv;
 	// My position in the membership table
 	vector<MemberListEntry>::iterator myPos;
 	// Queue for failure detection messages
@@ -115,7 +120,8 @@ public:
 	/**
 	 * Constructor
 	 */
-	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), pingCounter(0), timeOutCounter(0) {}
+	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), pingCounter(0), timeOutCounter(0),
+			memberEpoch(0), memberChanged(NULL), memberChangedEnv(NULL) {}
 	// copy constructor
 	Member(const Member &anotherMember);
 	// Assignment operator overloading
@@ -0,0 +1,195 @@
+/**********************************
+ * FILE NAME: MerkleTree.cpp
+ *
+ * DESCRIPTION: Definition of the hash trees replicas compare their keys with
+ **********************************/
+
+#include "MerkleTree.h"
+
+/**
+ * Constructor
+ */
+MerkleTree::MerkleTree(KVStore *store) {
+	this->store = store;
+	memset(leaves, 0, sizeof(leaves));
+	memset(known, 0, sizeof(known));
+}
+
+/**
+ * FUNCTION NAME: mix
+ *
+ * DESCRIPTION: Finalizer of MurmurHash3; 0 stays 0, so empty subtrees hash alike
+ */
+unsigned long long MerkleTree::mix(unsigned long long h) {
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+/**
+ * FUNCTION NAME: entryHash
+ *
+ * DESCRIPTION: Hash of key with record, an Entry as the store keeps it. A
+ * 				tombstone hashes apart from a live entry, so replicas where a
+ * 				delete is missing differ.
+ */
+unsigned long long MerkleTree::entryHash(string_view key, string_view record) {
+	string_view value;
+	unsigned long long timestamp;
+
+	Entry::view(record, value, timestamp);
+	unsigned long long h = hash<string_view>()(value) ^ timestamp;
+	if ( Entry::isTombstone(record) ) {
+		h = ~h;
+	}
+	return mix(hash<string_view>()(key) ^ mix(h));
+}
+
+/**
+ * FUNCTION NAME: inRange
+ *
+ * RETURNS:
+ * true if partition is one of first to first + count - 1, around the ring
+ */
+bool MerkleTree::inRange(int partition, int first, int count) {
+	return (partition - first + KV_PARTITIONS) % KV_PARTITIONS < count;
+}
+
+/**
+ * FUNCTION NAME: offsetOf
+ *
+ * DESCRIPTION: Where the nodes of level start in the output of build
+ */
+size_t MerkleTree::offsetOf(int level) {
+	size_t offset = 0, width = 1;
+
+	for ( int i = 0; i < level; i++, width *= MERKLE_FANOUT ) {
+		offset += width;
+	}
+	return offset;
+}
+
+/**
+ * FUNCTION NAME: spanOf
+ *
+ * DESCRIPTION: Partitions under a node of level
+ */
+int MerkleTree::spanOf(int level) {
+	int span = 1;
+
+	for ( int i = level; i < MERKLE_DEPTH; i++ ) {
+		span *= MERKLE_FANOUT;
+	}
+	return span;
+}
+
+/**
+ * FUNCTION NAME: overlaps
+ *
+ * RETURNS:
+ * true if node index of level is over one of partitions first to first + count - 1
+ */
+bool MerkleTree::overlaps(int level, int index, int first, int count) {
+	int span = spanOf(level), start = index * span;
+
+	return inRange(start, first, count) || inRange(first, start, span);
+}
+
+/**
+ * FUNCTION NAME: change
+ *
+ * DESCRIPTION: Account for the entry of key going from oldRecord to newRecord;
+ * 				an empty record is no entry
+ */
+void MerkleTree::change(string_view key, string_view oldRecord, string_view newRecord) {
+	int partition = KVStore::partitionOf(key);
+
+	if ( !known[partition] ) {
+		return;
+	}
+	if ( !oldRecord.empty() ) {
+		leaves[partition] ^= entryHash(key, oldRecord);
+	}
+	if ( !newRecord.empty() ) {
+		leaves[partition] ^= entryHash(key, newRecord);
+	}
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: The store dropped partition
+ */
+void MerkleTree::clear(int partition) {
+	leaves[partition] = 0;
+	known[partition] = true;
+}
+
+/**
+ * FUNCTION NAME: leaf
+ *
+ * RETURNS:
+ * hash of partition, read from the store the first time
+ */
+unsigned long long MerkleTree::leaf(int partition) {
+	if ( !known[partition] ) {
+		unsigned long long h = 0;
+		store->forEachIn(partition, [&](string_view key, string_view record) {
+			h ^= entryHash(key, record);
+		});
+		leaves[partition] = h;
+		known[partition] = true;
+	}
+	return leaves[partition];
+}
+
+/**
+ * FUNCTION NAME: leaf
+ *
+ * RETURNS:
+ * hash of the keys of partition in span
+ */
+unsigned long long MerkleTree::leaf(int partition, const kv_span &span) {
+	unsigned long long h = 0;
+
+	if ( KVStore::covers(span, partition) ) {
+		return leaf(partition);
+	}
+	store->forEachIn(partition, [&](string_view key, string_view record) {
+		if ( KVStore::inSpan(KVStore::tokenOf(key), span) ) {
+			h ^= entryHash(key, record);
+		}
+	});
+	return h;
+}
+
+/**
+ * FUNCTION NAME: build
+ *
+ * DESCRIPTION: The tree over span, level by level from the root (see offsetOf)
+ */
+void MerkleTree::build(const kv_span &span, vector<unsigned long long> &tree) {
+	size_t leafOffset = offsetOf(MERKLE_DEPTH);
+	int first, count;
+
+	KVStore::partitionsOf(span, first, count);
+	tree.assign(offsetOf(MERKLE_DEPTH + 1), 0);
+	for ( int i = 0; i < KV_PARTITIONS; i++ ) {
+		if ( inRange(i, first, count) ) {
+			tree[leafOffset + i] = leaf(i, span);
+		}
+	}
+	for ( int level = MERKLE_DEPTH - 1; level >= 0; level-- ) {
+		size_t offset = offsetOf(level), childOffset = offsetOf(level + 1);
+		for ( size_t i = 0; offset + i < childOffset; i++ ) {
+			unsigned long long h = 0;
+			for ( int c = 0; c < MERKLE_FANOUT; c++ ) {
+				h = mix(h ^ tree[childOffset + i * MERKLE_FANOUT + c]);
+			}
+			tree[offset + i] = h;
+		}
+	}
+}
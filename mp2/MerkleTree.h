@@ -0,0 +1,83 @@
+/**********************************
+ * FILE NAME: MerkleTree.h
+ *
+ * DESCRIPTION: Header file of the hash trees replicas compare their keys with
+ **********************************/
+
+#ifndef _MERKLETREE_H_
+#define _MERKLETREE_H_
+
+#include "stdincludes.h"
+#include "KVStore.h"
+#include "Entry.h"
+
+/*
+ * Macros
+ */
+// children of an inner node
+#define MERKLE_FANOUT 8
+// levels below the root; the leaves, at this level, are the partitions of the store
+#define MERKLE_DEPTH 3
+// most nodes in one MERKLE message, so it stays well within Params::MAX_MSG_SIZE
+#define MERKLE_BATCH 128
+
+/**
+ * Struct Name: merkle_header
+ *
+ * DESCRIPTION: Key of a MERKLE message: the span of the ring compared, and the
+ * 				level of the nodes in the value. final is set on the leaves
+ * 				sent back by the side that compared them first.
+ */
+typedef struct merkle_header {
+	kv_span span;
+	unsigned char level;
+	unsigned char final;
+	char pad[6];
+}merkle_header;
+
+/**
+ * Struct Name: merkle_entry
+ *
+ * DESCRIPTION: A node of the tree in the value of a MERKLE message
+ */
+typedef struct merkle_entry {
+	unsigned long long hash;
+	unsigned int index;
+	unsigned int pad;
+}merkle_entry;
+
+/**
+ * CLASS NAME: MerkleTree
+ *
+ * DESCRIPTION: Hashes of a node's store. The hash of a partition is the XOR
+ * 				of the hashes of its entries, so a write changes it in O(1);
+ * 				it is only computed from the store the first time it is
+ * 				needed. The tree over a span of the ring is built from them
+ * 				when two replicas compare it: an inner node hashes its
+ * 				MERKLE_FANOUT children, and partitions out of the span count
+ * 				as empty. A partition the span only takes part of is hashed
+ * 				from the store, over the keys in the span. An entry's hash covers its key, value and version,
+ * 				not the replica type, which differs from replica to replica.
+ */
+class MerkleTree {
+private:
+	KVStore *store;
+	unsigned long long leaves[KV_PARTITIONS];
+	bool known[KV_PARTITIONS];
+	static unsigned long long mix(unsigned long long h);
+
+public:
+	MerkleTree(KVStore *store);
+	static unsigned long long entryHash(string_view key, string_view record);
+	static bool inRange(int partition, int first, int count);
+	static size_t offsetOf(int level);
+	static int spanOf(int level);
+	static bool overlaps(int level, int index, int first, int count);
+	void change(string_view key, string_view oldRecord, string_view newRecord);
+	void clear(int partition);
+	unsigned long long leaf(int partition);
+	unsigned long long leaf(int partition, const kv_span &span);
+	void build(const kv_span &span, vector<unsigned long long> &tree);
+};
+
+#endif /* _MERKLETREE_H_ */
@@ -14,8 +14,12 @@
 // transID::fromAddr::DELETE::key
 // transID::fromAddr::REPLY::sucess
 // transID::fromAddr::READREPLY::value
+// transID::fromAddr::MERKLE::key::value
+// transID::fromAddr::REPAIR::key::value::ReplicaType
 Message::Message(string message){
 	this->delimiter = "::";
+	this->valid = true;
+	this->timestamp = 0;
 	vector<string> tuple;
 	size_t pos = message.find(delimiter);
 	size_t start = 0;
@@ -34,10 +38,11 @@ Message::Message(string message){
 	switch(type){
 		case CREATE:
 		case UPDATE:
+		case REPAIR:
 			key = tuple.at(3);
 			value = tuple.at(4);
 			if (tuple.size() > 5)
-				replica = static_cast<ReplicaType>(stoi(tuple.at(5)));
+				replica = stoi(tuple.at(5));
 			break;
 		case READ:
 		case DELETE:
@@ -52,21 +57,47 @@ Message::Message(string message){
 		case READREPLY:
 			value = tuple.at(3);
 			break;
+		case MERKLE:
+			key = tuple.at(3);
+			value = tuple.at(4);
+			break;
 	}
 }
 
+/**
+ * Constructor
+ */
+// construct a message from the binary format written by toBytes()
+Message::Message(const char *data, int size){
+	MessageView view(data, size);
+
+	this->delimiter = "::";
+	this->valid = view.valid;
+	this->transID = view.transID;
+	this->fromAddr = view.fromAddr;
+	this->type = view.type;
+	this->replica = view.replica;
+	this->success = view.success;
+	this->timestamp = view.timestamp;
+	this->key = string(view.key);
+	this->value = string(view.value);
+}
+
 /**
  * Constructor
  */
 // construct a create or update message
-Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica){
+Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, int _replica){
 	this->delimiter = "::";
+	this->valid = true;
+	this->timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
 	key = _key;
 	value = _value;
 	replica = _replica;
+	success = false;
 }
 
 /**
@@ -74,10 +105,12 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
  */
 Message::Message(const Message& anotherMessage) {
 	this->delimiter = anotherMessage.delimiter;
+	this->valid = anotherMessage.valid;
 	this->fromAddr = anotherMessage.fromAddr;
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
+	this->timestamp = anotherMessage.timestamp;
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
@@ -88,6 +121,8 @@ Message::Message(const Message& anotherMessage) {
  */
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value){
 	this->delimiter = "::";
+	this->valid = true;
+	this->timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -101,6 +136,8 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct a read or delete message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key){
 	this->delimiter = "::";
+	this->valid = true;
+	this->timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -113,6 +150,8 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, string _key
 // construct reply message
 Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _success){
 	this->delimiter = "::";
+	this->valid = true;
+	this->timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = _type;
@@ -125,6 +164,8 @@ Message::Message(int _transID, Address _fromAddr, MessageType _type, bool _succe
 // construct read reply message
 Message::Message(int _transID, Address _fromAddr, string _value){
 	this->delimiter = "::";
+	this->valid = true;
+	this->timestamp = 0;
 	transID = _transID;
 	fromAddr = _fromAddr;
 	type = READREPLY;
@@ -141,6 +182,7 @@ string Message::toString(){
 	switch(type){
 		case CREATE:
 		case UPDATE:
+		case REPAIR:
 			message += key + delimiter + value + delimiter + to_string(replica);
 			break;
 		case READ:
@@ -156,21 +198,167 @@ string Message::toString(){
 		case READREPLY:
 			message += value;
 			break;
+		case MERKLE:
+			message += key + delimiter + value;
+			break;
+	}
+	return message;
+}
+
+/**
+ * FUNCTION NAME: toBytes
+ *
+ * DESCRIPTION: Serialized Message in the binary format: a msg_header, then the
+ * 				key and the value as they are, so they may hold any byte
+ */
+string Message::toBytes(){
+	msg_header header;
+	string message;
+
+	memset(&header, 0, sizeof(msg_header));
+	header.version = MSG_VERSION;
+	header.type = type;
+	header.transID = transID;
+	memcpy(header.fromAddr, fromAddr.addr, sizeof(header.fromAddr));
+	switch(type){
+		case CREATE:
+		case UPDATE:
+		case DELETE:
+			header.replica = replica;
+			header.keylen = key.size();
+			header.valuelen = value.size();
+			header.timestamp = timestamp;
+			break;
+		case REPAIR:
+			// success marks the tombstone of a delete (see Entry)
+			header.success = success ? 1 : 0;
+			header.replica = replica;
+			header.keylen = key.size();
+			header.valuelen = value.size();
+			header.timestamp = timestamp;
+			break;
+		case READ:
+			header.keylen = key.size();
+			break;
+		case REPLY:
+			header.success = success ? 1 : 0;
+			break;
+		case READREPLY:
+			header.valuelen = value.size();
+			header.timestamp = timestamp;
+			break;
+		case MERKLE:
+			header.keylen = key.size();
+			header.valuelen = value.size();
+			break;
 	}
+	message.reserve(sizeof(msg_header) + header.keylen + header.valuelen);
+	message.append((char *)&header, sizeof(msg_header));
+	message.append(key.data(), header.keylen);
+	message.append(value.data(), header.valuelen);
 	return message;
 }
 
+/**
+ * FUNCTION NAME: encodeReply
+ *
+ * DESCRIPTION: Write a reply in the binary format into out without building a
+ * 				Message. out keeps its capacity, so a buffer reused for every
+ * 				reply stops allocating once it is large enough.
+ */
+void Message::encodeReply(string &out, int transID, Address &fromAddr, MessageType type, bool success, string_view value, unsigned long long timestamp) {
+	msg_header header;
+
+	memset(&header, 0, sizeof(msg_header));
+	header.version = MSG_VERSION;
+	header.type = type;
+	header.transID = transID;
+	memcpy(header.fromAddr, fromAddr.addr, sizeof(header.fromAddr));
+	if ( type == READREPLY ) {
+		header.valuelen = value.size();
+		header.timestamp = timestamp;
+	}
+	else {
+		header.success = success ? 1 : 0;
+	}
+	out.clear();
+	out.append((char *)&header, sizeof(msg_header));
+	out.append(value.data(), header.valuelen);
+}
+
+/**
+ * FUNCTION NAME: replicaOffset
+ *
+ * DESCRIPTION: Position of the replica type in the output of toBytes(), so a
+ * 				message serialized once can be sent to every replica with only
+ * 				that field rewritten (see replicaBytes)
+ *
+ * RETURNS:
+ * offset of the field, -1 if messages of this type carry no replica type
+ */
+int Message::replicaOffset(string &serialized, MessageType type) {
+	if ( type == CREATE || type == UPDATE || type == DELETE || type == REPAIR ) {
+		return offsetof(msg_header, replica);
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: replicaBytes
+ *
+ * DESCRIPTION: The replica type field as toBytes() writes it
+ */
+string Message::replicaBytes(int replica) {
+	return string(1, (char)replica);
+}
+
 /**
  * Assignment operator overloading
  */
 Message& Message::operator =(const Message& anotherMessage) {
 	this->delimiter = anotherMessage.delimiter;
+	this->valid = anotherMessage.valid;
 	this->fromAddr = anotherMessage.fromAddr;
 	this->key = anotherMessage.key;
 	this->replica = anotherMessage.replica;
 	this->success = anotherMessage.success;
+	this->timestamp = anotherMessage.timestamp;
 	this->transID = anotherMessage.transID;
 	this->type = anotherMessage.type;
 	this->value = anotherMessage.value;
 	return *this;
 }
+
+/**
+ * Constructor
+ */
+// parse the binary format written by Message::toBytes() in place
+MessageView::MessageView(const char *data, int size){
+	msg_header header;
+
+	valid = false;
+	transID = 0;
+	type = REPLY;
+	replica = PRIMARY;
+	success = false;
+	timestamp = 0;
+	if ( size < (int)sizeof(msg_header) ) {
+		return;
+	}
+	memcpy(&header, data, sizeof(msg_header));
+	if ( header.version != MSG_VERSION || header.type > REPAIR || header.replica >= MAX_REPLICAS
+			|| header.keylen > size - sizeof(msg_header)
+			|| header.valuelen > size - sizeof(msg_header) - header.keylen ) {
+		return;
+	}
+	transID = header.transID;
+	memcpy(fromAddr.addr, header.fromAddr, sizeof(fromAddr.addr));
+	type = static_cast<MessageType>(header.type);
+	replica = header.replica;
+	success = header.success != 0;
+	timestamp = header.timestamp;
+	data += sizeof(msg_header);
+	key = string_view(data, header.keylen);
+	value = string_view(data + header.keylen, header.valuelen);
+	valid = true;
+}
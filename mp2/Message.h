@@ -10,6 +10,33 @@
 #include "Member.h"
 #include "common.h"
 
+/**
+ * Macros
+ */
+// first byte of every message in the binary format
+#define MSG_VERSION 2
+
+/**
+ * Struct Name: msg_header
+ *
+ * DESCRIPTION: Fixed part of a message in the binary format, followed by keylen
+ * 				bytes of key and valuelen bytes of value. Fields are in host
+ * 				byte order, every node runs on the same machine.
+ */
+typedef struct msg_header {
+	unsigned char version;
+	unsigned char type;
+	unsigned char replica;
+	unsigned char success;
+	int transID;
+	char fromAddr[6];
+	char pad[2];
+	unsigned int keylen;
+	unsigned int valuelen;
+	// version of the value a CREATE, UPDATE, REPAIR or READREPLY carries, or of a DELETE
+	unsigned long long timestamp;
+}msg_header;
+
 /**
  * CLASS NAME: Message
  *
@@ -18,20 +45,26 @@
 class Message{
 public:
 	MessageType type;
-	ReplicaType replica;
+	int replica;
 	string key;
 	string value;
 	Address fromAddr;
 	int transID;
 	bool success; // success or not 
+	// version of the value, see msg_header
+	unsigned long long timestamp;
+	// false if the bytes a message was decoded from were not one
+	bool valid;
 	// delimiter
 	string delimiter;
 	// construct a message from a string
 	Message(string message);
+	// construct a message from the binary format
+	Message(const char *data, int size);
 	Message(const Message& anotherMessage);
 	// construct a create or update message
 	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value);
-	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, ReplicaType _replica);
+	Message(int _transID, Address _fromAddr, MessageType _type, string _key, string _value, int _replica);
 	// construct a read or delete message
 	Message(int _transID, Address _fromAddr, MessageType _type, string _key);
 	// construct reply message
@@ -41,6 +74,34 @@ public:
 	Message& operator = (const Message& anotherMessage);
 	// serialize to a string
 	string toString();
+	// serialize to the binary format
+	string toBytes();
+	// where a message in the binary format keeps its replica type, to retarget it to another replica
+	static int replicaOffset(string &serialized, MessageType type);
+	static string replicaBytes(int replica);
+	// serialize a REPLY or READREPLY into out, reusing its buffer
+	static void encodeReply(string &out, int transID, Address &fromAddr, MessageType type, bool success, string_view value, unsigned long long timestamp);
+};
+
+/**
+ * CLASS NAME: MessageView
+ *
+ * DESCRIPTION: A message in the binary format read where it lies. The key and
+ * 				value point into the received bytes, so the view is only good
+ * 				until they are released.
+ */
+class MessageView{
+public:
+	MessageType type;
+	int replica;
+	string_view key;
+	string_view value;
+	Address fromAddr;
+	int transID;
+	bool success;
+	unsigned long long timestamp;
+	bool valid;
+	MessageView(const char *data, int size);
 };
 
 #endif
@@ -0,0 +1,98 @@
+/**********************************
+ * FILE NAME: NetBench.cpp
+ *
+ * DESCRIPTION: Benchmark of the emulated network: time the nodes of a tick
+ * 				take to receive their messages as the number of nodes grows,
+ * 				every node sending the same number of messages per tick
+ **********************************/
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "EmulNet.h"
+
+/**
+ * Macros
+ */
+#define BENCH_TICKS 20
+#define BENCH_MSG_SIZE 64
+
+/**
+ * FUNCTION NAME: enqueue
+ *
+ * DESCRIPTION: Keep the payloads handed out by ENrecv, to give back afterwards
+ */
+static int enqueue(void *env, char *buff, int size) {
+	((vector<char *> *)env)->push_back(buff);
+	return size;
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: BENCH_TICKS ticks of nodes nodes, each sending perNode messages
+ * 				to random nodes, then every node receiving
+ *
+ * RETURNS:
+ * nanoseconds spent receiving per tick
+ */
+static double run(int nodes, int perNode) {
+	char config[] = "/tmp/netbench.XXXXXX";
+	int fd = mkstemp(config);
+	if ( fd < 0 ) {
+		perror("mkstemp");
+		exit(1);
+	}
+	FILE *fp = fdopen(fd, "w");
+	fprintf(fp, "MAX_NNB: %d\nSINGLE_FAILURE: 0\nDROP_MSG: 0\nMSG_DROP_PROB: 0\nCRUD_TEST: CREATE\nSEED: 1\n", nodes);
+	fclose(fp);
+
+	Params par;
+	par.setparams(config);
+	unlink(config);
+	EmulNet net(&par);
+	vector<Address> addrs(nodes + 1);
+	for ( int i = 1; i <= nodes; i++ ) {
+		net.ENinit(&addrs[i], par.PORTNUM);
+	}
+
+	char data[BENCH_MSG_SIZE];
+	memset(data, 'x', sizeof(data));
+	vector<char *> received;
+	unsigned int seed = 1;
+	double recvNs = 0;
+	for ( int t = 1; t <= BENCH_TICKS; t++ ) {
+		par.globaltime = t;
+		for ( int i = 1; i <= nodes; i++ ) {
+			for ( int k = 0; k < perNode; k++ ) {
+				net.ENsend(&addrs[i], &addrs[1 + rand_r(&seed) % nodes], data, sizeof(data));
+			}
+		}
+		auto start = chrono::steady_clock::now();
+		for ( int i = 1; i <= nodes; i++ ) {
+			net.ENrecv(&addrs[i], enqueue, NULL, 1, &received);
+			for ( auto &it : received ) {
+				net.ENrelease(it);
+			}
+			received.clear();
+		}
+		recvNs += chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+	}
+	net.ENcleanup();
+	return recvNs / BENCH_TICKS;
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: NetBench [messages per node per tick]
+ */
+int main(int argc, char *argv[]) {
+	int perNode = argc > 1 ? atoi(argv[1]) : 4;
+
+	printf("%8s %14s %14s %12s\n", "nodes", "recv_us/tick", "recv_ns/node", "recv_ns/msg");
+	for ( int nodes = 125; nodes <= 2000 && nodes * perNode < ENBUFFSIZE; nodes *= 2 ) {
+		double ns = run(nodes, perNode);
+		printf("%8d %14.1f %14.1f %12.1f\n", nodes, ns / 1000, ns / nodes, ns / ((double)nodes * perNode));
+	}
+	return 0;
+}
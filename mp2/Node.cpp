@@ -27,10 +27,15 @@ Node::~Node() {}
 /**
  * FUNCTION NAME: computeHashCode
  *
- * DESCRIPTION: This function computes the hash code of the node address
+ * DESCRIPTION: This function computes the hash code of the node address: the
+ * 				token of its virtual node vnode, each at its own place on the ring
  */
-void Node::computeHashCode() {
-	nodeHashCode = hashFunc(nodeAddress.addr)%RING_SIZE;
+void Node::computeHashCode(int vnode) {
+	char token[sizeof(nodeAddress.addr) + sizeof(int)];
+
+	memcpy(token, nodeAddress.addr, sizeof(nodeAddress.addr));
+	memcpy(token + sizeof(nodeAddress.addr), &vnode, sizeof(int));
+	nodeHashCode = std::hash<string_view>()(string_view(token, sizeof(token)));
 }
 
 /**
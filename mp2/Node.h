@@ -13,14 +13,14 @@
 class Node {
 public:
 	Address nodeAddress;
+	// token: position of the node on the ring, one of the 64-bit hash values
 	size_t nodeHashCode;
-	std::hash<string> hashFunc;
 	Node();
 	Node(Address address);
 	Node(const Node& another);
 	Node& operator=(const Node& another);
 	bool operator < (const Node& another) const;
-	void computeHashCode();
+	void computeHashCode(int vnode = 0);
 	size_t getHashCode();
 	Address * getAddress();
 	void setHashCode(size_t hashCode);
@@ -19,8 +19,35 @@ Params::Params(): PORTNUM(8001) {}
 void Params::setparams(char *config_file) {
 	//trace.funcEntry("Params::setparams");
 	char CRUD[10];
+	char key[64], value[64];
 	FILE *fp = fopen(config_file,"r");
 
+	LATENCY_MODEL = NO_LATENCY;
+	LATENCY_MIN = 0;
+	LATENCY_MAX = 0;
+	LATENCY_MEAN = 0;
+	LATENCY_SIGMA = 0;
+	LINK_BANDWIDTH = 0;
+	LINK_BURST = 0;
+	LINK_QUEUE_DEPTH = 64;
+	TRANSPORT = EMUL_TRANSPORT;
+	UDP_BASE_PORT = 20000;
+	SHM_NAME = "";
+	WORKERS = 1;
+	SEED = 0;
+	SIM_MODE = TICK_SIM;
+	WAL_DIR = "";
+	WAL_SYNC = GROUP_SYNC;
+	WAL_WINDOW = 1;
+	SNAPSHOT_INTERVAL = 0;
+	STORAGE = HASH_STORAGE;
+	LSM_MEMTABLE_BYTES = 4 << 20;
+	LSM_BLOOM_BITS = 10;
+	VNODES = 1;
+	REPLICAS = 3;
+	READ_CONSISTENCY = QUORUM;
+	WRITE_CONSISTENCY = QUORUM;
+
 	fscanf(fp,"MAX_NNB: %d", &MAX_NNB);
 	fscanf(fp,"\nSINGLE_FAILURE: %d", &SINGLE_FAILURE);
 	fscanf(fp,"\nDROP_MSG: %d", &DROP_MSG);
@@ -40,6 +67,27 @@ void Params::setparams(char *config_file) {
 		this->CRUDTEST = DELETE_TEST;
 	}
 
+	// Optional "KEY: value" lines may follow in any order
+	while ( fscanf(fp, " %63[^:]: %63s", key, value) == 2 ) {
+		setparam(key, value);
+	}
+	if ( LINK_BURST <= 0 ) {
+		LINK_BURST = LINK_BANDWIDTH;
+	}
+	if ( WORKERS < 1 ) {
+		WORKERS = 1;
+	}
+	if ( VNODES < 1 ) {
+		VNODES = 1;
+	}
+	REPLICAS = min(max(REPLICAS, 1), MAX_REPLICAS);
+	if ( WAL_WINDOW < 1 ) {
+		WAL_WINDOW = 1;
+	}
+	if ( SEED == 0 ) {
+		SEED = time(NULL);
+	}
+
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
 	EN_GPSZ = MAX_NNB;
@@ -56,6 +104,131 @@ void Params::setparams(char *config_file) {
 	return;
 }
 
+/**
+ * FUNCTION NAME: setparam
+ *
+ * DESCRIPTION: Set one of the optional parameters of the test case
+ */
+void Params::setparam(char *key, char *value) {
+	if ( 0 == strcmp(key, "LATENCY_MODEL") ) {
+		if ( 0 == strcmp(value, "CONSTANT") ) {
+			LATENCY_MODEL = CONSTANT_LATENCY;
+		}
+		else if ( 0 == strcmp(value, "UNIFORM") ) {
+			LATENCY_MODEL = UNIFORM_LATENCY;
+		}
+		else if ( 0 == strcmp(value, "LOGNORMAL") ) {
+			LATENCY_MODEL = LOGNORMAL_LATENCY;
+		}
+		else {
+			LATENCY_MODEL = NO_LATENCY;
+		}
+	}
+	else if ( 0 == strcmp(key, "LATENCY_MIN") ) {
+		LATENCY_MIN = atof(value);
+	}
+	else if ( 0 == strcmp(key, "LATENCY_MAX") ) {
+		LATENCY_MAX = atof(value);
+	}
+	else if ( 0 == strcmp(key, "LATENCY_MEAN") ) {
+		LATENCY_MEAN = atof(value);
+	}
+	else if ( 0 == strcmp(key, "LATENCY_SIGMA") ) {
+		LATENCY_SIGMA = atof(value);
+	}
+	else if ( 0 == strcmp(key, "LINK_BANDWIDTH") ) {
+		LINK_BANDWIDTH = atof(value);
+	}
+	else if ( 0 == strcmp(key, "LINK_BURST") ) {
+		LINK_BURST = atof(value);
+	}
+	else if ( 0 == strcmp(key, "LINK_QUEUE_DEPTH") ) {
+		LINK_QUEUE_DEPTH = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "TRANSPORT") ) {
+		if ( 0 == strcmp(value, "UDP") ) {
+			TRANSPORT = UDP_TRANSPORT;
+		}
+		else if ( 0 == strcmp(value, "SHM") ) {
+			TRANSPORT = SHM_TRANSPORT;
+		}
+		else {
+			TRANSPORT = EMUL_TRANSPORT;
+		}
+	}
+	else if ( 0 == strcmp(key, "UDP_BASE_PORT") ) {
+		UDP_BASE_PORT = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "SHM_NAME") ) {
+		SHM_NAME = value;
+	}
+	else if ( 0 == strcmp(key, "WORKERS") ) {
+		WORKERS = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "SEED") ) {
+		SEED = strtoul(value, NULL, 10);
+	}
+	else if ( 0 == strcmp(key, "SIM_MODE") ) {
+		SIM_MODE = ( 0 == strcmp(value, "EVENT") ) ? EVENT_SIM : TICK_SIM;
+	}
+	else if ( 0 == strcmp(key, "WAL_DIR") ) {
+		WAL_DIR = value;
+	}
+	else if ( 0 == strcmp(key, "WAL_SYNC") ) {
+		if ( 0 == strcmp(value, "NONE") ) {
+			WAL_SYNC = NO_SYNC;
+		}
+		else if ( 0 == strcmp(value, "EVERY") ) {
+			WAL_SYNC = EVERY_SYNC;
+		}
+		else {
+			WAL_SYNC = GROUP_SYNC;
+		}
+	}
+	else if ( 0 == strcmp(key, "WAL_WINDOW") ) {
+		WAL_WINDOW = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "SNAPSHOT_INTERVAL") ) {
+		SNAPSHOT_INTERVAL = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "STORAGE") ) {
+		STORAGE = ( 0 == strcmp(value, "LSM") ) ? LSM_STORAGE : HASH_STORAGE;
+	}
+	else if ( 0 == strcmp(key, "LSM_MEMTABLE_BYTES") ) {
+		LSM_MEMTABLE_BYTES = atol(value);
+	}
+	else if ( 0 == strcmp(key, "LSM_BLOOM_BITS") ) {
+		LSM_BLOOM_BITS = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "VNODES") ) {
+		VNODES = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "REPLICAS") ) {
+		REPLICAS = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "READ_CONSISTENCY") ) {
+		READ_CONSISTENCY = consistencyOf(value);
+	}
+	else if ( 0 == strcmp(key, "WRITE_CONSISTENCY") ) {
+		WRITE_CONSISTENCY = consistencyOf(value);
+	}
+}
+
+/**
+ * FUNCTION NAME: consistencyOf
+ *
+ * DESCRIPTION: The consistency level named value in the config file
+ */
+int Params::consistencyOf(char *value) {
+	if ( 0 == strcmp(value, "ONE") ) {
+		return ONE;
+	}
+	if ( 0 == strcmp(value, "ALL") ) {
+		return ALL;
+	}
+	return QUORUM;
+}
+
 /**
  * FUNCTION NAME: getcurrtime
  *
@@ -10,8 +10,16 @@
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "common.h"
 
 enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
+enum latencyTYPE { NO_LATENCY, CONSTANT_LATENCY, UNIFORM_LATENCY, LOGNORMAL_LATENCY };
+enum transportTYPE { EMUL_TRANSPORT, UDP_TRANSPORT, SHM_TRANSPORT };
+enum simTYPE { TICK_SIM, EVENT_SIM };
+enum walSYNC { NO_SYNC, GROUP_SYNC, EVERY_SYNC };
+enum storageTYPE { HASH_STORAGE, LSM_STORAGE };
+// replies an operation waits for: one, a majority, or all of the replicas
+enum consistencyLEVEL { ONE, QUORUM, ALL };
 
 /**
  * CLASS NAME: Params
@@ -32,8 +40,39 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	// link latency model of the emulated network, in time units
+	int LATENCY_MODEL;
+	double LATENCY_MIN;			// uniform lower bound, added to the log-normal sample
+	double LATENCY_MAX;			// uniform upper bound, log-normal tail cap (0 = no cap)
+	double LATENCY_MEAN;		// constant latency, log-normal median
+	double LATENCY_SIGMA;		// log-normal shape
+	// per link bandwidth model of the emulated network
+	double LINK_BANDWIDTH;		// bytes per time unit (0 = unlimited)
+	double LINK_BURST;			// token bucket size in bytes
+	int LINK_QUEUE_DEPTH;		// frames that may wait for bandwidth on a link
+	// network the nodes talk over
+	int TRANSPORT;
+	int UDP_BASE_PORT;			// node n of the membership network listens on UDP_BASE_PORT + n
+	string SHM_NAME;			// prefix of the shared memory regions (empty = private to this process)
+	int WORKERS;				// threads running the nodes of a tick
+	unsigned int SEED;			// seed of rand() (0 = time of day)
+	int SIM_MODE;				// run every node every tick, or only the nodes with something to do
+	// write-ahead log of every node's hash table
+	string WAL_DIR;				// directory of the logs (empty = no log)
+	int WAL_SYNC;				// when a commit reaches the disk, see WriteAheadLog
+	int WAL_WINDOW;				// time steps whose writes are committed together
+	int SNAPSHOT_INTERVAL;		// time steps between snapshots of a table with a log (0 = none)
+	int STORAGE;				// storage engine of the nodes: HASH (in memory) or LSM (on disk)
+	long LSM_MEMTABLE_BYTES;	// memtable size at which an LSM tree writes a table out
+	int LSM_BLOOM_BITS;			// bloom filter bits per key of an LSM table (0 = no filter)
+	int VNODES;					// positions of each node on the ring of the KV store
+	int REPLICAS;				// replicas of every key, up to MAX_REPLICAS
+	int READ_CONSISTENCY;		// consistency level of a read that does not pick one: ONE, QUORUM or ALL
+	int WRITE_CONSISTENCY;		// consistency level of a create, update or delete that does not pick one
 	Params();
 	void setparams(char *);
+	void setparam(char *key, char *value);
+	static int consistencyOf(char *value);
 	int getcurrtime();
 };
 
@@ -0,0 +1,113 @@
+/**********************************
+ * FILE NAME: Ring.cpp
+ *
+ * DESCRIPTION: Definition of the consistent hashing ring of the KV store
+ **********************************/
+
+#include "Ring.h"
+
+/**
+ * Constructor
+ */
+Ring::Ring() {
+	replicas = 0;
+}
+
+/**
+ * FUNCTION NAME: build
+ *
+ * DESCRIPTION: Make members the ring, each at vnodes positions, and each key
+ * 				replicated on the first replicas distinct nodes from its
+ * 				position on
+ */
+void Ring::build(const set<Node, RingOrder> &members, int replicas, int vnodes) {
+	this->replicas = replicas;
+	this->members.clear();
+	nodes.clear();
+	for ( auto &it : members ) {
+		this->members.push_back(it.nodeAddress);
+		for ( int v = 0; v < vnodes; v++ ) {
+			Node node(it);
+			node.computeHashCode(v);
+			nodes.push_back(node);
+		}
+	}
+	sort(nodes.begin(), nodes.end(), RingOrder());
+
+	size_t n = nodes.size();
+	hashes.resize(n);
+	for ( size_t i = 0; i < n; i++ ) {
+		hashes[i] = nodes[i].nodeHashCode;
+	}
+	preference.clear();
+	if ( members.size() < (size_t)replicas ) {
+		return;
+	}
+	preference.resize(n * replicas);
+	for ( size_t i = 0; i < n; i++ ) {
+		int *list = &preference[i * replicas];
+		int found = 0;
+		for ( size_t j = i; found < replicas; j = (j + 1) % n ) {
+			bool chosen = false;
+			for ( int k = 0; k < found && !chosen; k++ ) {
+				chosen = nodes[list[k]].nodeAddress == nodes[j].nodeAddress;
+			}
+			if ( !chosen ) {
+				list[found++] = j;
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: lookup
+ *
+ * DESCRIPTION: The replicas of the keys at position pos: the first node at
+ * 				or after pos, going round past the last one to the first
+ *
+ * RETURNS:
+ * getReplicas() indices into the ring, NULL if it has fewer nodes than that
+ */
+const int * Ring::lookup(size_t pos) const {
+	if ( preference.empty() ) {
+		return NULL;
+	}
+	size_t i = lower_bound(hashes.begin(), hashes.end(), pos) - hashes.begin();
+	if ( i == hashes.size() ) {
+		i = 0;
+	}
+	return &preference[i * replicas];
+}
+
+/**
+ * FUNCTION NAME: contains
+ *
+ * RETURNS:
+ * true if the node at addr is in the ring
+ */
+bool Ring::contains(const Address &addr) const {
+	for ( auto &it : members ) {
+		if ( it == addr ) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: sameNodes
+ *
+ * RETURNS:
+ * true if another has the same positions, of the same nodes
+ */
+bool Ring::sameNodes(const Ring &another) const {
+	if ( nodes.size() != another.nodes.size() ) {
+		return false;
+	}
+	for ( size_t i = 0; i < nodes.size(); i++ ) {
+		if ( !(nodes[i].nodeAddress == another.nodes[i].nodeAddress) ) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,70 @@
+/**********************************
+ * FILE NAME: Ring.h
+ *
+ * DESCRIPTION: Header file of the consistent hashing ring of the KV store
+ **********************************/
+
+#ifndef RING_H_
+#define RING_H_
+
+#include "stdincludes.h"
+#include "Node.h"
+#include <set>
+
+/**
+ * Struct Name: RingOrder
+ *
+ * DESCRIPTION: Order of the nodes around the ring: by hash code, then by
+ * 				address for nodes at the same position
+ */
+struct RingOrder {
+	bool operator()(const Node &a, const Node &b) const {
+		if (a.nodeHashCode != b.nodeHashCode) {
+			return a.nodeHashCode < b.nodeHashCode;
+		}
+		return memcmp(a.nodeAddress.addr, b.nodeAddress.addr, sizeof(a.nodeAddress.addr)) < 0;
+	}
+};
+
+/**
+ * CLASS NAME: Ring
+ *
+ * DESCRIPTION: The positions of the nodes, each node at vnodes tokens, in
+ * 				ring order, with their tokens in an array of their own for
+ * 				binary search. The replicas of the keys up to each position,
+ * 				its preference list, are the nodes of the positions from
+ * 				there on, skipping those of a node already in the list; they
+ * 				are worked out when the ring is built, so a lookup is a
+ * 				binary search that returns indices into the ring without
+ * 				allocating.
+ */
+class Ring {
+private:
+	// one entry per position; nodeAddress is the node it belongs to
+	vector<Node> nodes;
+	vector<size_t> hashes;
+	// replicas indices into nodes per position
+	vector<int> preference;
+	int replicas;
+	// the nodes, one entry each
+	vector<Address> members;
+
+public:
+	Ring();
+	void build(const set<Node, RingOrder> &members, int replicas, int vnodes);
+	const int * lookup(size_t pos) const;
+	int getReplicas() const {
+		return replicas;
+	}
+	// positions, not nodes
+	size_t size() const {
+		return nodes.size();
+	}
+	const Node & at(int i) const {
+		return nodes[i];
+	}
+	bool contains(const Address &addr) const;
+	bool sameNodes(const Ring &another) const;
+};
+
+#endif /* RING_H_ */
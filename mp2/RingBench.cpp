@@ -0,0 +1,148 @@
+/**********************************
+ * FILE NAME: RingBench.cpp
+ *
+ * DESCRIPTION: Benchmark of finding the replicas of a key: the token of the key
+ * 				and the lookup of its three replicas, by the linear scan
+ * 				findNodes used to do and by Ring::lookup, as the number of
+ * 				positions on the ring grows
+ **********************************/
+
+#include "stdincludes.h"
+#include "Ring.h"
+#include "KVStore.h"
+
+/**
+ * Macros
+ */
+#define BENCH_REPLICAS 3
+// lookups per ring size, fewer for the scan of the larger rings
+#define BENCH_LOOKUPS 1000000
+#define BENCH_SCAN_WORK 200000000L
+
+/**
+ * FUNCTION NAME: nowNanos
+ *
+ * RETURNS:
+ * monotonic wall clock time in nanoseconds
+ */
+static long long nowNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * FUNCTION NAME: linearScan
+ *
+ * DESCRIPTION: The replicas of the key at pos as findNodes found them before
+ * 				Ring: a walk from the start of the sorted positions to the
+ * 				first at or after pos, copying it and the next two
+ */
+static vector<Node> linearScan(vector<Node> &ring, size_t pos) {
+	vector<Node> addr_vec;
+	if (ring.size() >= 3) {
+		// if pos <= min || pos > max, the leader is the min
+		if (pos <= ring.at(0).getHashCode() || pos > ring.at(ring.size()-1).getHashCode()) {
+			addr_vec.emplace_back(ring.at(0));
+			addr_vec.emplace_back(ring.at(1));
+			addr_vec.emplace_back(ring.at(2));
+		}
+		else {
+			// go through the ring until pos <= node
+			for (size_t i=1; i<ring.size(); i++){
+				Node addr = ring.at(i);
+				if (pos <= addr.getHashCode()) {
+					addr_vec.emplace_back(addr);
+					addr_vec.emplace_back(ring.at((i+1)%ring.size()));
+					addr_vec.emplace_back(ring.at((i+2)%ring.size()));
+					break;
+				}
+			}
+		}
+	}
+	return addr_vec;
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Build a ring of positions nodes, one position each, and time
+ * 				both lookups of the same random keys. check sums the first
+ * 				byte of the first replica found, the same for both when they
+ * 				agree.
+ */
+static void run(int positions, const vector<string> &keys) {
+	set<Node, RingOrder> members;
+	Ring ring;
+	vector<Node> sorted;
+	long scanCheck = 0, ringCheck = 0;
+	long scans = min((long)keys.size(), max(1000L, BENCH_SCAN_WORK / positions));
+
+	for ( int i = 0; i < positions; i++ ) {
+		Address addr;
+		int id = i + 1;
+		short port = 0;
+		memcpy(&addr.addr[0], &id, sizeof(int));
+		memcpy(&addr.addr[4], &port, sizeof(short));
+		members.insert(Node(addr));
+	}
+	ring.build(members, BENCH_REPLICAS, 1);
+	for ( size_t i = 0; i < ring.size(); i++ ) {
+		sorted.push_back(ring.at(i));
+	}
+
+	long long start = nowNanos();
+	for ( long i = 0; i < scans; i++ ) {
+		vector<Node> replicas = linearScan(sorted, KVStore::tokenOf(keys[i]));
+		scanCheck += replicas[0].nodeAddress.addr[0];
+	}
+	double scan = (double)(nowNanos() - start) / scans;
+
+	start = nowNanos();
+	for ( long i = 0; i < scans; i++ ) {
+		const int *replicas = ring.lookup(KVStore::tokenOf(keys[i]));
+		ringCheck += ring.at(replicas[0]).nodeAddress.addr[0];
+	}
+	if ( ringCheck != scanCheck ) {
+		printf("replicas differ at %d positions\n", positions);
+		exit(1);
+	}
+	for ( size_t i = scans; i < keys.size(); i++ ) {
+		const int *replicas = ring.lookup(KVStore::tokenOf(keys[i]));
+		ringCheck += ring.at(replicas[0]).nodeAddress.addr[0];
+	}
+	double binary = (double)(nowNanos() - start) / keys.size();
+
+	printf("%10d %14.1f %14.1f %10ld %12ld\n", positions, scan, binary, scans, ringCheck);
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: RingBench [positions ...]; by default 10 to 100,000 positions
+ * 				by factors of 10. Keys are 5 random alphanumeric characters,
+ * 				as in Application::initTestKVPairs.
+ */
+int main(int argc, char *argv[]) {
+	static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	vector<int> sizes;
+	vector<string> keys(BENCH_LOOKUPS);
+	unsigned int seed = 1;
+
+	for ( int i = 1; i < argc; i++ ) {
+		sizes.push_back(atoi(argv[i]));
+	}
+	if ( sizes.empty() ) {
+		sizes = {10, 100, 1000, 10000, 100000};
+	}
+	for ( auto &key : keys ) {
+		for ( int i = 0; i < 5; i++ ) {
+			key.push_back(alphanum[rand_r(&seed) % (sizeof(alphanum) - 1)]);
+		}
+	}
+	printf("%10s %14s %14s %10s %12s\n", "positions", "scan ns", "lower_bound ns", "scans", "check");
+	for ( int positions : sizes ) {
+		run(positions, keys);
+	}
+	return 0;
+}
@@ -0,0 +1,432 @@
+/**********************************
+ * FILE NAME: SSTable.cpp
+ *
+ * DESCRIPTION: Definition of the sorted tables of the LSM tree
+ **********************************/
+
+#include "SSTable.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+/**
+ * FUNCTION NAME: readFully
+ *
+ * DESCRIPTION: pread() len bytes at offset, however many calls it takes
+ *
+ * RETURNS:
+ * true if all of them were read
+ */
+static bool readFully(int fd, char *data, size_t len, unsigned long long offset) {
+	while ( len > 0 ) {
+		ssize_t n = pread(fd, data, len, offset);
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			return false;
+		}
+		data += n;
+		len -= n;
+		offset += n;
+	}
+	return true;
+}
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: Open the table at path and read its index, bloom filter and
+ * 				smallest key. isOpen() tells whether it was a table.
+ */
+SSTable::SSTable(string path, unsigned long number) {
+	sst_footer footer;
+	string index;
+	struct stat st;
+
+	this->path = path;
+	this->number = number;
+	fileSize = 0;
+	count = 0;
+	bloomHashes = 0;
+	fd = open(path.c_str(), O_RDONLY);
+	if ( fd < 0 ) {
+		return;
+	}
+	if ( fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(sst_footer)
+			|| !readFully(fd, (char *)&footer, sizeof(sst_footer), st.st_size - sizeof(sst_footer))
+			|| memcmp(footer.magic, SST_MAGIC, sizeof(footer.magic)) != 0
+			|| footer.indexOffset + footer.indexLen > footer.bloomOffset
+			|| footer.bloomOffset + footer.bloomLen > footer.smallestOffset
+			|| footer.smallestOffset + footer.smallestLen > st.st_size - sizeof(sst_footer) ) {
+		close(fd);
+		fd = -1;
+		return;
+	}
+	fileSize = st.st_size;
+	count = footer.count;
+	bloomHashes = footer.bloomHashes;
+	index.resize(footer.indexLen);
+	bloom.resize(footer.bloomLen);
+	smallest.resize(footer.smallestLen);
+	if ( !readFully(fd, &index[0], index.size(), footer.indexOffset)
+			|| !readFully(fd, &bloom[0], bloom.size(), footer.bloomOffset)
+			|| !readFully(fd, &smallest[0], smallest.size(), footer.smallestOffset) ) {
+		close(fd);
+		fd = -1;
+		return;
+	}
+	for ( size_t pos = 0; pos + sizeof(sst_index) <= index.size(); ) {
+		sst_index entry;
+		sst_block block;
+		memcpy(&entry, index.data() + pos, sizeof(sst_index));
+		pos += sizeof(sst_index);
+		if ( entry.keylen > index.size() - pos ) {
+			break;
+		}
+		block.offset = entry.offset;
+		block.len = entry.blocklen;
+		block.last.assign(index.data() + pos, entry.keylen);
+		blocks.push_back(block);
+		pos += entry.keylen;
+	}
+	if ( blocks.empty() ) {
+		close(fd);
+		fd = -1;
+	}
+}
+
+/**
+ * Destructor
+ */
+SSTable::~SSTable() {
+	if ( fd >= 0 ) {
+		close(fd);
+	}
+}
+
+/**
+ * FUNCTION NAME: hashOf
+ *
+ * DESCRIPTION: 64 bit FNV-1a of a key, for the bloom filter
+ */
+unsigned long long SSTable::hashOf(string_view key) {
+	unsigned long long hash = 14695981039346656037ULL;
+
+	for ( size_t i = 0; i < key.size(); i++ ) {
+		hash = (hash ^ (unsigned char)key[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * FUNCTION NAME: mayContain
+ *
+ * DESCRIPTION: Ask the bloom filter. bloomHashes bits are probed by double
+ * 				hashing: h1 + i * h2.
+ *
+ * RETURNS:
+ * false if the table certainly does not have key
+ */
+bool SSTable::mayContain(string_view key) {
+	unsigned long long bits = bloom.size() * 8;
+	unsigned long long h1 = hashOf(key);
+	unsigned long long h2 = (h1 >> 32) | (h1 << 32);
+
+	if ( bits == 0 ) {
+		return true;
+	}
+	for ( unsigned int i = 0; i < bloomHashes; i++ ) {
+		unsigned long long bit = (h1 + i * h2) % bits;
+		if ( !(bloom[bit / 8] & (1 << (bit % 8))) ) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * FUNCTION NAME: readBlock
+ *
+ * DESCRIPTION: Read data block i into block
+ */
+bool SSTable::readBlock(size_t i, string &block) {
+	block.resize(blocks[i].len);
+	return readFully(fd, &block[0], block.size(), blocks[i].offset);
+}
+
+/**
+ * FUNCTION NAME: get
+ *
+ * DESCRIPTION: Look key up: the bloom filter, then the index for the only
+ * 				block that can hold it, then that block
+ *
+ * RETURNS:
+ * true and its value in value if the table has a record of key; an empty
+ * value is a deletion. block is the buffer the block is read into, and
+ * blockReads counts the blocks read.
+ */
+bool SSTable::get(string_view key, string &value, string &block, int &blockReads) {
+	size_t lo = 0, hi = blocks.size();
+	size_t pos = 0;
+	sst_record record;
+
+	if ( key < string_view(smallest) || key > string_view(largest()) || !mayContain(key) ) {
+		return false;
+	}
+	// first block whose last key is not below key
+	while ( lo < hi ) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ( string_view(blocks[mid].last) < key ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	if ( lo == blocks.size() || !readBlock(lo, block) ) {
+		return false;
+	}
+	blockReads++;
+	while ( pos + sizeof(sst_record) <= block.size() ) {
+		memcpy(&record, block.data() + pos, sizeof(sst_record));
+		pos += sizeof(sst_record);
+		if ( record.keylen > block.size() - pos || record.valuelen > block.size() - pos - record.keylen ) {
+			break;
+		}
+		int cmp = string_view(block.data() + pos, record.keylen).compare(key);
+		if ( cmp == 0 ) {
+			value.assign(block.data() + pos + record.keylen, record.valuelen);
+			return true;
+		}
+		if ( cmp > 0 ) {
+			break;
+		}
+		pos += record.keylen + record.valuelen;
+	}
+	return false;
+}
+
+/**
+ * Constructor
+ */
+SSTableCursor::SSTableCursor(shared_ptr<SSTable> table) {
+	this->table = table;
+	blockIndex = 0;
+	pos = 0;
+	load();
+}
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: Start at the first record whose key is not below start
+ */
+SSTableCursor::SSTableCursor(shared_ptr<SSTable> table, string_view start) {
+	size_t hi = table->blocks.size();
+
+	this->table = table;
+	blockIndex = 0;
+	pos = 0;
+	// first block whose last key is not below start
+	while ( blockIndex < hi ) {
+		size_t mid = blockIndex + (hi - blockIndex) / 2;
+		if ( string_view(table->blocks[mid].last) < start ) {
+			blockIndex = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	load();
+	while ( valid() && k < start ) {
+		next();
+	}
+}
+
+/**
+ * FUNCTION NAME: load
+ *
+ * DESCRIPTION: Make the record at pos of the current block, or the first of the
+ * 				next block with one, the current record
+ *
+ * RETURNS:
+ * false at the end of the table
+ */
+bool SSTableCursor::load() {
+	sst_record record;
+
+	while ( blockIndex < table->blocks.size() ) {
+		if ( pos == 0 && !table->readBlock(blockIndex, block) ) {
+			// an unreadable block ends the table
+			blockIndex = table->blocks.size();
+			break;
+		}
+		if ( pos + sizeof(sst_record) <= block.size() ) {
+			memcpy(&record, block.data() + pos, sizeof(sst_record));
+			if ( record.keylen <= block.size() - pos - sizeof(sst_record)
+					&& record.valuelen <= block.size() - pos - sizeof(sst_record) - record.keylen ) {
+				k = string_view(block.data() + pos + sizeof(sst_record), record.keylen);
+				v = string_view(block.data() + pos + sizeof(sst_record) + record.keylen, record.valuelen);
+				return true;
+			}
+		}
+		blockIndex++;
+		pos = 0;
+	}
+	k = string_view();
+	v = string_view();
+	return false;
+}
+
+/**
+ * FUNCTION NAME: next
+ */
+void SSTableCursor::next() {
+	if ( !valid() ) {
+		return;
+	}
+	pos += sizeof(sst_record) + k.size() + v.size();
+	load();
+}
+
+/**
+ * Constructor
+ */
+SSTableWriter::SSTableWriter(string path, int bloomBits) {
+	this->path = path;
+	this->bloomBits = bloomBits;
+	offset = 0;
+	count = 0;
+	fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+	if ( fd < 0 ) {
+		perror("open");
+		exit(1);
+	}
+}
+
+/**
+ * Destructor
+ *
+ * DESCRIPTION: A writer never finished removes its file
+ */
+SSTableWriter::~SSTableWriter() {
+	if ( fd >= 0 ) {
+		close(fd);
+		unlink(path.c_str());
+	}
+}
+
+/**
+ * FUNCTION NAME: put
+ *
+ * DESCRIPTION: write() all of data, however many calls it takes
+ */
+void SSTableWriter::put(const char *data, size_t len) {
+	offset += len;
+	while ( len > 0 ) {
+		ssize_t n = write(fd, data, len);
+		if ( n < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			perror("write");
+			exit(1);
+		}
+		data += n;
+		len -= n;
+	}
+}
+
+/**
+ * FUNCTION NAME: closeBlock
+ *
+ * DESCRIPTION: Write the current data block and index it by its last key
+ */
+void SSTableWriter::closeBlock() {
+	sst_index entry;
+
+	if ( block.empty() ) {
+		return;
+	}
+	entry.offset = offset;
+	entry.blocklen = block.size();
+	entry.keylen = lastKey.size();
+	index.append((char *)&entry, sizeof(sst_index));
+	index.append(lastKey);
+	put(block.data(), block.size());
+	block.clear();
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Append a record. Keys must come in increasing order.
+ */
+void SSTableWriter::add(string_view key, string_view value) {
+	sst_record record;
+
+	if ( count == 0 ) {
+		smallest.assign(key);
+	}
+	record.keylen = key.size();
+	record.valuelen = value.size();
+	block.append((char *)&record, sizeof(sst_record));
+	block.append(key.data(), key.size());
+	block.append(value.data(), value.size());
+	lastKey.assign(key);
+	hashes.push_back(SSTable::hashOf(key));
+	count++;
+	if ( block.size() >= SST_BLOCK_SIZE ) {
+		closeBlock();
+	}
+}
+
+/**
+ * FUNCTION NAME: finish
+ *
+ * DESCRIPTION: Write the last block, the index block, the bloom filter, the
+ * 				smallest key and the footer, and sync the file
+ *
+ * RETURNS:
+ * size of the file
+ */
+unsigned long long SSTableWriter::finish() {
+	sst_footer footer;
+	string bloom;
+	unsigned long long bits;
+
+	closeBlock();
+	memset(&footer, 0, sizeof(sst_footer));
+	footer.count = count;
+	footer.indexOffset = offset;
+	footer.indexLen = index.size();
+	put(index.data(), index.size());
+
+	// bloomBits bits per key, and the number of probes that suits them best; no probe lets every key through
+	bits = max(64ULL, count * max(bloomBits, 0));
+	bloom.assign((bits + 7) / 8, 0);
+	bits = bloom.size() * 8;
+	footer.bloomHashes = bloomBits > 0 ? max(1, (int)(bloomBits * 0.69)) : 0;
+	for ( unsigned long long h1 : hashes ) {
+		unsigned long long h2 = (h1 >> 32) | (h1 << 32);
+		for ( unsigned int i = 0; i < footer.bloomHashes; i++ ) {
+			unsigned long long bit = (h1 + i * h2) % bits;
+			bloom[bit / 8] |= 1 << (bit % 8);
+		}
+	}
+	footer.bloomOffset = offset;
+	footer.bloomLen = bloom.size();
+	put(bloom.data(), bloom.size());
+	footer.smallestOffset = offset;
+	footer.smallestLen = smallest.size();
+	put(smallest.data(), smallest.size());
+	memcpy(footer.magic, SST_MAGIC, sizeof(footer.magic));
+	put((char *)&footer, sizeof(sst_footer));
+	if ( fdatasync(fd) < 0 ) {
+		perror("fdatasync");
+		exit(1);
+	}
+	close(fd);
+	fd = -1;
+	return offset;
+}
@@ -0,0 +1,177 @@
+/**********************************
+ * FILE NAME: SSTable.h
+ *
+ * DESCRIPTION: Header file of the sorted tables of the LSM tree
+ **********************************/
+
+#ifndef _SSTABLE_H_
+#define _SSTABLE_H_
+
+#include "stdincludes.h"
+#include <memory>
+
+/*
+ * Macros
+ */
+// last bytes of a table file
+#define SST_MAGIC "KVSST01"
+// a data block is closed once it holds this many bytes
+#define SST_BLOCK_SIZE 4096
+
+/**
+ * Struct Name: sst_record
+ *
+ * DESCRIPTION: A record of a data block, followed by keylen bytes of key and
+ * 				valuelen bytes of value. An empty value is a deletion.
+ */
+typedef struct sst_record {
+	unsigned int keylen;
+	unsigned int valuelen;
+}sst_record;
+
+/**
+ * Struct Name: sst_index
+ *
+ * DESCRIPTION: An entry of the index block, followed by keylen bytes of the
+ * 				last key of the data block it points to
+ */
+typedef struct sst_index {
+	unsigned long long offset;
+	unsigned int blocklen;
+	unsigned int keylen;
+}sst_index;
+
+/**
+ * Struct Name: sst_footer
+ *
+ * DESCRIPTION: End of a table file. Before it: the data blocks, the index
+ * 				block, the bloom filter and the smallest key, in that order.
+ */
+typedef struct sst_footer {
+	unsigned long long indexOffset;
+	unsigned long long bloomOffset;
+	unsigned long long smallestOffset;
+	unsigned long long count;
+	unsigned int indexLen;
+	unsigned int bloomLen;
+	unsigned int smallestLen;
+	unsigned int bloomHashes;
+	char magic[8];
+}sst_footer;
+
+/**
+ * Struct Name: sst_block
+ *
+ * DESCRIPTION: Where a data block is, as kept in memory from the index block
+ */
+typedef struct sst_block {
+	unsigned long long offset;
+	unsigned int len;
+	string last;
+}sst_block;
+
+/**
+ * CLASS NAME: SSTable
+ *
+ * DESCRIPTION: An immutable table of sorted keys on disk. The index and the
+ * 				bloom filter are read when it is opened; a lookup the filter
+ * 				lets through reads one data block. Safe to read from several
+ * 				threads.
+ */
+class SSTable {
+private:
+	int fd;
+	string bloom;
+	unsigned int bloomHashes;
+	friend class SSTableCursor;
+
+public:
+	string path;
+	unsigned long number;
+	unsigned long long fileSize;
+	unsigned long long count;
+	vector<sst_block> blocks;
+	string smallest;
+	SSTable(string path, unsigned long number);
+	SSTable(const SSTable &other) = delete;
+	SSTable &operator=(const SSTable &other) = delete;
+	virtual ~SSTable();
+	bool isOpen() {
+		return fd >= 0;
+	}
+	const string &largest() {
+		return blocks.back().last;
+	}
+	static unsigned long long hashOf(string_view key);
+	bool mayContain(string_view key);
+	bool readBlock(size_t i, string &block);
+	bool get(string_view key, string &value, string &block, int &blockReads);
+};
+
+/**
+ * CLASS NAME: SSTableCursor
+ *
+ * DESCRIPTION: Walks the records of a table in key order, a block at a time
+ */
+class SSTableCursor {
+private:
+	shared_ptr<SSTable> table;
+	size_t blockIndex;
+	string block;
+	size_t pos;
+	string_view k;
+	string_view v;
+	bool load();
+
+public:
+	SSTableCursor(shared_ptr<SSTable> table);
+	SSTableCursor(shared_ptr<SSTable> table, string_view start);
+	bool valid() {
+		return blockIndex < table->blocks.size();
+	}
+	string_view key() {
+		return k;
+	}
+	string_view value() {
+		return v;
+	}
+	void next();
+};
+
+/**
+ * CLASS NAME: SSTableWriter
+ *
+ * DESCRIPTION: Writes a table from records added in increasing key order.
+ * 				The file is synced before finish() returns.
+ */
+class SSTableWriter {
+private:
+	int fd;
+	string path;
+	int bloomBits;
+	unsigned long long offset;
+	unsigned long long count;
+	string block;
+	string lastKey;
+	string smallest;
+	string index;
+	vector<unsigned long long> hashes;
+	void put(const char *data, size_t len);
+	void closeBlock();
+
+public:
+	SSTableWriter(string path, int bloomBits);
+	SSTableWriter(const SSTableWriter &other) = delete;
+	SSTableWriter &operator=(const SSTableWriter &other) = delete;
+	virtual ~SSTableWriter();
+	void add(string_view key, string_view value);
+	unsigned long long getCount() {
+		return count;
+	}
+	unsigned long long bytesWritten() {
+		return offset + block.size();
+	}
+	unsigned long long finish();
+};
+
+#endif /* _SSTABLE_H_ */
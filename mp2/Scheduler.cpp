@@ -0,0 +1,109 @@
+/**********************************
+ * FILE NAME: Scheduler.cpp
+ *
+ * DESCRIPTION: Definition of Scheduler class functions
+ **********************************/
+
+#include "Scheduler.h"
+
+/**
+ * Constructor of the Scheduler class
+ */
+Scheduler::Scheduler(int nodes) {
+	for ( int net = 0; net < SIM_NETS; net++ ) {
+		last[net].assign(nodes, -1);
+	}
+	taken.assign(nodes, false);
+	scheduled = 0;
+}
+
+/**
+ * FUNCTION NAME: schedule
+ *
+ * DESCRIPTION: Wake up node at time for what it has on net. Node APP_EVENT
+ * 				only makes sure the time is visited.
+ */
+void Scheduler::schedule(int net, int time, int node) {
+	sim_event ev;
+
+	if ( time == INT_MAX ) {
+		// never
+		return;
+	}
+	lock_guard<mutex> guard(lock);
+	if ( node >= 0 ) {
+		if ( node >= (int)last[net].size() || last[net][node] == time ) {
+			return;
+		}
+		last[net][node] = time;
+	}
+	ev.time = time;
+	ev.node = node;
+	events[net].push(ev);
+	scheduled++;
+}
+
+/**
+ * FUNCTION NAME: due
+ *
+ * DESCRIPTION: Take every event of net up to time and add the nodes they wake
+ * 				up to nodes, which is kept sorted and without repeats
+ */
+void Scheduler::due(int net, int time, vector<int> &nodes) {
+	unsigned int i, had = nodes.size();
+
+	lock_guard<mutex> guard(lock);
+	for ( i = 0; i < had; i++ ) {
+		taken[nodes[i]] = true;
+	}
+	while ( !events[net].empty() && events[net].top().time <= time ) {
+		sim_event ev = events[net].top();
+		events[net].pop();
+		if ( ev.node < 0 ) {
+			continue;
+		}
+		if ( last[net][ev.node] == ev.time ) {
+			// a new event at this time has to be kept
+			last[net][ev.node] = -1;
+		}
+		if ( !taken[ev.node] ) {
+			taken[ev.node] = true;
+			nodes.push_back(ev.node);
+		}
+	}
+	for ( i = 0; i < nodes.size(); i++ ) {
+		taken[nodes[i]] = false;
+	}
+	if ( nodes.size() > had ) {
+		sort(nodes.begin(), nodes.end());
+	}
+}
+
+/**
+ * FUNCTION NAME: nextTime
+ *
+ * RETURNS:
+ * time of the earliest event on any network, INT_MAX if there is none
+ */
+int Scheduler::nextTime() {
+	int next = INT_MAX;
+
+	lock_guard<mutex> guard(lock);
+	for ( int net = 0; net < SIM_NETS; net++ ) {
+		if ( !events[net].empty() ) {
+			next = min(next, events[net].top().time);
+		}
+	}
+	return next;
+}
+
+/**
+ * FUNCTION NAME: getScheduled
+ *
+ * RETURNS:
+ * number of events scheduled so far
+ */
+long Scheduler::getScheduled() {
+	lock_guard<mutex> guard(lock);
+	return scheduled;
+}
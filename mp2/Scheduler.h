@@ -0,0 +1,59 @@
+/**********************************
+ * FILE NAME: Scheduler.h
+ *
+ * DESCRIPTION: Header file of the event queue of the event driven simulation
+ **********************************/
+
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// networks a node can be woken up for: the membership one and the KV store one
+#define SIM_NETS 2
+#define MP1_NET 0
+#define MP2_NET 1
+// node of an event that wakes up no node but the application
+#define APP_EVENT -1
+
+/**
+ * Struct Name: sim_event
+ */
+typedef struct sim_event {
+	int time;
+	int node;
+	bool operator>(const sim_event &other) const {
+		return time != other.time ? time > other.time : node > other.node;
+	}
+}sim_event;
+
+/**
+ * CLASS NAME: Scheduler
+ *
+ * DESCRIPTION: Times at which a node has to run: a message it can receive, or a
+ * 				timer it armed. Events may be scheduled from any thread. Waking
+ * 				a node more often than needed is harmless, so an event is never
+ * 				cancelled and only an exact repeat of the last one is dropped.
+ */
+class Scheduler {
+private:
+	mutex lock;
+	// earliest first
+	priority_queue<sim_event, vector<sim_event>, greater<sim_event> > events[SIM_NETS];
+	// time each node was last scheduled at on each network
+	vector<int> last[SIM_NETS];
+	// nodes already taken by the current call of due
+	vector<bool> taken;
+	long scheduled;
+public:
+	Scheduler(int nodes);
+	void schedule(int net, int time, int node);
+	void due(int net, int time, vector<int> &nodes);
+	int nextTime();
+	long getScheduled();
+};
+
+#endif /* _SCHEDULER_H_ */
@@ -0,0 +1,230 @@
+/**********************************
+ * FILE NAME: ShmNet.cpp
+ *
+ * DESCRIPTION: Shared memory network
+ **********************************/
+
+#include "ShmNet.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SHM_RING_MASK (SHM_RING_SIZE - 1)
+#define SHM_RECORD(len) (sizeof(shm_rec) + (((len) + 15) & ~15))
+
+/**
+ * Constructor
+ *
+ * Maps the region called name, creating it if this is the first process of the run
+ */
+ShmNet::ShmNet(Params *p, string name) {
+	int fd;
+
+	par = p;
+	this->name = name;
+	nextid = 1;
+	nodes = par->EN_GPSZ;
+	dropped = 0;
+	sent.resize(nodes + 1, 0);
+	recv.resize(nodes + 1, 0);
+	regionSize = (size_t)nodes * nodes * (sizeof(shm_ring) + SHM_RING_SIZE);
+
+	fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	if ( fd < 0 ) {
+		perror("shm_open");
+		exit(1);
+	}
+	if ( ftruncate(fd, regionSize) < 0 ) {
+		perror("ftruncate");
+		exit(1);
+	}
+	region = (char *)mmap(NULL, regionSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if ( region == MAP_FAILED ) {
+		perror("mmap");
+		exit(1);
+	}
+	close(fd);
+}
+
+/**
+ * Destructor
+ */
+ShmNet::~ShmNet() {}
+
+/**
+ * FUNCTION NAME: ring
+ *
+ * DESCRIPTION: Ring number index; the ring from node i to node j is (i - 1) * nodes + j - 1
+ */
+shm_ring *ShmNet::ring(int index) {
+	return (shm_ring *)(region + (size_t)index * (sizeof(shm_ring) + SHM_RING_SIZE));
+}
+
+/**
+ * FUNCTION NAME: ringData
+ *
+ * DESCRIPTION: Records of a ring
+ */
+char *ShmNet::ringData(shm_ring *r) {
+	return (char *)(r + 1);
+}
+
+/**
+ * FUNCTION NAME: ENinit
+ *
+ * DESCRIPTION: Give this node the next id
+ */
+void *ShmNet::ENinit(Address *myaddr, short port) {
+	*(int *)(myaddr->addr) = nextid++;
+	*(short *)(&myaddr->addr[4]) = 0;
+	return myaddr;
+}
+
+/**
+ * FUNCTION NAME: ENsendv
+ *
+ * DESCRIPTION: Write the payload into the ring to each of n destinations, with
+ * 				the destination's patch applied. A destination whose ring has no
+ * 				room for the record loses the message.
+ *
+ * RETURNS:
+ * number of destinations the payload was written for
+ */
+int ShmNet::ENsendv(Address *myaddr, Address *toaddrs, int n, char *data, int size, en_patch *patches) {
+	int from = *(int *)(myaddr->addr);
+	int accepted = 0;
+
+	for ( int i = 0; i < n; i++ ) {
+		int to = *(int *)(toaddrs[i].addr);
+
+		if ( from < 1 || from > nodes || to < 1 || to > nodes || size > par->MAX_MSG_SIZE ) {
+			dropped++;
+			continue;
+		}
+		// the test case's message loss applies on top of the rings
+		if ( par->dropmsg && rand() % 100 < (int) (par->MSG_DROP_PROB * 100) ) {
+			dropped++;
+			continue;
+		}
+
+		int index = (from - 1) * nodes + to - 1;
+		shm_ring *r = ring(index);
+		char *buf = ringData(r);
+		uint32_t tail = r->tail;
+		uint32_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+		uint32_t need = SHM_RECORD(size);
+		uint32_t off = tail & SHM_RING_MASK;
+		// a record never wraps; the end of the ring is skipped instead
+		uint32_t skip = (off + need > SHM_RING_SIZE) ? SHM_RING_SIZE - off : 0;
+
+		if ( tail - head + skip + need > SHM_RING_SIZE ) {
+			dropped++;
+			continue;
+		}
+		if ( skip ) {
+			((shm_rec *)(buf + off))->len = SHM_WRAP;
+			tail += skip;
+			off = 0;
+		}
+
+		shm_rec *rec = (shm_rec *)(buf + off);
+		rec->len = size;
+		rec->ring = index;
+		rec->released = 0;
+		memcpy(rec + 1, data, size);
+		if ( patches != NULL && patches[i].len > 0 ) {
+			memcpy((char *)(rec + 1) + patches[i].offset, patches[i].bytes, patches[i].len);
+		}
+		__atomic_store_n(&r->tail, tail + need, __ATOMIC_RELEASE);
+		notify(to, par->getcurrtime());
+
+		sent[from]++;
+		accepted++;
+	}
+
+	return accepted;
+}
+
+/**
+ * FUNCTION NAME: ENrecv
+ *
+ * DESCRIPTION: Hand every record written to this node since the last call to
+ * 				the queue, in place in the ring
+ *
+ * RETURN:
+ * 0
+ */
+int ShmNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue) {
+	// times is always assumed to be 1
+	int id = *(int *)(myaddr->addr);
+
+	if ( id < 1 || id > nodes ) {
+		return 0;
+	}
+
+	for ( int from = 1; from <= nodes; from++ ) {
+		shm_ring *r = ring((from - 1) * nodes + id - 1);
+		char *buf = ringData(r);
+		uint32_t tail = __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+
+		while ( r->read != tail ) {
+			shm_rec *rec = (shm_rec *)(buf + (r->read & SHM_RING_MASK));
+			if ( rec->len == SHM_WRAP ) {
+				r->read += SHM_RING_SIZE - (r->read & SHM_RING_MASK);
+				continue;
+			}
+			r->read += SHM_RECORD(rec->len);
+			(*enq)(queue, (char *)(rec + 1), rec->len);
+			recv[id]++;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: ENrelease
+ *
+ * DESCRIPTION: Give back a record handed out by ENrecv. The sender may reuse
+ * 				the space once every older record of the ring is given back too.
+ */
+void ShmNet::ENrelease(char *data) {
+	shm_rec *rec = (shm_rec *)data - 1;
+	shm_ring *r = ring(rec->ring);
+	char *buf = ringData(r);
+	uint32_t head = r->head;
+
+	rec->released = 1;
+	while ( head != r->read ) {
+		rec = (shm_rec *)(buf + (head & SHM_RING_MASK));
+		if ( rec->len == SHM_WRAP ) {
+			head += SHM_RING_SIZE - (head & SHM_RING_MASK);
+		}
+		else if ( rec->released ) {
+			head += SHM_RECORD(rec->len);
+		}
+		else {
+			break;
+		}
+	}
+	__atomic_store_n(&r->head, head, __ATOMIC_RELEASE);
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Unmap and remove the region. Called exactly once at the end of the program.
+ */
+int ShmNet::ENcleanup() {
+	FILE* file = fopen("msgcount.log", "w+");
+
+	for ( int i = 1; i <= nodes; i++ ) {
+		fprintf(file, "node %3d sent_total %6ld  recv_total %6ld\n", i, sent[i], recv[i]);
+	}
+	fprintf(file, "shm: dropped %ld\n", dropped.load());
+	fclose(file);
+
+	munmap(region, regionSize);
+	shm_unlink(name.c_str());
+	nextid = 1;
+	return 0;
+}
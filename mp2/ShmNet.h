@@ -0,0 +1,85 @@
+/**********************************
+ * FILE NAME: ShmNet.h
+ *
+ * DESCRIPTION: Header file of the shared memory network
+ **********************************/
+
+#ifndef _SHMNET_H_
+#define _SHMNET_H_
+
+// bytes of every ring, a power of two
+#define SHM_RING_SIZE 65536
+#define SHM_WRAP 0xffffffffu
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+#include "Transport.h"
+#include <stdint.h>
+
+/**
+ * Struct Name: shm_ring
+ *
+ * DESCRIPTION: Single producer single consumer ring from one node to another,
+ * 				followed by SHM_RING_SIZE bytes of records. Positions only grow;
+ * 				a record sits at position & (SHM_RING_SIZE - 1).
+ */
+typedef struct shm_ring {
+	// end of the last record written, written by the sender only
+	uint32_t tail;
+	char pad1[60];
+	// oldest record the receiver still holds, written by the receiver only
+	uint32_t head;
+	// next record to hand to the receiver, used by the receiver only
+	uint32_t read;
+	char pad2[56];
+}shm_ring;
+
+/**
+ * Struct Name: shm_rec
+ *
+ * DESCRIPTION: Header of a record in a ring; the payload follows it. A record
+ * 				of length SHM_WRAP fills the end of the ring and is skipped.
+ */
+typedef struct shm_rec {
+	uint32_t len;
+	uint32_t ring;
+	uint32_t released;
+	uint32_t pad;
+}shm_rec;
+
+/**
+ * CLASS NAME: ShmNet
+ *
+ * DESCRIPTION: Nodes talk through rings in a shm_open region, one ring per
+ * 				ordered pair of nodes, so any process that maps the region and
+ * 				initializes its nodes in the same order can join the run. The
+ * 				sender writes the payload straight into the receiver's ring and
+ * 				ENrecv hands it out in place; the space is reused once the
+ * 				receiver gives it back with ENrelease.
+ */
+class ShmNet : public Transport
+{
+private:
+	Params *par;
+	string name;
+	int nextid;
+	int nodes;
+	char *region;
+	size_t regionSize;
+	vector<long> sent;
+	vector<long> recv;
+	atomic<long> dropped;
+	shm_ring *ring(int index);
+	char *ringData(shm_ring *r);
+public:
+	ShmNet(Params *p, string name);
+	virtual ~ShmNet();
+	void *ENinit(Address *myaddr, short port);
+	int ENsendv(Address *myaddr, Address *toaddrs, int n, char *data, int size, en_patch *patches);
+	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	void ENrelease(char *data);
+	int ENcleanup();
+};
+
+#endif /* _SHMNET_H_ */
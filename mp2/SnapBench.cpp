@@ -0,0 +1,125 @@
+/**********************************
+ * FILE NAME: SnapBench.cpp
+ *
+ * DESCRIPTION: Benchmark of restarting a node's hash table: time to the first
+ * 				read when it maps a snapshot and replays the small log written
+ * 				since, against replaying a log of every key, and the time of
+ * 				random reads right after
+ **********************************/
+
+#include "stdincludes.h"
+#include "HashTable.h"
+
+/**
+ * Macros
+ */
+#define BENCH_VALUE "value01234567890123456"
+// entries changed after the checkpoint
+#define BENCH_DELTA 1000
+#define BENCH_READS 100000
+
+/**
+ * FUNCTION NAME: keyOf
+ *
+ * DESCRIPTION: The i-th key
+ */
+static string keyOf(long i) {
+	char key[32];
+	snprintf(key, sizeof(key), "key%012ld", i);
+	return key;
+}
+
+/**
+ * FUNCTION NAME: load
+ *
+ * DESCRIPTION: Fill a table of keys keys logged to dir/name.wal. With a
+ * 				snapshot, checkpoint it into dir/name.snap and change
+ * 				BENCH_DELTA entries after, which only the log has.
+ */
+static void load(const string &dir, const string &name, long keys, bool snapshot) {
+	HashTable *table = new HashTable();
+	WriteAheadLog *wal = new WriteAheadLog(dir, name + ".wal", NO_SYNC);
+
+	if ( snapshot ) {
+		table->openSnapshot(dir + "/" + name + ".snap");
+	}
+	table->attachLog(wal);
+	for ( long i = 0; i < keys; i++ ) {
+		table->create(keyOf(i), BENCH_VALUE);
+		if ( i % 4096 == 0 ) {
+			wal->commit();
+		}
+	}
+	wal->commit();
+	if ( snapshot ) {
+		table->checkpoint();
+		for ( long i = 0; i < BENCH_DELTA; i++ ) {
+			table->update(keyOf(i * (keys / BENCH_DELTA)), "changed012345678901234");
+		}
+		wal->commit();
+	}
+	delete table;
+	delete wal;
+}
+
+/**
+ * FUNCTION NAME: restart
+ *
+ * DESCRIPTION: Open the table left by load the way a restarted node does, time
+ * 				it up to its first read, then time BENCH_READS random reads
+ */
+static void restart(const string &dir, const string &name, long keys, bool snapshot) {
+	unsigned int seed = 1;
+	long found = 0;
+
+	auto start = chrono::steady_clock::now();
+	HashTable *table = new HashTable();
+	WriteAheadLog *wal = new WriteAheadLog(dir, name + ".wal", NO_SYNC);
+	if ( snapshot ) {
+		table->openSnapshot(dir + "/" + name + ".snap");
+	}
+	long replayed = table->attachLog(wal);
+	found += !table->read(keyOf(keys / 2)).empty();
+	double firstRead = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+	start = chrono::steady_clock::now();
+	for ( long i = 0; i < BENCH_READS; i++ ) {
+		found += !table->read(keyOf(rand_r(&seed) % keys)).empty();
+	}
+	double reads = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / BENCH_READS;
+
+	printf("%-9s %10ld %10ld %14.1f %10.2f %8ld\n", snapshot ? "snapshot" : "log", keys, replayed, firstRead, reads, found);
+	delete table;
+	delete wal;
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: SnapBench [keys ...]; the files go in snapbench.<pid> in the
+ * 				current directory, which is removed after. Both restarts find
+ * 				the files in the page cache, as load just wrote them.
+ */
+int main(int argc, char *argv[]) {
+	string dir = "snapbench." + to_string(getpid());
+	vector<long> sizes;
+
+	for ( int i = 1; i < argc; i++ ) {
+		sizes.push_back(atol(argv[i]));
+	}
+	if ( sizes.empty() ) {
+		sizes = {100000, 1000000};
+	}
+	printf("%-9s %10s %10s %14s %10s %8s\n", "restart", "keys", "replayed", "first_read_ms", "read_us", "found");
+	for ( long keys : sizes ) {
+		load(dir, "log", keys, false);
+		restart(dir, "log", keys, false);
+		load(dir, "snap", keys, true);
+		restart(dir, "snap", keys, true);
+		for ( const char *file : {"log.wal", "snap.wal", "snap.snap"} ) {
+			unlink((dir + "/" + file).c_str());
+		}
+	}
+	rmdir(dir.c_str());
+	return 0;
+}
@@ -0,0 +1,283 @@
+/**********************************
+ * FILE NAME: Snapshot.cpp
+ *
+ * DESCRIPTION: Definition of the snapshot files of a node's hash table
+ **********************************/
+
+#include "Snapshot.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * Constructor
+ */
+Snapshot::Snapshot() {
+	base = NULL;
+	length = 0;
+	count = 0;
+	index = NULL;
+}
+
+/**
+ * Destructor
+ */
+Snapshot::~Snapshot() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Map the snapshot at path, closing the one mapped before
+ *
+ * RETURNS:
+ * true if path holds a snapshot
+ * false if it is missing or not one, and nothing is mapped
+ */
+bool Snapshot::open(string path) {
+	struct stat st;
+	snap_header header;
+	int fd;
+	void *map;
+
+	close();
+	fd = ::open(path.c_str(), O_RDONLY);
+	if ( fd < 0 ) {
+		return false;
+	}
+	if ( fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(snap_header) ) {
+		::close(fd);
+		return false;
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	// the mapping keeps the file
+	::close(fd);
+	if ( map == MAP_FAILED ) {
+		return false;
+	}
+	memcpy(&header, map, sizeof(snap_header));
+	if ( memcmp(header.magic, SNAP_MAGIC, sizeof(header.magic)) != 0
+			|| header.indexOffset < sizeof(snap_header) || header.indexOffset % sizeof(unsigned long long) != 0
+			|| header.indexOffset > (size_t)st.st_size
+			|| header.count > ((size_t)st.st_size - header.indexOffset) / sizeof(unsigned long long) ) {
+		munmap(map, st.st_size);
+		return false;
+	}
+	base = (const char *)map;
+	length = st.st_size;
+	count = header.count;
+	index = (const unsigned long long *)(base + header.indexOffset);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Unmap the snapshot, if any
+ */
+void Snapshot::close() {
+	if ( base != NULL ) {
+		munmap((void *)base, length);
+	}
+	base = NULL;
+	length = 0;
+	count = 0;
+	index = NULL;
+}
+
+/**
+ * FUNCTION NAME: recordAt
+ *
+ * DESCRIPTION: Key and value of the i-th record. A record that does not fit
+ * 				in the data part of the file reads as an empty key and value.
+ */
+string_view Snapshot::recordAt(size_t i, string_view &value) {
+	snap_record record;
+	size_t end = (const char *)index - base;
+	unsigned long long at = index[i];
+
+	value = string_view();
+	if ( at < sizeof(snap_header) || at > end - sizeof(snap_record) ) {
+		return string_view();
+	}
+	memcpy(&record, base + at, sizeof(snap_record));
+	at += sizeof(snap_record);
+	if ( record.keylen > end - at || record.valuelen > end - at - record.keylen ) {
+		return string_view();
+	}
+	value = string_view(base + at + record.keylen, record.valuelen);
+	return string_view(base + at, record.keylen);
+}
+
+/**
+ * FUNCTION NAME: find
+ *
+ * DESCRIPTION: Binary search the index for key
+ *
+ * RETURNS:
+ * true and its value in value if the snapshot has key
+ * false otherwise
+ */
+bool Snapshot::find(string_view key, string_view &value) {
+	size_t lo = 0, hi = count;
+
+	while ( lo < hi ) {
+		size_t mid = lo + (hi - lo) / 2;
+		int cmp = recordAt(mid, value).compare(key);
+		if ( cmp == 0 ) {
+			return true;
+		}
+		if ( cmp < 0 ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	value = string_view();
+	return false;
+}
+
+/**
+ * FUNCTION NAME: lowerBound
+ *
+ * RETURNS:
+ * number of the first record whose key is not below key, size() if none
+ */
+size_t Snapshot::lowerBound(string_view key) {
+	size_t lo = 0, hi = count;
+
+	while ( lo < hi ) {
+		size_t mid = lo + (hi - lo) / 2;
+		if ( keyAt(mid) < key ) {
+			lo = mid + 1;
+		}
+		else {
+			hi = mid;
+		}
+	}
+	return lo;
+}
+
+/**
+ * FUNCTION NAME: span
+ *
+ * DESCRIPTION: Bytes of records first to last - 1, their snap_record included.
+ * 				Only reads the index, and the last record when last is size().
+ */
+unsigned long long Snapshot::span(size_t first, size_t last) {
+	string_view value;
+	unsigned long long end;
+
+	if ( first >= last ) {
+		return 0;
+	}
+	if ( last < count ) {
+		end = index[last];
+	}
+	else {
+		// the index block is aligned, so it does not tell where the last record ends
+		recordAt(count - 1, value);
+		end = value.data() != NULL ? value.data() + value.size() - base : index[count - 1];
+	}
+	return end - index[first];
+}
+
+/**
+ * Constructor
+ */
+SnapshotWriter::SnapshotWriter(string path) {
+	snap_header header;
+
+	this->path = path;
+	tmpPath = path + ".tmp";
+	fp = fopen(tmpPath.c_str(), "w");
+	if ( fp == NULL ) {
+		perror("fopen");
+		exit(1);
+	}
+	setvbuf(fp, NULL, _IOFBF, SNAP_WRITE_BUFFER);
+	// written again by finish()
+	memset(&header, 0, sizeof(snap_header));
+	offset = 0;
+	put(&header, sizeof(snap_header));
+}
+
+/**
+ * Destructor
+ *
+ * DESCRIPTION: A writer never finished leaves path as it was
+ */
+SnapshotWriter::~SnapshotWriter() {
+	if ( fp != NULL ) {
+		fclose(fp);
+		unlink(tmpPath.c_str());
+	}
+}
+
+/**
+ * FUNCTION NAME: put
+ */
+void SnapshotWriter::put(const void *data, size_t len) {
+	if ( len > 0 && fwrite(data, 1, len, fp) != len ) {
+		perror("fwrite");
+		exit(1);
+	}
+	offset += len;
+}
+
+/**
+ * FUNCTION NAME: add
+ *
+ * DESCRIPTION: Append a record. Keys must come in increasing order.
+ */
+void SnapshotWriter::add(string_view key, string_view value) {
+	snap_record record;
+
+	record.keylen = key.size();
+	record.valuelen = value.size();
+	offsets.push_back(offset);
+	put(&record, sizeof(snap_record));
+	put(key.data(), key.size());
+	put(value.data(), value.size());
+}
+
+/**
+ * FUNCTION NAME: finish
+ *
+ * DESCRIPTION: Write the index block and the header, sync the file and move it
+ * 				to path
+ *
+ * RETURNS:
+ * number of records written
+ */
+size_t SnapshotWriter::finish() {
+	snap_header header;
+	char pad[sizeof(unsigned long long)] = {0};
+	int dir;
+
+	put(pad, (sizeof(pad) - offset % sizeof(pad)) % sizeof(pad));
+	memcpy(header.magic, SNAP_MAGIC, sizeof(header.magic));
+	header.count = offsets.size();
+	header.indexOffset = offset;
+	put(offsets.data(), offsets.size() * sizeof(unsigned long long));
+	if ( fseek(fp, 0, SEEK_SET) < 0 || fwrite(&header, sizeof(snap_header), 1, fp) != 1
+			|| fflush(fp) != 0 || fdatasync(fileno(fp)) < 0 ) {
+		perror("snapshot");
+		exit(1);
+	}
+	fclose(fp);
+	fp = NULL;
+	if ( rename(tmpPath.c_str(), path.c_str()) < 0 ) {
+		perror("rename");
+		exit(1);
+	}
+	// make the rename itself durable
+	size_t slash = path.rfind('/');
+	dir = ::open(slash == string::npos ? "." : path.substr(0, slash).c_str(), O_RDONLY);
+	if ( dir >= 0 ) {
+		fsync(dir);
+		::close(dir);
+	}
+	return offsets.size();
+}
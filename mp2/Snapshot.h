@@ -0,0 +1,112 @@
+/**********************************
+ * FILE NAME: Snapshot.h
+ *
+ * DESCRIPTION: Header file of the snapshot files of a node's hash table
+ **********************************/
+
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+#include "stdincludes.h"
+
+/*
+ * Macros
+ */
+// first bytes of a snapshot file
+#define SNAP_MAGIC "KVSNAP2"
+// buffer of the writer
+#define SNAP_WRITE_BUFFER (1 << 20)
+
+/**
+ * Struct Name: snap_header
+ *
+ * DESCRIPTION: Start of a snapshot file. The records follow, sorted by key,
+ * 				then at indexOffset the index block: count 64 bit offsets of
+ * 				the records, in the same order.
+ */
+typedef struct snap_header {
+	char magic[8];
+	unsigned long long count;
+	unsigned long long indexOffset;
+}snap_header;
+
+/**
+ * Struct Name: snap_record
+ *
+ * DESCRIPTION: A record of a snapshot, followed by keylen bytes of key and
+ * 				valuelen bytes of value
+ */
+typedef struct snap_record {
+	unsigned int keylen;
+	unsigned int valuelen;
+}snap_record;
+
+/**
+ * CLASS NAME: Snapshot
+ *
+ * DESCRIPTION: A snapshot file mapped read-only. Lookups binary search the
+ * 				index block, so nothing is read or built when it is opened and
+ * 				only the pages a lookup touches are brought in. Keys and values
+ * 				returned point into the mapping and stay valid until close().
+ */
+class Snapshot {
+private:
+	const char *base;
+	size_t length;
+	size_t count;
+	const unsigned long long *index;
+	string_view recordAt(size_t i, string_view &value);
+
+public:
+	Snapshot();
+	Snapshot(const Snapshot &other) = delete;
+	Snapshot &operator=(const Snapshot &other) = delete;
+	virtual ~Snapshot();
+	bool open(string path);
+	void close();
+	bool isOpen() {
+		return base != NULL;
+	}
+	size_t size() {
+		return count;
+	}
+	bool find(string_view key, string_view &value);
+	size_t lowerBound(string_view key);
+	unsigned long long span(size_t first, size_t last);
+	string_view keyAt(size_t i) {
+		string_view value;
+		return recordAt(i, value);
+	}
+	string_view valueAt(size_t i) {
+		string_view value;
+		recordAt(i, value);
+		return value;
+	}
+};
+
+/**
+ * CLASS NAME: SnapshotWriter
+ *
+ * DESCRIPTION: Writes a snapshot file from records added in key order. The file
+ * 				is built under a temporary name and only replaces path, in one
+ * 				rename, once it is complete and on disk.
+ */
+class SnapshotWriter {
+private:
+	FILE *fp;
+	string path;
+	string tmpPath;
+	unsigned long long offset;
+	vector<unsigned long long> offsets;
+	void put(const void *data, size_t len);
+
+public:
+	SnapshotWriter(string path);
+	SnapshotWriter(const SnapshotWriter &other) = delete;
+	SnapshotWriter &operator=(const SnapshotWriter &other) = delete;
+	virtual ~SnapshotWriter();
+	void add(string_view key, string_view value);
+	size_t finish();
+};
+
+#endif /* _SNAPSHOT_H_ */
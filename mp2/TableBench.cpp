@@ -0,0 +1,160 @@
+/**********************************
+ * FILE NAME: TableBench.cpp
+ *
+ * DESCRIPTION: Benchmark of the storage engines of HashTable: time to insert,
+ * 				look up and erase keys, and heap bytes per key, for std::map
+ * 				and FlatTable as the number of keys grows. Keys are 8 hex
+ * 				digits with 8 byte values, or shaped like the test pairs of
+ * 				Application: 5 alphanumeric characters with "valueNN" values
+ **********************************/
+
+#include "stdincludes.h"
+#include "FlatTable.h"
+#include <malloc.h>
+
+/**
+ * Macros
+ */
+#define BENCH_LOOKUPS 1000000
+
+/**
+ * FUNCTION NAME: nowNanos
+ *
+ * RETURNS:
+ * monotonic wall clock time in nanoseconds
+ */
+static long long nowNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * FUNCTION NAME: heapBytes
+ *
+ * RETURNS:
+ * bytes the program has allocated on the heap and not freed, large blocks
+ * that malloc maps on their own included
+ */
+static size_t heapBytes() {
+	struct mallinfo2 info = mallinfo2();
+	return info.uordblks + info.hblkhd;
+}
+
+/**
+ * FUNCTION NAME: keyOf
+ *
+ * DESCRIPTION: The i-th key, 8 hex digits scattered over the key space
+ */
+static string keyOf(long i) {
+	char key[16];
+	snprintf(key, sizeof(key), "%08lx", (i * 2654435761UL) & 0xffffffffUL);
+	return key;
+}
+
+/**
+ * FUNCTION NAME: testKeyOf
+ *
+ * DESCRIPTION: The i-th key shaped like those of Application::initTestKVPairs,
+ * 				KEY_LENGTH characters of alphanum, scattered over the key space
+ */
+static string testKeyOf(long i) {
+	static const char alphanum[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
+	unsigned long code = (i * 2654435761UL) % 916132832UL;
+	string key;
+
+	for ( int j = 0; j < 5; j++ ) {
+		key.push_back(alphanum[code % 62]);
+		code /= 62;
+	}
+	return key;
+}
+
+/**
+ * The engines behind the same three calls
+ */
+static void put(map<string, string> &table, const string &key, const string &value) {
+	table.emplace(key, value);
+}
+
+static bool has(map<string, string> &table, const string &key) {
+	return table.find(key) != table.end();
+}
+
+static void remove(map<string, string> &table, const string &key) {
+	table.erase(key);
+}
+
+static void put(FlatTable &table, const string &key, const string &value) {
+	table.emplace(key, value);
+}
+
+static bool has(FlatTable &table, const string &key) {
+	return table.find(key) != table.end();
+}
+
+static void remove(FlatTable &table, const string &key) {
+	table.erase(key);
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Insert n keys, look up BENCH_LOOKUPS random ones of them, then
+ * 				erase them all, and print the time per operation of each and
+ * 				the heap bytes per key once they are in
+ */
+template <typename Table>
+static void run(const char *engine, long n, bool test) {
+	vector<string> keys, values;
+	unsigned int seed = 1;
+	long found = 0;
+
+	for ( long i = 0; i < n; i++ ) {
+		keys.push_back(test ? testKeyOf(i) : keyOf(i));
+		values.push_back(test ? "value" + to_string(i % 100) : "value678");
+	}
+	size_t before = heapBytes();
+	Table *table = new Table();
+
+	long long start = nowNanos();
+	for ( long i = 0; i < n; i++ ) {
+		put(*table, keys[i], values[i]);
+	}
+	double insert = (double)(nowNanos() - start) / n;
+	double bytes = (double)(heapBytes() - before) / n;
+
+	start = nowNanos();
+	for ( int i = 0; i < BENCH_LOOKUPS; i++ ) {
+		found += has(*table, keys[rand_r(&seed) % n]);
+	}
+	double lookup = (double)(nowNanos() - start) / BENCH_LOOKUPS;
+
+	start = nowNanos();
+	for ( auto &key : keys ) {
+		remove(*table, key);
+	}
+	double erase = (double)(nowNanos() - start) / n;
+	delete table;
+
+	printf("%-6s %10ld %10.1f %10.1f %10.1f %10.1f %8ld\n", engine, n, insert, lookup, erase, bytes, found);
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: TableBench [largest number of keys] [test], 10^3 keys and up
+ * 				by factors of 10; test selects the keys and values of
+ * 				Application's test pairs
+ */
+int main(int argc, char *argv[]) {
+	long largest = argc > 1 ? atol(argv[1]) : 1000000;
+	bool test = argc > 2 && strcmp(argv[2], "test") == 0;
+
+	printf("%-6s %10s %10s %10s %10s %10s %8s\n", "engine", "keys", "insert ns", "lookup ns", "erase ns", "bytes/key", "found");
+	for ( long n = 1000; n <= largest; n *= 10 ) {
+		run<map<string, string> >("map", n, test);
+		run<FlatTable>("flat", n, test);
+	}
+	return 0;
+}
@@ -0,0 +1,84 @@
+/**********************************
+ * FILE NAME: Transport.h
+ *
+ * DESCRIPTION: Interface of the networks the nodes send and receive through
+ **********************************/
+
+#ifndef _TRANSPORT_H_
+#define _TRANSPORT_H_
+
+#include "stdincludes.h"
+#include "Member.h"
+
+/**
+ * Struct Name: en_patch
+ *
+ * DESCRIPTION: Bytes of a multicast payload that differ for one destination
+ */
+typedef struct en_patch {
+	int offset;
+	int len;
+	const char *bytes;
+}en_patch;
+
+/**
+ * CLASS NAME: Transport
+ *
+ * DESCRIPTION: A network the nodes are attached to. ENinit gives a node its
+ * 				address; ENrecv hands every payload addressed to the node to
+ * 				the enqueue callback in place, and the node gives it back with
+ * 				ENrelease once it has handled the message.
+ *
+ * 				A watcher set with ENwatch is told the time every message
+ * 				accepted for a node can first be received by it.
+ */
+class Transport {
+protected:
+	void (* watcher)(void *, int, int);
+	void *watcherArg;
+
+	/**
+	 * FUNCTION NAME: notify
+	 *
+	 * DESCRIPTION: Tell the watcher that node id has something to receive at time
+	 */
+	void notify(int id, int time) {
+		if ( watcher != NULL ) {
+			(*watcher)(watcherArg, id, time);
+		}
+	}
+public:
+	Transport() : watcher(NULL), watcherArg(NULL) {}
+	virtual ~Transport() {}
+	virtual void *ENinit(Address *myaddr, short port) = 0;
+	virtual int ENsendv(Address *myaddr, Address *toaddrs, int n, char *data, int size, en_patch *patches) = 0;
+	virtual int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue) = 0;
+	virtual void ENrelease(char *data) = 0;
+	virtual int ENcleanup() = 0;
+
+	/**
+	 * FUNCTION NAME: ENwatch
+	 *
+	 * DESCRIPTION: Call cb(arg, id, time) for every message that node id can receive
+	 * 				from time on. It is called by the sending thread.
+	 */
+	void ENwatch(void (* cb)(void *, int, int), void *arg) {
+		watcher = cb;
+		watcherArg = arg;
+	}
+
+	/**
+	 * FUNCTION NAME: ENsend
+	 *
+	 * RETURNS:
+	 * size, or 0 if the message was dropped
+	 */
+	int ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
+		return ENsendv(myaddr, toaddr, 1, data, size, NULL) ? size : 0;
+	}
+	int ENsend(Address *myaddr, Address *toaddr, string data) {
+		return ENsend(myaddr, toaddr, (char *)data.data(), (data.length() * sizeof(char)));
+	}
+};
+
+#endif /* _TRANSPORT_H_ */
@@ -0,0 +1,219 @@
+/**********************************
+ * FILE NAME: TransportBench.cpp
+ *
+ * DESCRIPTION: Benchmark of the transports: messages per second per core of
+ * 				the in-process emulator, of UDP on the loopback interface and
+ * 				of the shared memory rings, every node sending the same number
+ * 				of messages per round, and the round trip time of one message
+ **********************************/
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "EmulNet.h"
+#include "UdpNet.h"
+#include "ShmNet.h"
+
+/**
+ * Macros
+ */
+#define BENCH_ROUNDS 2000
+#define BENCH_MSG_SIZE 64
+#define BENCH_UDP_PORT 21000
+#define BENCH_PINGS 20000
+
+/**
+ * FUNCTION NAME: cpuSeconds
+ *
+ * RETURNS:
+ * CPU time of the process so far, on all cores
+ */
+static double cpuSeconds() {
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * FUNCTION NAME: wallNanos
+ *
+ * RETURNS:
+ * monotonic wall clock time in nanoseconds
+ */
+static long long wallNanos() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/**
+ * FUNCTION NAME: enqueue
+ *
+ * DESCRIPTION: Keep the payloads handed out by ENrecv, to give back afterwards
+ */
+static int enqueue(void *env, char *buff, int size) {
+	((vector<char *> *)env)->push_back(buff);
+	return size;
+}
+
+/**
+ * FUNCTION NAME: makeParams
+ *
+ * DESCRIPTION: Read the parameters of a run of nodes nodes, with no message
+ * 				loss, from a temporary config file
+ */
+static void makeParams(Params *par, int nodes) {
+	char config[] = "/tmp/transportbench.XXXXXX";
+	int fd = mkstemp(config);
+	if ( fd < 0 ) {
+		perror("mkstemp");
+		exit(1);
+	}
+	FILE *fp = fdopen(fd, "w");
+	fprintf(fp, "MAX_NNB: %d\nSINGLE_FAILURE: 0\nDROP_MSG: 0\nMSG_DROP_PROB: 0\nCRUD_TEST: CREATE\nSEED: 1\n", nodes);
+	fclose(fp);
+	par->setparams(config);
+	unlink(config);
+}
+
+/**
+ * FUNCTION NAME: attach
+ *
+ * RETURNS:
+ * the addresses of nodes nodes attached to net, indexed from 1
+ */
+static vector<Address> attach(Params *par, Transport *net, int nodes) {
+	vector<Address> addrs(nodes + 1);
+	for ( int i = 1; i <= nodes; i++ ) {
+		net->ENinit(&addrs[i], par->PORTNUM);
+	}
+	return addrs;
+}
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: BENCH_ROUNDS rounds of the nodes at addrs, each sending perNode
+ * 				messages to random other nodes, then every node receiving
+ *
+ * RETURNS:
+ * messages received per CPU second; lost is set to the messages sent but
+ * never received
+ */
+static double run(Params *par, Transport *net, vector<Address> &addrs, int perNode, long *lost) {
+	int nodes = addrs.size() - 1;
+	char data[BENCH_MSG_SIZE];
+	memset(data, 'x', sizeof(data));
+	vector<char *> received;
+	unsigned int seed = 1;
+	long messages = 0;
+	double start = cpuSeconds();
+	for ( int t = 1; t <= BENCH_ROUNDS; t++ ) {
+		par->globaltime = t;
+		for ( int i = 1; i <= nodes; i++ ) {
+			for ( int k = 0; k < perNode; k++ ) {
+				int to = 1 + (i + rand_r(&seed) % (nodes - 1)) % nodes;
+				net->ENsend(&addrs[i], &addrs[to], data, sizeof(data));
+			}
+		}
+		for ( int i = 1; i <= nodes; i++ ) {
+			net->ENrecv(&addrs[i], enqueue, NULL, 1, &received);
+			messages += received.size();
+			for ( auto &it : received ) {
+				net->ENrelease(it);
+			}
+			received.clear();
+		}
+	}
+	double seconds = cpuSeconds() - start;
+	*lost = (long)BENCH_ROUNDS * nodes * perNode - messages;
+	return messages / seconds;
+}
+
+/**
+ * FUNCTION NAME: receiveOne
+ *
+ * DESCRIPTION: Poll node at until a message arrives, and give it back
+ */
+static void receiveOne(Transport *net, Address *at, vector<char *> &received) {
+	while ( received.empty() ) {
+		net->ENrecv(at, enqueue, NULL, 1, &received);
+	}
+	for ( auto &it : received ) {
+		net->ENrelease(it);
+	}
+	received.clear();
+}
+
+/**
+ * FUNCTION NAME: pingPong
+ *
+ * DESCRIPTION: BENCH_PINGS round trips of one message from the first node at
+ * 				addrs to the second and back, each side polling for it
+ *
+ * RETURNS:
+ * the median round trip in nanoseconds; p99 is set to the 99th percentile
+ */
+static long long pingPong(Transport *net, vector<Address> &addrs, long long *p99) {
+	char data[BENCH_MSG_SIZE];
+	memset(data, 'x', sizeof(data));
+	vector<char *> received;
+	vector<long long> trips(BENCH_PINGS);
+	for ( int i = 0; i < BENCH_PINGS; i++ ) {
+		long long start = wallNanos();
+		net->ENsend(&addrs[1], &addrs[2], data, sizeof(data));
+		receiveOne(net, &addrs[2], received);
+		net->ENsend(&addrs[2], &addrs[1], data, sizeof(data));
+		receiveOne(net, &addrs[1], received);
+		trips[i] = wallNanos() - start;
+	}
+	sort(trips.begin(), trips.end());
+	*p99 = trips[BENCH_PINGS * 99 / 100];
+	return trips[BENCH_PINGS / 2];
+}
+
+/**
+ * FUNCTION NAME: report
+ *
+ * DESCRIPTION: Run both measurements on net and print a line of results
+ */
+static void report(Params *par, Transport *net, const char *backend, int nodes, int perNode) {
+	vector<Address> addrs = attach(par, net, nodes);
+	long lost;
+	long long p50, p99;
+	double rate = run(par, net, addrs, perNode, &lost);
+
+	p50 = pingPong(net, addrs, &p99);
+	printf("%8s %8d %8d %16.0f %8ld %10lld %10lld\n", backend, nodes, perNode, rate, lost, p50, p99);
+	net->ENcleanup();
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: TransportBench [nodes [messages per node per round]]
+ */
+int main(int argc, char *argv[]) {
+	int nodes = argc > 1 ? atoi(argv[1]) : 10;
+	int perNode = argc > 2 ? atoi(argv[2]) : 16;
+	Params par;
+
+	if ( nodes < 2 ) {
+		fprintf(stderr, "TransportBench needs at least 2 nodes\n");
+		exit(1);
+	}
+	makeParams(&par, nodes);
+	printf("%8s %8s %8s %16s %8s %10s %10s\n", "backend", "nodes", "msgs", "msgs/s/core", "lost", "rtt p50ns", "rtt p99ns");
+
+	EmulNet *emul = new EmulNet(&par);
+	report(&par, emul, "EMUL", nodes, perNode);
+	delete emul;
+
+	UdpNet *udp = new UdpNet(&par, BENCH_UDP_PORT);
+	report(&par, udp, "UDP", nodes, perNode);
+	delete udp;
+
+	ShmNet *shm = new ShmNet(&par, "/transportbench." + to_string(getpid()));
+	report(&par, shm, "SHM", nodes, perNode);
+	delete shm;
+	return 0;
+}
@@ -0,0 +1,297 @@
+/**********************************
+ * FILE NAME: UdpNet.cpp
+ *
+ * DESCRIPTION: UDP network on the loopback interface
+ **********************************/
+
+#include "UdpNet.h"
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/**
+ * Constructor
+ */
+UdpNet::UdpNet(Params *p, int basePort) {
+	par = p;
+	nextid = 1;
+	this->basePort = basePort;
+	sendCalls = 0;
+	recvCalls = 0;
+	dropped = 0;
+}
+
+/**
+ * Destructor
+ */
+UdpNet::~UdpNet() {}
+
+/**
+ * FUNCTION NAME: getBuffer
+ *
+ * DESCRIPTION: A MAX_MSG_SIZE buffer for an outgoing or incoming datagram
+ */
+char *UdpNet::getBuffer() {
+	if ( freeBuffers.empty() ) {
+		return (char *)malloc(par->MAX_MSG_SIZE);
+	}
+	char *buf = freeBuffers.back();
+	freeBuffers.pop_back();
+	return buf;
+}
+
+/**
+ * FUNCTION NAME: ENinit
+ *
+ * DESCRIPTION: Give this node the next id and bind its socket to basePort + id
+ */
+void *UdpNet::ENinit(Address *myaddr, short port) {
+	int id = nextid++;
+	int fd, rcvbuf = UDP_RCVBUF;
+	struct sockaddr_in sa;
+
+	*(int *)(myaddr->addr) = id;
+	*(short *)(&myaddr->addr[4]) = 0;
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if ( fd < 0 ) {
+		perror("socket");
+		exit(1);
+	}
+	memset(&sa, 0, sizeof(sa));
+	sa.sin_family = AF_INET;
+	sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sa.sin_port = htons(basePort + id);
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	if ( bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ) {
+		perror("bind");
+		exit(1);
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	if ( id >= (int)sockets.size() ) {
+		sockets.resize(id + 1, -1);
+		pending.resize(id + 1);
+		pendingBuffers.resize(id + 1);
+		sent.resize(id + 1, 0);
+		recv.resize(id + 1, 0);
+	}
+	sockets[id] = fd;
+	return myaddr;
+}
+
+/**
+ * FUNCTION NAME: ENsendv
+ *
+ * DESCRIPTION: Queue one payload for n destinations. The payload is copied once
+ * 				and shared by every destination without a patch; a destination
+ * 				with a patch gets its own copy. The datagrams are written by the
+ * 				next flush of the sender, at the latest on the next ENrecv.
+ *
+ * RETURNS:
+ * number of destinations the payload was accepted for
+ */
+int UdpNet::ENsendv(Address *myaddr, Address *toaddrs, int n, char *data, int size, en_patch *patches) {
+	int from = *(int *)(myaddr->addr);
+	char *body = NULL;
+	int accepted = 0;
+	int i;
+
+	lock_guard<mutex> guard(lock);
+	if ( from >= (int)sockets.size() || sockets[from] < 0 || size > par->MAX_MSG_SIZE ) {
+		dropped += n;
+		return 0;
+	}
+
+	if ( pending[from].empty() ) {
+		dirty.push_back(from);
+	}
+	for ( i = 0; i < n; i++ ) {
+		udp_out out;
+		// the test case's message loss applies on top of the real network
+		if ( par->dropmsg && rand() % 100 < (int) (par->MSG_DROP_PROB * 100) ) {
+			dropped++;
+			continue;
+		}
+		out.to = *(int *)(toaddrs[i].addr);
+		out.size = size;
+		if ( patches != NULL && patches[i].len > 0 ) {
+			out.data = getBuffer();
+			memcpy(out.data, data, size);
+			memcpy(out.data + patches[i].offset, patches[i].bytes, patches[i].len);
+			pendingBuffers[from].push_back(out.data);
+		}
+		else {
+			if ( body == NULL ) {
+				body = getBuffer();
+				memcpy(body, data, size);
+				pendingBuffers[from].push_back(body);
+			}
+			out.data = body;
+		}
+		pending[from].push_back(out);
+		notify(out.to, par->getcurrtime());
+		sent[from]++;
+		accepted++;
+	}
+
+	if ( (int)pending[from].size() >= UDP_BATCH ) {
+		flush(from);
+	}
+	return accepted;
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Write the pending datagrams of one sender, UDP_BATCH per sendmmsg.
+ * 				Datagrams the socket has no room for are dropped, as the kernel
+ * 				would drop them on a real network.
+ */
+void UdpNet::flush(int from) {
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec iovs[UDP_BATCH];
+	struct sockaddr_in addrs[UDP_BATCH];
+	vector<udp_out> &out = pending[from];
+	int done = 0;
+	int i, n, rc;
+
+	while ( done < (int)out.size() ) {
+		n = min((int)out.size() - done, UDP_BATCH);
+		memset(msgs, 0, n * sizeof(struct mmsghdr));
+		for ( i = 0; i < n; i++ ) {
+			udp_out &o = out[done + i];
+			memset(&addrs[i], 0, sizeof(struct sockaddr_in));
+			addrs[i].sin_family = AF_INET;
+			addrs[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			addrs[i].sin_port = htons(basePort + o.to);
+			iovs[i].iov_base = o.data;
+			iovs[i].iov_len = o.size;
+			msgs[i].msg_hdr.msg_name = &addrs[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		rc = sendmmsg(sockets[from], msgs, n, 0);
+		sendCalls++;
+		if ( rc <= 0 ) {
+			if ( rc < 0 && errno == EINTR ) {
+				continue;
+			}
+			// nothing more fits (or the peer is gone): drop the one at the head
+			rc = 1;
+			dropped++;
+		}
+		done += rc;
+	}
+
+	out.clear();
+	for ( i = 0; i < (int)pendingBuffers[from].size(); i++ ) {
+		freeBuffers.push_back(pendingBuffers[from][i]);
+	}
+	pendingBuffers[from].clear();
+}
+
+/**
+ * FUNCTION NAME: flushAll
+ *
+ * DESCRIPTION: Write the pending datagrams of every sender
+ */
+void UdpNet::flushAll() {
+	for ( unsigned int i = 0; i < dirty.size(); i++ ) {
+		if ( !pending[dirty[i]].empty() ) {
+			flush(dirty[i]);
+		}
+	}
+	dirty.clear();
+}
+
+/**
+ * FUNCTION NAME: ENrecv
+ *
+ * DESCRIPTION: Read every datagram waiting on the node's socket, UDP_BATCH per
+ * 				recvmmsg, into buffers that are handed to the queue in place.
+ * 				The node gives each back with ENrelease.
+ *
+ * RETURN:
+ * 0
+ */
+int UdpNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue) {
+	// times is always assumed to be 1
+	int id = *(int *)(myaddr->addr);
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec iovs[UDP_BATCH];
+	char *bufs[UDP_BATCH];
+	int i, rc;
+
+	lock_guard<mutex> guard(lock);
+	flushAll();
+	if ( id >= (int)sockets.size() || sockets[id] < 0 ) {
+		return 0;
+	}
+
+	for ( i = 0; i < UDP_BATCH; i++ ) {
+		bufs[i] = getBuffer();
+	}
+	do {
+		memset(msgs, 0, sizeof(msgs));
+		for ( i = 0; i < UDP_BATCH; i++ ) {
+			iovs[i].iov_base = bufs[i];
+			iovs[i].iov_len = par->MAX_MSG_SIZE;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+		rc = recvmmsg(sockets[id], msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+		recvCalls++;
+		for ( i = 0; i < rc; i++ ) {
+			(*enq)(queue, bufs[i], msgs[i].msg_len);
+			recv[id]++;
+			bufs[i] = getBuffer();
+		}
+	} while ( rc == UDP_BATCH || (rc < 0 && errno == EINTR) );
+
+	for ( i = 0; i < UDP_BATCH; i++ ) {
+		freeBuffers.push_back(bufs[i]);
+	}
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: ENrelease
+ *
+ * DESCRIPTION: Give back the payload of a message handed out by ENrecv
+ */
+void UdpNet::ENrelease(char *data) {
+	lock_guard<mutex> guard(lock);
+	freeBuffers.push_back(data);
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Close the sockets. Called exactly once at the end of the program.
+ */
+int UdpNet::ENcleanup() {
+	unsigned int i;
+	FILE* file = fopen("msgcount.log", "w+");
+
+	flushAll();
+	for ( i = 0; i < sockets.size(); i++ ) {
+		if ( sockets[i] < 0 ) {
+			continue;
+		}
+		close(sockets[i]);
+		sockets[i] = -1;
+		fprintf(file, "node %3d sent_total %6ld  recv_total %6ld\n", i, sent[i], recv[i]);
+	}
+	fprintf(file, "udp: sendmmsg calls %ld  recvmmsg calls %ld  dropped %ld\n", sendCalls, recvCalls, dropped);
+	fclose(file);
+
+	for ( i = 0; i < freeBuffers.size(); i++ ) {
+		free(freeBuffers[i]);
+	}
+	freeBuffers.clear();
+	nextid = 1;
+	return 0;
+}
@@ -0,0 +1,76 @@
+/**********************************
+ * FILE NAME: UdpNet.h
+ *
+ * DESCRIPTION: Header file of the UDP network on the loopback interface
+ **********************************/
+
+#ifndef _UDPNET_H_
+#define _UDPNET_H_
+
+// datagrams moved per sendmmsg/recvmmsg call
+#define UDP_BATCH 64
+#define UDP_RCVBUF (4 * 1024 * 1024)
+
+#include "stdincludes.h"
+#include "Params.h"
+#include "Member.h"
+#include "Transport.h"
+
+/**
+ * Struct Name: udp_out
+ *
+ * DESCRIPTION: A datagram waiting for the next sendmmsg of its sender
+ */
+typedef struct udp_out {
+	int to;
+	int size;
+	char *data;
+}udp_out;
+
+/**
+ * CLASS NAME: UdpNet
+ *
+ * DESCRIPTION: Nodes talk over non-blocking UDP sockets bound to 127.0.0.1.
+ * 				Node n listens on basePort + n, so nodes of one run may live in
+ * 				different processes as long as they are initialized in the same
+ * 				order. Sends are collected per sender and written with one
+ * 				sendmmsg per UDP_BATCH datagrams; receives read a batch with one
+ * 				recvmmsg straight into the buffers handed to the node.
+ */
+class UdpNet : public Transport
+{
+private:
+	Params *par;
+	// guards everything below; nodes may run on different threads
+	mutex lock;
+	int nextid;
+	int basePort;
+	// socket of every node initialized here, by node id (-1 if none)
+	vector<int> sockets;
+	// datagrams not written yet, by sender id
+	vector< vector<udp_out> > pending;
+	// payloads the pending datagrams point into, freed once they are written
+	vector< vector<char *> > pendingBuffers;
+	// senders with pending datagrams
+	vector<int> dirty;
+	// receive buffers of MAX_MSG_SIZE bytes not held by any node
+	vector<char *> freeBuffers;
+	vector<long> sent;
+	vector<long> recv;
+	long sendCalls;
+	long recvCalls;
+	long dropped;
+	char *getBuffer();
+	void flush(int from);
+	void flushAll();
+public:
+	UdpNet(Params *p, int basePort);
+	virtual ~UdpNet();
+	void *ENinit(Address *myaddr, short port);
+	int ENsendv(Address *myaddr, Address *toaddrs, int n, char *data, int size, en_patch *patches);
+	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
+	void ENrelease(char *data);
+	int ENcleanup();
+};
+
+#endif /* _UDPNET_H_ */
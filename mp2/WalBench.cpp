@@ -0,0 +1,70 @@
+/**********************************
+ * FILE NAME: WalBench.cpp
+ *
+ * DESCRIPTION: Benchmark of the write-ahead log: append throughput of 37 byte
+ * 				records under each sync policy, committing a batch of records
+ * 				at a time
+ **********************************/
+
+#include "stdincludes.h"
+#include "WriteAheadLog.h"
+
+/**
+ * Macros
+ */
+// a 16 byte wal_record, a 5 byte key and a 16 byte value: 37 bytes
+#define BENCH_KEY "IMIXg"
+#define BENCH_VALUE "value01234567890"
+#define BENCH_SECONDS 2.0
+
+/**
+ * FUNCTION NAME: run
+ *
+ * DESCRIPTION: Append records to a fresh log under dir for BENCH_SECONDS,
+ * 				committing every batch records, and print the records and
+ * 				commits per second
+ */
+static void run(const string &dir, const char *name, int syncPolicy, int batch) {
+	WriteAheadLog *wal = new WriteAheadLog(dir, "bench.wal", syncPolicy);
+	long appended = 0;
+	double seconds;
+
+	wal->reset();
+	auto start = chrono::steady_clock::now();
+	do {
+		for ( int i = 0; i < batch; i++ ) {
+			wal->append(WAL_PUT, BENCH_KEY, BENCH_VALUE);
+		}
+		wal->commit();
+		appended += batch;
+		seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	} while ( seconds < BENCH_SECONDS );
+
+	printf("%-6s %6d %12.0f %12.0f %8.1f\n", name, batch, appended / seconds, wal->getCommits() / seconds,
+			(double)wal->getBytes() / wal->getRecords());
+	delete wal;
+	unlink((dir + "/bench.wal").c_str());
+}
+
+/**
+ * FUNCTION NAME: main
+ *
+ * DESCRIPTION: WalBench [dir]; the log goes in dir, by default
+ * 				walbench.<pid> in the current directory, which is removed after
+ */
+int main(int argc, char *argv[]) {
+	string dir = argc > 1 ? argv[1] : "walbench." + to_string(getpid());
+
+	printf("%-6s %6s %12s %12s %8s\n", "sync", "batch", "records/s", "commits/s", "bytes");
+	for ( int batch : {1, 16, 256} ) {
+		run(dir, "NONE", NO_SYNC, batch);
+	}
+	for ( int batch : {1, 16, 256} ) {
+		run(dir, "GROUP", GROUP_SYNC, batch);
+	}
+	for ( int batch : {1, 16, 256} ) {
+		run(dir, "EVERY", EVERY_SYNC, batch);
+	}
+	rmdir(dir.c_str());
+	return 0;
+}
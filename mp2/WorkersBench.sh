@@ -0,0 +1,49 @@
+#!/bin/bash
+
+#################################################
+# FILE NAME: WorkersBench.sh
+#
+# DESCRIPTION: Scaling of the simulator with its worker threads: wall time of
+#              the CREATE test case at each node count and worker count, the
+#              speedup over one worker, and whether dbg.log came out the same
+#
+# RUN PROCEDURE:
+# $ make
+# $ ./WorkersBench.sh [-n "1000 10000"] [-w "1 2 4 8"]
+#################################################
+
+NODES="1000 10000"
+WORKERS="1 2 4 8"
+while getopts "n:w:" opt
+do
+	case $opt in
+		n) NODES=$OPTARG ;;
+		w) WORKERS=$OPTARG ;;
+		*) echo "usage: $0 [-n nodes] [-w workers]"; exit 1 ;;
+	esac
+done
+
+CONF=$(mktemp)
+REF=$(mktemp)
+trap 'rm -f $CONF $REF' EXIT
+
+printf "%8s %8s %10s %8s %8s\n" "nodes" "workers" "wall_s" "speedup" "dbg.log"
+for nodes in $NODES
+do
+	base=""
+	for workers in $WORKERS
+	do
+		sed "s/^MAX_NNB: .*/MAX_NNB: $nodes/" testcases/create.conf > $CONF
+		printf "WORKERS: $workers\nSEED: 1\n" >> $CONF
+		start=$(date +%s%N)
+		./Application $CONF > /dev/null 2>&1
+		end=$(date +%s%N)
+		wall=$(awk "BEGIN { print ($end - $start) / 1e9 }")
+		if [ -z "$base" ]; then
+			base=$wall
+			cp dbg.log $REF
+		fi
+		same=$(cmp -s dbg.log $REF && echo same || echo DIFF)
+		printf "%8d %8d %10.2f %8.2f %8s\n" $nodes $workers $wall $(awk "BEGIN { print $base / $wall }") $same
+	done
+done
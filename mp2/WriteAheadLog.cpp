@@ -0,0 +1,192 @@
+/**********************************
+ * FILE NAME: WriteAheadLog.cpp
+ *
+ * DESCRIPTION: Definition of the write-ahead log of a node's hash table
+ **********************************/
+
+#include "WriteAheadLog.h"
+#include <errno.h>
+#include <sys/stat.h>
+
+/**
+ * Constructor
+ *
+ * DESCRIPTION: Open (or create) the log dir/name. dir is created if missing.
+ * 				Nothing is read until replay().
+ */
+WriteAheadLog::WriteAheadLog(string dir, string name, int syncPolicy) {
+	this->syncPolicy = syncPolicy;
+	pendingRecords = 0;
+	records = 0;
+	commits = 0;
+	syncs = 0;
+	bytes = 0;
+	if ( mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST ) {
+		perror("mkdir");
+		exit(1);
+	}
+	path = dir + "/" + name;
+	fd = open(path.c_str(), O_CREAT | O_RDWR | O_APPEND, 0644);
+	if ( fd < 0 ) {
+		perror("open");
+		exit(1);
+	}
+}
+
+/**
+ * Destructor
+ */
+WriteAheadLog::~WriteAheadLog() {
+	commit();
+	close(fd);
+}
+
+/**
+ * FUNCTION NAME: checksum
+ *
+ * DESCRIPTION: FNV-1a over data, continuing from hash
+ */
+unsigned int WriteAheadLog::checksum(const char *data, size_t len, unsigned int hash) {
+	for ( size_t i = 0; i < len; i++ ) {
+		hash = (hash ^ (unsigned char)data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+/**
+ * FUNCTION NAME: replay
+ *
+ * DESCRIPTION: Call apply for every record in the log, oldest first. The log
+ * 				ends at the first record that is cut short or fails its
+ * 				checksum, the tail of a write a crash interrupted; it is cut
+ * 				off so new records follow the last whole one.
+ *
+ * RETURNS:
+ * number of records applied
+ */
+long WriteAheadLog::replay(void (*apply)(void *env, int op, string_view key, string_view value), void *env) {
+	string data;
+	char chunk[WAL_READ_CHUNK];
+	ssize_t n;
+	size_t pos = 0;
+	long applied = 0;
+	wal_record header;
+
+	lseek(fd, 0, SEEK_SET);
+	while ( (n = read(fd, chunk, sizeof(chunk))) != 0 ) {
+		if ( n < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			perror("read");
+			exit(1);
+		}
+		data.append(chunk, n);
+	}
+	while ( data.size() - pos >= sizeof(wal_record) ) {
+		memcpy(&header, data.data() + pos, sizeof(wal_record));
+		if ( header.keylen > data.size() - pos - sizeof(wal_record)
+				|| header.valuelen > data.size() - pos - sizeof(wal_record) - header.keylen ) {
+			break;
+		}
+		size_t len = sizeof(wal_record) + header.keylen + header.valuelen;
+		if ( checksum(data.data() + pos + sizeof(header.checksum), len - sizeof(header.checksum), 2166136261u) != header.checksum ) {
+			break;
+		}
+		const char *body = data.data() + pos + sizeof(wal_record);
+		apply(env, header.op, string_view(body, header.keylen), string_view(body + header.keylen, header.valuelen));
+		applied++;
+		pos += len;
+	}
+	if ( pos < data.size() && ftruncate(fd, pos) < 0 ) {
+		perror("ftruncate");
+		exit(1);
+	}
+	return applied;
+}
+
+/**
+ * FUNCTION NAME: append
+ *
+ * DESCRIPTION: Add a record to the current group. It is only in the log once
+ * 				the group is committed, except with EVERY_SYNC.
+ */
+void WriteAheadLog::append(int op, string_view key, string_view value) {
+	wal_record header;
+	size_t start = pending.size();
+
+	memset(&header, 0, sizeof(wal_record));
+	header.op = op;
+	header.keylen = key.size();
+	header.valuelen = value.size();
+	pending.append((char *)&header, sizeof(wal_record));
+	pending.append(key.data(), key.size());
+	pending.append(value.data(), value.size());
+	header.checksum = checksum(pending.data() + start + sizeof(header.checksum),
+			pending.size() - start - sizeof(header.checksum), 2166136261u);
+	memcpy(&pending[start], &header.checksum, sizeof(header.checksum));
+	pendingRecords++;
+	records++;
+	if ( syncPolicy == EVERY_SYNC ) {
+		commit();
+	}
+}
+
+/**
+ * FUNCTION NAME: commit
+ *
+ * DESCRIPTION: Write the records appended since the last commit, then sync
+ * 				them unless the policy is NO_SYNC
+ */
+void WriteAheadLog::commit() {
+	if ( pendingRecords == 0 ) {
+		return;
+	}
+	writeOut(pending.data(), pending.size());
+	if ( syncPolicy != NO_SYNC ) {
+		if ( fdatasync(fd) < 0 ) {
+			perror("fdatasync");
+			exit(1);
+		}
+		syncs++;
+	}
+	bytes += pending.size();
+	commits++;
+	pending.clear();
+	pendingRecords = 0;
+}
+
+/**
+ * FUNCTION NAME: reset
+ *
+ * DESCRIPTION: Empty the log, records not committed yet included. For when
+ * 				everything in it is saved elsewhere, see HashTable::checkpoint.
+ */
+void WriteAheadLog::reset() {
+	pending.clear();
+	pendingRecords = 0;
+	if ( ftruncate(fd, 0) < 0 || (syncPolicy != NO_SYNC && fdatasync(fd) < 0) ) {
+		perror("ftruncate");
+		exit(1);
+	}
+}
+
+/**
+ * FUNCTION NAME: writeOut
+ *
+ * DESCRIPTION: write() all of data, however many calls it takes
+ */
+void WriteAheadLog::writeOut(const char *data, size_t len) {
+	while ( len > 0 ) {
+		ssize_t n = write(fd, data, len);
+		if ( n < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			perror("write");
+			exit(1);
+		}
+		data += n;
+		len -= n;
+	}
+}
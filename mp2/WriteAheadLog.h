@@ -0,0 +1,94 @@
+/**********************************
+ * FILE NAME: WriteAheadLog.h
+ *
+ * DESCRIPTION: Header file of the write-ahead log of a node's hash table
+ **********************************/
+
+#ifndef _WRITEAHEADLOG_H_
+#define _WRITEAHEADLOG_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+
+/*
+ * Macros
+ */
+// record types
+#define WAL_PUT 1
+#define WAL_DELETE 2
+#define WAL_CLEAR 3
+// the key is the partition, as KVStore::prefixKey writes it
+#define WAL_DROP 4
+// bytes read at a time by replay
+#define WAL_READ_CHUNK 65536
+
+/**
+ * Struct Name: wal_record
+ *
+ * DESCRIPTION: Fixed part of a log record, followed by keylen bytes of key and
+ * 				valuelen bytes of value. checksum covers everything after it,
+ * 				so a record torn by a crash is told apart from a whole one.
+ */
+typedef struct wal_record {
+	unsigned int checksum;
+	unsigned char op;
+	char pad[3];
+	unsigned int keylen;
+	unsigned int valuelen;
+}wal_record;
+
+/**
+ * CLASS NAME: WriteAheadLog
+ *
+ * DESCRIPTION: Append-only log of the changes to a hash table. Records are
+ * 				buffered by append() and written by commit(), so everything
+ * 				appended in between goes out in one write() and, depending on
+ * 				the sync policy, one fdatasync() (group commit):
+ * 				NO_SYNC		write per commit, the OS decides when it is on disk
+ * 				GROUP_SYNC	write and fdatasync per commit
+ * 				EVERY_SYNC	write and fdatasync per record, commit() has nothing left
+ * 				Not thread safe; every node has its own.
+ */
+class WriteAheadLog {
+private:
+	int fd;
+	string path;
+	int syncPolicy;
+	// records appended since the last commit
+	string pending;
+	int pendingRecords;
+	// totals, for the stats log
+	long records;
+	long commits;
+	long syncs;
+	long bytes;
+	static unsigned int checksum(const char *data, size_t len, unsigned int hash);
+	void writeOut(const char *data, size_t len);
+
+public:
+	WriteAheadLog(string dir, string name, int syncPolicy);
+	WriteAheadLog(const WriteAheadLog &other) = delete;
+	WriteAheadLog &operator=(const WriteAheadLog &other) = delete;
+	virtual ~WriteAheadLog();
+	long replay(void (*apply)(void *env, int op, string_view key, string_view value), void *env);
+	void append(int op, string_view key, string_view value);
+	void commit();
+	void reset();
+	int getPending() {
+		return pendingRecords;
+	}
+	long getRecords() {
+		return records;
+	}
+	long getCommits() {
+		return commits;
+	}
+	long getSyncs() {
+		return syncs;
+	}
+	long getBytes() {
+		return bytes;
+	}
+};
+
+#endif /* _WRITEAHEADLOG_H_ */
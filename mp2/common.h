@@ -1,15 +1,13 @@
 #ifndef COMMON_H_
 #define COMMON_H_
 
-/**
- * Global variable
- */
-// Transaction Id
-static int g_transID = 0;
-
-// message types, reply is the message from node to coordinator
-enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY};
-// enum of replica types
+// message types, reply is the message from node to coordinator; MERKLE and
+// REPAIR are exchanged between replicas to compare and repair their keys
+enum MessageType {CREATE, READ, UPDATE, DELETE, REPLY, READREPLY, MERKLE, REPAIR};
+// enum of replica types: a replica is named by its index among the replicas of
+// a key, these are the first three; the others go by index (int) up to MAX_REPLICAS
 enum ReplicaType {PRIMARY, SECONDARY, TERTIARY};
+// most replicas a key may have (see Params::REPLICAS)
+#define MAX_REPLICAS 16
 
 #endif
@@ -10,7 +10,6 @@
 /*
  * Macros
  */
-#define RING_SIZE 512
 #define FAILURE -1
 #define SUCCESS 0
 
@@ -24,6 +23,7 @@
 #include <assert.h>
 #include <time.h>
 #include <stdarg.h>
+#include <limits.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <execinfo.h>
@@ -32,9 +32,12 @@
 #include <vector>
 #include <map>
 #include <string>
+#include <string_view>
 #include <algorithm>
 #include <queue>
 #include <fstream>
+#include <atomic>
+#include <mutex>
 
 using namespace std;
 